@@ -10,9 +10,13 @@
 
 #include <map>
 #include <vector>
+#include <algorithm>
 #include <Eigen/Dense>
+#include <Eigen/StdVector>
 
 #include "imu_state.h"
+#include "id_index_table.hpp"
+#include "slot_iterator.hpp"
 
 namespace msckf_vio {
 /*
@@ -43,9 +47,6 @@ struct CAMState {
   Eigen::Vector4d orientation_null;
   Eigen::Vector3d position_null;
 
-  // Takes a vector from the cam0 frame to the cam1 frame.
-  static Eigen::Isometry3d T_cam0_cam1;
-
   CAMState(): id(0), time(0),
     orientation(Eigen::Vector4d(0, 0, 0, 1)),
     position(Eigen::Vector3d::Zero()),
@@ -59,9 +60,144 @@ struct CAMState {
     position_null(Eigen::Vector3d::Zero()) {}
 };
 
-typedef std::map<StateIDType, CAMState, std::less<int>,
-        Eigen::aligned_allocator<
-        std::pair<const StateIDType, CAMState> > > CamStateServer;
+/*
+ * @brief CamStateServer Store of the camera states (clones).
+ *
+ *    Each camera state lives in a fixed slot of a contiguous
+ *    buffer until it is erased, and the slot index gives the
+ *    position of its block in the state covariance, i.e.
+ *    imu_state_size+6*slot. New states take the next free slot
+ *    after the last allocated one, so the slots are used as a
+ *    ring buffer.
+ *    Erasing a state only marks its slot as free. The id of a
+ *    state is mapped to its slot with a hash table.
+ *
+ *    The interface follows std::map. Iteration is in the order
+ *    of the state ids and gives pairs of (id, CAMState).
+ */
+class CamStateServer {
+  public:
+    typedef std::pair<StateIDType, CAMState> value_type;
+
+  private:
+    typedef std::vector<value_type,
+            Eigen::aligned_allocator<value_type> > SlotBuffer;
+
+    template <typename, typename> friend class SlotIterator;
+
+  public:
+    typedef SlotIterator<CamStateServer, value_type> iterator;
+    typedef SlotIterator<const CamStateServer, const value_type> const_iterator;
+
+    CamStateServer(): next_slot(0) {}
+
+    /*
+     * @brief reserve Make sure there are at least the given
+     *    number of slots. Existing states keep their slots.
+     */
+    void reserve(const int& slot_num) {
+      if (slot_num <= capacity()) return;
+      slots.resize(slot_num);
+      is_free.resize(slot_num, true);
+      return;
+    }
+
+    // Number of slots, used or not.
+    int capacity() const { return slots.size(); }
+
+    /*
+     * @brief slot The slot of the camera state with the given
+     *    id, or -1 if there is no such state.
+     */
+    int slot(const StateIDType& id) const {
+      return slot_table.find(id);
+    }
+
+    iterator find(const StateIDType& id) {
+      const int s = slot(id);
+      if (s < 0) return end();
+      return iterator(this, orderPosition(id));
+    }
+    const_iterator find(const StateIDType& id) const {
+      const int s = slot(id);
+      if (s < 0) return end();
+      return const_iterator(this, orderPosition(id));
+    }
+
+    /*
+     * @brief operator[] Access the camera state with the given
+     *    id. A default constructed state is inserted if there is
+     *    no such state. The number of slots is doubled if all of
+     *    them are in use.
+     */
+    CAMState& operator[](const StateIDType& id) {
+      int s = slot(id);
+      if (s >= 0) return slots[s].second;
+
+      if (static_cast<int>(size()) == capacity())
+        reserve(std::max(2*capacity(), 1));
+      s = next_slot;
+      while (!is_free[s]) s = (s+1) % capacity();
+      next_slot = (s+1) % capacity();
+
+      is_free[s] = false;
+      slots[s] = value_type(id, CAMState());
+      slot_table.set(id, s);
+
+      // Keep the slots sorted by id. The new state
+      // normally has the largest id.
+      auto pos = order.end();
+      while (pos != order.begin() && slots[*(pos-1)].first > id) --pos;
+      order.insert(pos, s);
+      return slots[s].second;
+    }
+
+    /*
+     * @brief erase Remove the camera state and free its slot.
+     * @return Number of removed states.
+     */
+    std::size_t erase(const StateIDType& id) {
+      const int s = slot(id);
+      if (s < 0) return 0;
+      order.erase(orderPosition(id));
+      slot_table.erase(id);
+      is_free[s] = true;
+      return 1;
+    }
+
+    void clear() {
+      order.clear();
+      slot_table.clear();
+      std::fill(is_free.begin(), is_free.end(), true);
+      next_slot = 0;
+      return;
+    }
+
+    std::size_t size() const { return order.size(); }
+    bool empty() const { return order.empty(); }
+
+    iterator begin() { return iterator(this, order.begin()); }
+    iterator end() { return iterator(this, order.end()); }
+    const_iterator begin() const { return const_iterator(this, order.begin()); }
+    const_iterator end() const { return const_iterator(this, order.end()); }
+
+  private:
+    // Position of the id in the list of the used slots.
+    std::vector<int>::const_iterator orderPosition(const StateIDType& id) const {
+      return std::lower_bound(order.begin(), order.end(), id,
+          [this](const int& s, const StateIDType& v) {
+            return slots[s].first < v;
+          });
+    }
+
+    SlotBuffer slots;
+    std::vector<bool> is_free;
+    // Used slots sorted by the state id.
+    std::vector<int> order;
+    IdIndexTable<StateIDType> slot_table;
+    int next_slot;
+};
+
 } // namespace msckf_vio
 
 #endif // MSCKF_VIO_CAM_STATE_H
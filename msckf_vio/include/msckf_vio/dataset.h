@@ -0,0 +1,71 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_DATASET_H
+#define MSCKF_VIO_DATASET_H
+
+#include <vector>
+#include <string>
+#include <Eigen/Dense>
+
+#include "imu_buffer.h"
+
+namespace msckf_vio {
+
+/*
+ * @brief StereoFrame Time stamp and image files of a stereo pair.
+ */
+struct StereoFrame {
+  double time;
+  std::string cam0_file;
+  std::string cam1_file;
+};
+
+/*
+ * @brief StampedPose Pose of the IMU frame in a world frame.
+ */
+struct StampedPose {
+  double time;
+  Eigen::Vector3d position;
+  // Rotation from the IMU frame to the world frame.
+  Eigen::Matrix3d rotation;
+};
+
+/*
+ * @brief Dataset IMU msgs, stereo images and ground truth of a
+ *    sequence stored on disk. The images are not loaded, only
+ *    their file names are listed. All the data are sorted by time.
+ */
+struct Dataset {
+  std::vector<ImuSample> imu;
+  std::vector<StereoFrame> frames;
+  // Empty if the sequence has no ground truth.
+  std::vector<StampedPose> ground_truth;
+
+  /*
+   * @brief loadEuroc Load a sequence in the EuRoC ASL format.
+   * @param path Folder containing mav0.
+   */
+  bool loadEuroc(const std::string& path);
+
+  /*
+   * @brief loadKittiRaw Load a KITTI raw sequence, using the
+   *    grayscale cameras and the OXTS unit, whose poses are used
+   *    as the ground truth. The unsynced OXTS data, which are
+   *    recorded at 100Hz, should be used for the IMU.
+   * @param image_path Drive folder containing image_00 and image_01.
+   * @param oxts_path Drive folder containing oxts.
+   */
+  bool loadKittiRaw(const std::string& image_path,
+      const std::string& oxts_path);
+
+  void clear();
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_DATASET_H
@@ -9,8 +9,10 @@
 #define MSCKF_VIO_FEATURE_H
 
 #include <iostream>
-#include <map>
+#include <deque>
 #include <vector>
+#include <utility>
+#include <algorithm>
 
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
@@ -19,9 +21,112 @@
 #include "math_utils.hpp"
 #include "imu_state.h"
 #include "cam_state.h"
+#include "id_index_table.hpp"
+#include "slot_iterator.hpp"
 
 namespace msckf_vio {
 
+/*
+ * @brief ObservationMap Observations of a feature stored in
+ *    a flat vector of (state id, measurement) pairs sorted by
+ *    the state id.
+ *
+ *    A feature is observed by a few tens of camera states at
+ *    most, and the observations are added in the order of the
+ *    state ids, so appending to a contiguous buffer is cheaper
+ *    than allocating a tree node for each of them. The interface
+ *    follows std::map.
+ */
+class ObservationMap {
+  public:
+    typedef std::pair<StateIDType, Eigen::Vector4d> value_type;
+
+  private:
+    typedef std::vector<value_type,
+            Eigen::aligned_allocator<value_type> > Buffer;
+
+  public:
+    typedef Buffer::iterator iterator;
+    typedef Buffer::const_iterator const_iterator;
+
+    iterator find(const StateIDType& id) {
+      const iterator iter = lowerBound(id);
+      return iter != data.end() && iter->first == id ? iter : data.end();
+    }
+    const_iterator find(const StateIDType& id) const {
+      const const_iterator iter = lowerBound(id);
+      return iter != data.end() && iter->first == id ? iter : data.end();
+    }
+
+    /*
+     * @brief operator[] Access the measurement of the given state,
+     *    which is inserted if it does not exist. New observations
+     *    normally have the largest state id and are appended.
+     */
+    Eigen::Vector4d& operator[](const StateIDType& id) {
+      if (data.empty() || data.back().first < id) {
+        data.push_back(value_type(id, Eigen::Vector4d::Zero()));
+        return data.back().second;
+      }
+      const iterator iter = lowerBound(id);
+      if (iter != data.end() && iter->first == id) return iter->second;
+      return data.insert(iter, value_type(id, Eigen::Vector4d::Zero()))->second;
+    }
+
+    /*
+     * @brief erase Remove the observation of the given state.
+     * @return Number of removed observations.
+     */
+    std::size_t erase(const StateIDType& id) {
+      const iterator iter = find(id);
+      if (iter == data.end()) return 0;
+      data.erase(iter);
+      return 1;
+    }
+
+    // The capacity of the buffer is kept for reuse.
+    void clear() { data.clear(); }
+
+    std::size_t size() const { return data.size(); }
+    bool empty() const { return data.empty(); }
+
+    iterator begin() { return data.begin(); }
+    iterator end() { return data.end(); }
+    const_iterator begin() const { return data.begin(); }
+    const_iterator end() const { return data.end(); }
+
+  private:
+    iterator lowerBound(const StateIDType& id) {
+      return std::lower_bound(data.begin(), data.end(), id,
+          [](const value_type& v, const StateIDType& i) { return v.first < i; });
+    }
+    const_iterator lowerBound(const StateIDType& id) const {
+      return std::lower_bound(data.begin(), data.end(), id,
+          [](const value_type& v, const StateIDType& i) { return v.first < i; });
+    }
+
+    Buffer data;
+};
+
+/*
+ * @brief CameraPoses Poses of the stereo cameras of all the
+ *    camera states, which take a vector from the camera frame
+ *    to the world frame. The poses are indexed by the slots of
+ *    the camera states, so they are computed once and shared by
+ *    all the features to be triangulated. T_cam0_cam1 takes a
+ *    vector from the cam0 frame to the cam1 frame.
+ */
+struct CameraPoses {
+  typedef std::vector<Eigen::Isometry3d,
+          Eigen::aligned_allocator<Eigen::Isometry3d> > PoseBuffer;
+
+  PoseBuffer cam0_poses;
+  PoseBuffer cam1_poses;
+
+  inline void compute(const CamStateServer& cam_states,
+      const Eigen::Isometry3d& T_cam0_cam1);
+};
+
 /*
  * @brief Feature Salient part of an image. Please refer
  *    to the Appendix of "A Multi-State Constraint Kalman
@@ -81,12 +186,14 @@ struct Feature {
    *    a vector in c0 frame to ci frame.
    * @param x The current estimation.
    * @param z The actual measurement of the feature in ci frame.
+   * @param huber_epsilon Threshold of the huber kernel.
    * @return J The computed Jacobian.
    * @return r The computed residual.
    * @return w Weight induced by huber kernel.
    */
   inline void jacobian(const Eigen::Isometry3d& T_c0_ci,
       const Eigen::Vector3d& x, const Eigen::Vector2d& z,
+      const double& huber_epsilon,
       Eigen::Matrix<double, 2, 3>& J, Eigen::Vector2d& r,
       double& w) const;
 
@@ -108,25 +215,47 @@ struct Feature {
    *    there is enough translation to triangulate the feature
    *    positon.
    * @param cam_states : input camera poses.
+   * @param T_cam0_cam1 : extrinsics of the stereo cameras.
+   * @param config : thresholds of the triangulation.
    * @return True if the translation between the input camera
    *    poses is sufficient.
    */
-  inline bool checkMotion(
-      const CamStateServer& cam_states) const;
+  inline bool checkMotion(const CamStateServer& cam_states,
+      const Eigen::Isometry3d& T_cam0_cam1,
+      const OptimizationConfig& config) const;
+
+  /*
+   * @brief checkMotion Same as above, with the camera poses
+   *    computed in advance.
+   */
+  inline bool checkMotion(const CamStateServer& cam_states,
+      const CameraPoses& cam_poses,
+      const OptimizationConfig& config) const;
 
   /*
    * @brief InitializePosition Intialize the feature position
    *    based on all current available measurements.
    * @param cam_states: A map containing the camera poses with its
    *    ID as the associated key value.
+   * @param T_cam0_cam1: extrinsics of the stereo cameras.
+   * @param config: parameters of the optimization.
    * @return The computed 3d position is used to set the position
    *    member variable. Note the resulted position is in world
    *    frame.
    * @return True if the estimated 3d position of the feature
    *    is valid.
    */
-  inline bool initializePosition(
-      const CamStateServer& cam_states);
+  inline bool initializePosition(const CamStateServer& cam_states,
+      const Eigen::Isometry3d& T_cam0_cam1,
+      const OptimizationConfig& config);
+
+  /*
+   * @brief InitializePosition Same as above, with the camera
+   *    poses computed in advance. Features can be initialized
+   *    concurrently since the camera poses are only read.
+   */
+  inline bool initializePosition(const CamStateServer& cam_states,
+      const CameraPoses& cam_poses, const OptimizationConfig& config);
 
 
   // An unique identifier for the feature.
@@ -135,14 +264,9 @@ struct Feature {
   // to avoid duplication.
   FeatureIDType id;
 
-  // id for next feature
-  static FeatureIDType next_id;
-
   // Store the observations of the features in the
   // state_id(key)-image_coordinates(value) manner.
-  std::map<StateIDType, Eigen::Vector4d, std::less<StateIDType>,
-    Eigen::aligned_allocator<
-      std::pair<const StateIDType, Eigen::Vector4d> > > observations;
+  ObservationMap observations;
 
   // 3d postion of the feature in the world frame.
   Eigen::Vector3d position;
@@ -151,18 +275,125 @@ struct Feature {
   // has been initialized or not.
   bool is_initialized;
 
-  // Noise for a normalized feature measurement.
-  static double observation_noise;
-
-  // Optimization configuration for solving the 3d position.
-  static OptimizationConfig optimization_config;
-
 };
 
 typedef Feature::FeatureIDType FeatureIDType;
-typedef std::map<FeatureIDType, Feature, std::less<int>,
-        Eigen::aligned_allocator<
-        std::pair<const FeatureIDType, Feature> > > MapServer;
+
+/*
+ * @brief MapServer Store of the features in the map.
+ *
+ *    The features are kept in the slots of a deque, and the id
+ *    of a feature is mapped to its slot with an open-addressing
+ *    hash table. Slots of removed features are reused together
+ *    with the observation buffers of the removed features, so no
+ *    memory is allocated once the number of tracked features has
+ *    settled. New slots are appended without moving the existing
+ *    ones, so as with std::map, references to a feature stay
+ *    valid until the feature is erased.
+ *
+ *    The interface follows std::map. Iteration is in the order
+ *    of the feature ids and gives pairs of (id, Feature).
+ */
+class MapServer {
+  public:
+    typedef std::pair<FeatureIDType, Feature> value_type;
+
+  private:
+    typedef std::deque<value_type,
+            Eigen::aligned_allocator<value_type> > SlotBuffer;
+
+    template <typename, typename> friend class SlotIterator;
+
+  public:
+    typedef SlotIterator<MapServer, value_type> iterator;
+    typedef SlotIterator<const MapServer, const value_type> const_iterator;
+
+    iterator find(const FeatureIDType& id) {
+      if (slot_table.find(id) < 0) return end();
+      return iterator(this, orderPosition(id));
+    }
+    const_iterator find(const FeatureIDType& id) const {
+      if (slot_table.find(id) < 0) return end();
+      return const_iterator(this, orderPosition(id));
+    }
+
+    /*
+     * @brief operator[] Access the feature with the given id.
+     *    A new feature with this id is inserted if there is no
+     *    such feature.
+     */
+    Feature& operator[](const FeatureIDType& id) {
+      int s = slot_table.find(id);
+      if (s >= 0) return slots[s].second;
+
+      if (free_slots.empty()) {
+        s = slots.size();
+        slots.push_back(value_type(id, Feature(id)));
+      } else {
+        s = free_slots.back();
+        free_slots.pop_back();
+
+        // Keep the observation buffer of the previous feature.
+        ObservationMap observations;
+        std::swap(observations, slots[s].second.observations);
+        observations.clear();
+        slots[s] = value_type(id, Feature(id));
+        std::swap(observations, slots[s].second.observations);
+      }
+      slot_table.set(id, s);
+
+      // Keep the slots sorted by id. New features
+      // normally have the largest ids.
+      auto pos = order.end();
+      while (pos != order.begin() && slots[*(pos-1)].first > id) --pos;
+      order.insert(pos, s);
+      return slots[s].second;
+    }
+
+    /*
+     * @brief erase Remove the feature with the given id.
+     * @return Number of removed features.
+     */
+    std::size_t erase(const FeatureIDType& id) {
+      const int s = slot_table.find(id);
+      if (s < 0) return 0;
+      order.erase(orderPosition(id));
+      slot_table.erase(id);
+      free_slots.push_back(s);
+      return 1;
+    }
+
+    void clear() {
+      slots.clear();
+      free_slots.clear();
+      order.clear();
+      slot_table.clear();
+      return;
+    }
+
+    std::size_t size() const { return order.size(); }
+    bool empty() const { return order.empty(); }
+
+    iterator begin() { return iterator(this, order.begin()); }
+    iterator end() { return iterator(this, order.end()); }
+    const_iterator begin() const { return const_iterator(this, order.begin()); }
+    const_iterator end() const { return const_iterator(this, order.end()); }
+
+  private:
+    // Position of the id in the list of the used slots.
+    std::vector<int>::const_iterator orderPosition(const FeatureIDType& id) const {
+      return std::lower_bound(order.begin(), order.end(), id,
+          [this](const int& s, const FeatureIDType& v) {
+            return slots[s].first < v;
+          });
+    }
+
+    SlotBuffer slots;
+    std::vector<int> free_slots;
+    // Used slots sorted by the feature id.
+    std::vector<int> order;
+    IdIndexTable<FeatureIDType> slot_table;
+};
 
 
 void Feature::cost(const Eigen::Isometry3d& T_c0_ci,
@@ -189,6 +420,7 @@ void Feature::cost(const Eigen::Isometry3d& T_c0_ci,
 
 void Feature::jacobian(const Eigen::Isometry3d& T_c0_ci,
     const Eigen::Vector3d& x, const Eigen::Vector2d& z,
+    const double& huber_epsilon,
     Eigen::Matrix<double, 2, 3>& J, Eigen::Vector2d& r,
     double& w) const {
 
@@ -217,10 +449,10 @@ void Feature::jacobian(const Eigen::Isometry3d& T_c0_ci,
 
   // Compute the weight based on the residual.
   double e = r.norm();
-  if (e <= optimization_config.huber_epsilon)
+  if (e <= huber_epsilon)
     w = 1.0;
   else
-    w = std::sqrt(2.0*optimization_config.huber_epsilon / e);
+    w = std::sqrt(2.0*huber_epsilon / e);
 
   return;
 }
@@ -247,23 +479,41 @@ void Feature::generateInitialGuess(
   return;
 }
 
-bool Feature::checkMotion(
-    const CamStateServer& cam_states) const {
+void CameraPoses::compute(const CamStateServer& cam_states,
+    const Eigen::Isometry3d& T_cam0_cam1) {
+  cam0_poses.resize(cam_states.capacity());
+  cam1_poses.resize(cam_states.capacity());
+  const Eigen::Isometry3d T_cam1_cam0 = T_cam0_cam1.inverse();
+
+  for (auto iter = cam_states.begin(); iter != cam_states.end(); ++iter) {
+    Eigen::Isometry3d& cam0_pose = cam0_poses[iter.slot()];
+    cam0_pose.linear() = quaternionToRotation(
+        iter->second.orientation).transpose();
+    cam0_pose.translation() = iter->second.position;
+    cam1_poses[iter.slot()] = cam0_pose * T_cam1_cam0;
+  }
+  return;
+}
+
+bool Feature::checkMotion(const CamStateServer& cam_states,
+    const Eigen::Isometry3d& T_cam0_cam1,
+    const OptimizationConfig& config) const {
+  CameraPoses cam_poses;
+  cam_poses.compute(cam_states, T_cam0_cam1);
+  return checkMotion(cam_states, cam_poses, config);
+}
+
+bool Feature::checkMotion(const CamStateServer& cam_states,
+    const CameraPoses& cam_poses,
+    const OptimizationConfig& config) const {
 
   const StateIDType& first_cam_id = observations.begin()->first;
   const StateIDType& last_cam_id = (--observations.end())->first;
 
-  Eigen::Isometry3d first_cam_pose;
-  first_cam_pose.linear() = quaternionToRotation(
-      cam_states.find(first_cam_id)->second.orientation).transpose();
-  first_cam_pose.translation() =
-    cam_states.find(first_cam_id)->second.position;
-
-  Eigen::Isometry3d last_cam_pose;
-  last_cam_pose.linear() = quaternionToRotation(
-      cam_states.find(last_cam_id)->second.orientation).transpose();
-  last_cam_pose.translation() =
-    cam_states.find(last_cam_id)->second.position;
+  const Eigen::Isometry3d& first_cam_pose =
+    cam_poses.cam0_poses[cam_states.slot(first_cam_id)];
+  const Eigen::Isometry3d& last_cam_pose =
+    cam_poses.cam0_poses[cam_states.slot(last_cam_id)];
 
   // Get the direction of the feature when it is first observed.
   // This direction is represented in the world frame.
@@ -285,13 +535,21 @@ bool Feature::checkMotion(
     parallel_translation*feature_direction;
 
   if (orthogonal_translation.norm() >
-      optimization_config.translation_threshold)
+      config.translation_threshold)
     return true;
   else return false;
 }
 
-bool Feature::initializePosition(
-    const CamStateServer& cam_states) {
+bool Feature::initializePosition(const CamStateServer& cam_states,
+    const Eigen::Isometry3d& T_cam0_cam1,
+    const OptimizationConfig& config) {
+  CameraPoses cam_poses;
+  cam_poses.compute(cam_states, T_cam0_cam1);
+  return initializePosition(cam_states, cam_poses, config);
+}
+
+bool Feature::initializePosition(const CamStateServer& cam_states,
+    const CameraPoses& all_cam_poses, const OptimizationConfig& config) {
   // Organize camera poses and feature observations properly.
   std::vector<Eigen::Isometry3d,
     Eigen::aligned_allocator<Eigen::Isometry3d> > cam_poses(0);
@@ -302,8 +560,8 @@ bool Feature::initializePosition(
     // TODO: This should be handled properly. Normally, the
     //    required camera states should all be available in
     //    the input cam_states buffer.
-    auto cam_state_iter = cam_states.find(m.first);
-    if (cam_state_iter == cam_states.end()) continue;
+    const int slot = cam_states.slot(m.first);
+    if (slot < 0) continue;
 
     // Add the measurement.
     measurements.push_back(m.second.head<2>());
@@ -311,16 +569,8 @@ bool Feature::initializePosition(
 
     // This camera pose will take a vector from this camera frame
     // to the world frame.
-    Eigen::Isometry3d cam0_pose;
-    cam0_pose.linear() = quaternionToRotation(
-        cam_state_iter->second.orientation).transpose();
-    cam0_pose.translation() = cam_state_iter->second.position;
-
-    Eigen::Isometry3d cam1_pose;
-    cam1_pose = cam0_pose * CAMState::T_cam0_cam1.inverse();
-
-    cam_poses.push_back(cam0_pose);
-    cam_poses.push_back(cam1_pose);
+    cam_poses.push_back(all_cam_poses.cam0_poses[slot]);
+    cam_poses.push_back(all_cam_poses.cam1_poses[slot]);
   }
 
   // All camera poses should be modified such that it takes a
@@ -340,7 +590,7 @@ bool Feature::initializePosition(
       1.0/initial_position(2));
 
   // Apply Levenberg-Marquart method to solve for the 3d position.
-  double lambda = optimization_config.initial_damping;
+  double lambda = config.initial_damping;
   int inner_loop_cntr = 0;
   int outer_loop_cntr = 0;
   bool is_cost_reduced = false;
@@ -364,7 +614,8 @@ bool Feature::initializePosition(
       Eigen::Vector2d r;
       double w;
 
-      jacobian(cam_poses[i], solution, measurements[i], J, r, w);
+      jacobian(cam_poses[i], solution, measurements[i],
+          config.huber_epsilon, J, r, w);
 
       if (w == 1) {
         A += J.transpose() * J;
@@ -402,13 +653,13 @@ bool Feature::initializePosition(
       }
 
     } while (inner_loop_cntr++ <
-        optimization_config.inner_loop_max_iteration && !is_cost_reduced);
+        config.inner_loop_max_iteration && !is_cost_reduced);
 
     inner_loop_cntr = 0;
 
   } while (outer_loop_cntr++ <
-      optimization_config.outer_loop_max_iteration &&
-      delta_norm > optimization_config.estimation_precision);
+      config.outer_loop_max_iteration &&
+      delta_norm > config.estimation_precision);
 
   // Covert the feature position from inverse depth
   // representation to its 3d coordinate.
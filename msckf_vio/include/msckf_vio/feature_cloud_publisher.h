@@ -0,0 +1,116 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_FEATURE_CLOUD_PUBLISHER_H
+#define MSCKF_VIO_FEATURE_CLOUD_PUBLISHER_H
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <utility>
+#include <condition_variable>
+#include <Eigen/Dense>
+#include <boost/shared_ptr.hpp>
+
+#include <ros/ros.h>
+
+#include "feature.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief FeatureCloudPublisher Publishes the positions of the
+ *    initialized features as a point cloud.
+ *
+ *    The estimator only reports the features which are initialized
+ *    or removed. A background thread applies these changes to its
+ *    own copy of the map, and builds and serializes the point cloud
+ *    when it is due. The cloud is only published if there are
+ *    subscribers, and at most at the given rate.
+ */
+class FeatureCloudPublisher {
+  public:
+    typedef boost::shared_ptr<FeatureCloudPublisher> Ptr;
+
+    /*
+     * @param publisher Publisher of sensor_msgs::PointCloud2.
+     * @param frame_id Frame of the published cloud.
+     * @param R_imu_body Rotation applied to the feature positions.
+     * @param rate Maximum publishing rate in Hz, or nonpositive
+     *    to publish on every request.
+     */
+    FeatureCloudPublisher(const ros::Publisher& publisher,
+        const std::string& frame_id,
+        const Eigen::Matrix3d& R_imu_body,
+        const double& rate);
+
+    ~FeatureCloudPublisher();
+
+    // Disable copy and assign constructor
+    FeatureCloudPublisher(const FeatureCloudPublisher&) = delete;
+    FeatureCloudPublisher operator=(const FeatureCloudPublisher&) = delete;
+
+    // The following functions must be called from one thread.
+
+    // Add a feature which has been initialized.
+    void add(const FeatureIDType& id, const Eigen::Vector3d& position);
+    // Remove a feature added before.
+    void remove(const FeatureIDType& id);
+    // Remove all the features.
+    void clear();
+
+    /*
+     * @brief publish Hand the changes since the last call over to
+     *    the background thread, and publish the cloud if it is due.
+     * @param time The time stamp of the cloud.
+     */
+    void publish(const ros::Time& time);
+
+  private:
+    // Changes of the map since the last hand-over. A cleared map
+    // is applied first, then the added and the removed features.
+    struct Delta {
+      bool is_cleared;
+      std::vector<std::pair<FeatureIDType, Eigen::Vector3d> > added;
+      std::vector<FeatureIDType> removed;
+
+      Delta(): is_cleared(false) {}
+      void append(Delta& delta);
+    };
+
+    void publisherLoop();
+
+    ros::Publisher publisher;
+    const std::string frame_id;
+    const Eigen::Matrix3d R_imu_body;
+    const double period;
+
+    // Only accessed by the calling thread.
+    Delta pending_delta;
+    ros::Time last_publish_time;
+
+    // Shared with the background thread.
+    std::mutex delta_mutex;
+    std::condition_variable delta_cond;
+    Delta queued_delta;
+    bool is_queued;
+    bool is_publish_requested;
+    ros::Time publish_time;
+    bool stop;
+
+    // Positions of the features, only accessed by the background
+    // thread.
+    std::map<FeatureIDType, Eigen::Vector3d> positions;
+
+    std::thread worker;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_FEATURE_CLOUD_PUBLISHER_H
@@ -0,0 +1,147 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_ID_INDEX_TABLE_HPP
+#define MSCKF_VIO_ID_INDEX_TABLE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace msckf_vio {
+
+/*
+ * @brief IdIndexTable Open-addressing hash table which maps an
+ *    integer id to a non-negative index into a flat storage.
+ *
+ *    Linear probing is used on a power-of-two bucket array. The
+ *    ids are scrambled with Fibonacci hashing since the state and
+ *    feature ids are mostly consecutive. Erased buckets are kept
+ *    as tombstones until the next rehash.
+ */
+template <typename IDType>
+class IdIndexTable {
+  public:
+    IdIndexTable(): entry_num(0), tombstone_num(0), shift(64) {}
+
+    /*
+     * @brief find Index stored for the id, or -1 if the id
+     *    is not in the table.
+     */
+    int find(const IDType& id) const {
+      if (keys.empty()) return -1;
+      const std::size_t mask = keys.size() - 1;
+      for (std::size_t i = bucket(id); ; i = (i+1) & mask) {
+        if (indices[i] == EMPTY) return -1;
+        if (indices[i] != TOMBSTONE && keys[i] == id) return indices[i];
+      }
+    }
+
+    /*
+     * @brief set Store the index for the id. The index of an
+     *    existing id is overwritten.
+     */
+    void set(const IDType& id, const int& index) {
+      if (2*static_cast<std::size_t>(entry_num+tombstone_num+1) > keys.size())
+        rehash(2*(entry_num+1));
+
+      const std::size_t mask = keys.size() - 1;
+      std::size_t target = keys.size();
+      for (std::size_t i = bucket(id); ; i = (i+1) & mask) {
+        if (indices[i] == TOMBSTONE) {
+          if (target == keys.size()) target = i;
+          continue;
+        }
+        if (indices[i] == EMPTY) {
+          if (target == keys.size()) target = i;
+          break;
+        }
+        if (keys[i] == id) {
+          indices[i] = index;
+          return;
+        }
+      }
+
+      if (indices[target] == TOMBSTONE) --tombstone_num;
+      keys[target] = id;
+      indices[target] = index;
+      ++entry_num;
+      return;
+    }
+
+    /*
+     * @brief erase Remove the id from the table.
+     * @return True if the id was in the table.
+     */
+    bool erase(const IDType& id) {
+      if (keys.empty()) return false;
+      const std::size_t mask = keys.size() - 1;
+      for (std::size_t i = bucket(id); ; i = (i+1) & mask) {
+        if (indices[i] == EMPTY) return false;
+        if (indices[i] != TOMBSTONE && keys[i] == id) {
+          indices[i] = TOMBSTONE;
+          --entry_num;
+          ++tombstone_num;
+          return true;
+        }
+      }
+    }
+
+    void clear() {
+      std::fill(indices.begin(), indices.end(), EMPTY);
+      entry_num = 0;
+      tombstone_num = 0;
+      return;
+    }
+
+    int size() const { return entry_num; }
+
+  private:
+    static const int EMPTY = -1;
+    static const int TOMBSTONE = -2;
+
+    std::size_t bucket(const IDType& id) const {
+      // 2^64 divided by the golden ratio.
+      return static_cast<std::size_t>(
+          (static_cast<std::uint64_t>(id)*11400714819323198485ull) >> shift);
+    }
+
+    // Rebuild the table with at least the given number of
+    // buckets, which also drops all the tombstones.
+    void rehash(const std::size_t& min_bucket_num) {
+      std::size_t bucket_num = 16;
+      int bits = 4;
+      while (bucket_num < min_bucket_num) {
+        bucket_num <<= 1;
+        ++bits;
+      }
+
+      std::vector<IDType> old_keys(bucket_num);
+      std::vector<int> old_indices(bucket_num, EMPTY);
+      old_keys.swap(keys);
+      old_indices.swap(indices);
+      shift = 64 - bits;
+      entry_num = 0;
+      tombstone_num = 0;
+
+      for (std::size_t i = 0; i < old_keys.size(); ++i) {
+        if (old_indices[i] < 0) continue;
+        set(old_keys[i], old_indices[i]);
+      }
+      return;
+    }
+
+    std::vector<IDType> keys;
+    std::vector<int> indices;
+    int entry_num;
+    int tombstone_num;
+    int shift;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_ID_INDEX_TABLE_HPP
@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <map>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <opencv2/opencv.hpp>
 #include <opencv2/video.hpp>
@@ -24,6 +25,15 @@
 #include <message_filters/time_synchronizer.h>
 #include <message_filters/synchronizer.h>
 #include <message_filters/sync_policies/approximate_time.h>
+
+#include <msckf_vio/CameraMeasurement.h>
+
+#include "imu_buffer.h"
+#include "latency_diagnostics.h"
+#include "parameter_reader.h"
+#include "thread_pool.h"
+#include "undistortion_map.h"
+
 namespace msckf_vio {
 
 /*
@@ -34,6 +44,9 @@ class ImageProcessor {
 public:
   // Constructor
   ImageProcessor(ros::NodeHandle& n);
+  // Constructor without any ros io, e.g. to process a dataset
+  // without a master, see initialize(params).
+  ImageProcessor();
   // Disable copy and assign constructors.
   ImageProcessor(const ImageProcessor&) = delete;
   ImageProcessor operator=(const ImageProcessor&) = delete;
@@ -44,11 +57,48 @@ public:
   // Initialize the object.
   bool initialize();
 
+  /*
+   * @brief initialize Initialize the object with the given
+   *    parameters. The topics are only advertised and subscribed
+   *    if the object is constructed with a node handle.
+   * @param imu_buffer: the IMU samples shared with the estimator.
+   *    If null, the buffer is shared through the resolved IMU
+   *    topic with a node handle, and private to the object
+   *    without one.
+   */
+  bool initialize(const ParameterReader& params,
+      const ImuBuffer::Ptr& imu_buffer = ImuBuffer::Ptr());
+
+  /*
+   * @brief processStereo, processImu Process the msgs directly,
+   *    e.g. when the sensor data are read from a dataset instead
+   *    of being subscribed.
+   */
+  void processStereo(
+      const sensor_msgs::ImageConstPtr& cam0_img,
+      const sensor_msgs::ImageConstPtr& cam1_img) {
+    stereoCallback(cam0_img, cam1_img);
+  }
+  void processImu(const sensor_msgs::ImuConstPtr& msg) {
+    imuCallback(msg);
+  }
+
+  // Called with every feature msg in addition to publishing it.
+  typedef boost::function<void(const CameraMeasurementConstPtr&)>
+    FeatureCallback;
+  void setFeatureCallback(const FeatureCallback& callback) {
+    feature_callback = callback;
+  }
+
   typedef boost::shared_ptr<ImageProcessor> Ptr;
   typedef boost::shared_ptr<const ImageProcessor> ConstPtr;
 
 private:
 
+  // Runs the front-end kernels on synthetic data.
+  friend class ImageProcessorBenchmark;
+  friend class ImageProcessorTester;
+
   /*
    * @brief ProcessorConfig Configuration parameters for
    *    feature detection and tracking.
@@ -65,7 +115,9 @@ private:
     int max_iteration;
     double track_precision;
     double ransac_threshold;
+    bool ransac_adaptive_termination;
     double stereo_threshold;
+    int undistortion_cell_size;
   };
 
   /*
@@ -75,7 +127,8 @@ private:
 
   /*
    * @brief FeatureMetaData Contains necessary information
-   *    of a feature for easy access.
+   *    of a feature for easy access. The undistorted points
+   *    are in normalized coordinates.
    */
   struct FeatureMetaData {
     FeatureIDType id;
@@ -83,6 +136,8 @@ private:
     int lifetime;
     cv::Point2f cam0_point;
     cv::Point2f cam1_point;
+    cv::Point2f cam0_point_undistorted;
+    cv::Point2f cam1_point_undistorted;
   };
 
   /*
@@ -128,9 +183,9 @@ private:
 
   /*
    * @brief loadParameters
-   *    Load parameters from the parameter server.
+   *    Load parameters from the parameter server or a file.
    */
-  bool loadParameters();
+  bool loadParameters(const ParameterReader& params);
 
   /*
    * @brief createRosIO
@@ -176,6 +231,28 @@ private:
    */
   void addNewFeatures();
 
+  /*
+   * @brief markFeatureOccupancy
+   *    Set the occupancy of the pixels around the features in
+   *    the current image to the given value.
+   */
+  void markFeatureOccupancy(const int& rows, const int& cols,
+      const unsigned char& value);
+
+  /*
+   * @brief detectGridFeatures
+   *    Detect FAST corners within a grid and keep the ones with
+   *    top response, skipping the occupied pixels. Different
+   *    grids can be processed in parallel.
+   * @param img: the current cam0 image.
+   * @param grid: region of the grid in the image.
+   * @param keypoints: buffer for the raw corners of the grid.
+   * @return grid_features: at most grid_max_feature_num corners.
+   */
+  void detectGridFeatures(const cv::Mat& img, const cv::Rect& grid,
+      std::vector<cv::KeyPoint>& keypoints,
+      std::vector<cv::KeyPoint>& grid_features) const;
+
   /*
    * @brief pruneGridFeatures
    *    Remove some of the features of a grid in case there are
@@ -204,11 +281,29 @@ private:
    */
   void drawFeaturesStereo();
 
+  /*
+   * @brief allocateBuffers
+   *    Allocate the pyramids, the occupancy of the features and
+   *    the feature grids for the configured resolution, so that
+   *    the images are processed without allocating memory.
+   */
+  void allocateBuffers();
+
+  /*
+   * @brief createUndistortionMaps
+   *    Build the undistortion tables of both cameras from the
+   *    calibration and report their accuracy.
+   */
+  void createUndistortionMaps();
+
   /*
    * @brief createImagePyramids
-   *    Create image pyramids used for klt tracking.
+   *    Create image pyramids used for klt tracking. The
+   *    pyramids of the two cameras are built in parallel.
    */
   void createImagePyramids();
+  void createImagePyramid(const cv::Mat& img,
+      std::vector<cv::Mat>& pyramid) const;
 
   /*
    * @brief integrateImuData Integrates the IMU gyro readings
@@ -243,16 +338,19 @@ private:
 
   /*
    * @brief twoPointRansac Applies two point ransac algorithm
-   *    to mark the inliers in the input set.
-   * @param pts1: first set of points.
-   * @param pts2: second set of points.
+   *    to mark the inliers in the input set. The random samples
+   *    are seeded so that the result only depends on the input.
+   * @param pts1: first set of undistorted points.
+   * @param pts2: second set of undistorted points.
    * @param R_p_c: a rotation matrix takes a vector in the previous
    *    camera frame to the current camera frame.
    * @param intrinsics: intrinsics of the camera.
-   * @param distortion_model: distortion model of the camera.
-   * @param distortion_coeffs: distortion coefficients.
    * @param inlier_error: acceptable error to be considered as an inlier.
    * @param success_probability: the required probability of success.
+   * @param adaptive_termination: whether to stop once the number
+   *    of iterations is enough for the inlier ratio of the best
+   *    model, rather than after the iterations for a 70% ratio.
+   *    The inliers may then differ from the fixed iterations.
    * @return inlier_flag: 1 for inliers and 0 for outliers.
    */
   void twoPointRansac(
@@ -260,39 +358,29 @@ private:
       const std::vector<cv::Point2f>& pts2,
       const cv::Matx33f& R_p_c,
       const cv::Vec4d& intrinsics,
-      const std::string& distortion_model,
-      const cv::Vec4d& distortion_coeffs,
       const double& inlier_error,
       const double& success_probability,
+      const bool& adaptive_termination,
       std::vector<int>& inlier_markers);
-  void undistortPoints(
-      const std::vector<cv::Point2f>& pts_in,
-      const cv::Vec4d& intrinsics,
-      const std::string& distortion_model,
-      const cv::Vec4d& distortion_coeffs,
-      std::vector<cv::Point2f>& pts_out,
-      const cv::Matx33d &rectification_matrix = cv::Matx33d::eye(),
-      const cv::Vec4d &new_intrinsics = cv::Vec4d(1,1,0,0));
   void rescalePoints(
       std::vector<cv::Point2f>& pts1,
       std::vector<cv::Point2f>& pts2,
       float& scaling_factor);
-  std::vector<cv::Point2f> distortPoints(
-      const std::vector<cv::Point2f>& pts_in,
-      const cv::Vec4d& intrinsics,
-      const std::string& distortion_model,
-      const cv::Vec4d& distortion_coeffs);
 
   /*
    * @brief stereoMatch Matches features with stereo image pairs.
    * @param cam0_points: points in the primary image.
    * @return cam1_points: points in the secondary image.
    * @return inlier_markers: 1 if the match is valid, 0 otherwise.
+   * @return cam0_points_undistorted: cam0_points undistorted.
+   * @return cam1_points_undistorted: cam1_points undistorted.
    */
   void stereoMatch(
       const std::vector<cv::Point2f>& cam0_points,
       std::vector<cv::Point2f>& cam1_points,
-      std::vector<unsigned char>& inlier_markers);
+      std::vector<unsigned char>& inlier_markers,
+      std::vector<cv::Point2f>& cam0_points_undistorted,
+      std::vector<cv::Point2f>& cam1_points_undistorted);
 
   /*
    * @brief removeUnmarkedElements Remove the unmarked elements
@@ -330,8 +418,14 @@ private:
   ProcessorConfig processor_config;
   cv::Ptr<cv::Feature2D> detector_ptr;
 
-  // IMU message buffer.
-  std::vector<sensor_msgs::Imu> imu_msg_buffer;
+  // IMU message buffer, which is shared with the estimator
+  // when both run in one process.
+  ImuBuffer::Ptr imu_buffer;
+  // Sequence number of the next IMU sample to be used.
+  ImuBuffer::SeqType next_imu_seq;
+  // Capacity of the buffer, from the IMU rate and the
+  // worst-case delay before the samples are used.
+  int imu_buffer_capacity;
 
   // Camera calibration parameters
   std::string cam0_distortion_model;
@@ -344,6 +438,11 @@ private:
   cv::Vec4d cam1_intrinsics;
   cv::Vec4d cam1_distortion_coeffs;
 
+  // Undistortion of the pixels of each camera, which is
+  // read from a table built from the calibration.
+  UndistortionMap cam0_undistortion_map;
+  UndistortionMap cam1_undistortion_map;
+
   // Take a vector from cam0 frame to the IMU frame.
   cv::Matx33d R_cam0_imu;
   cv::Vec3d t_cam0_imu;
@@ -366,14 +465,27 @@ private:
   boost::shared_ptr<GridFeatures> prev_features_ptr;
   boost::shared_ptr<GridFeatures> curr_features_ptr;
 
+  // Runs the independent stages of the tracking of the
+  // two cameras and the detection in the grids in parallel.
+  ThreadPool::Ptr tracking_pool;
+
+  // Buffers of the feature detection, which are reused
+  // for every image.
+  std::vector<unsigned char> feature_occupancy;
+  std::vector<int> detection_grids;
+  std::vector<std::vector<cv::KeyPoint> > grid_keypoints;
+  std::vector<cv::KeyPoint> new_keypoints;
+  std::vector<std::vector<cv::KeyPoint> > new_feature_sieve;
+  GridFeatures grid_new_features;
+
   // Number of features after each outlier removal step.
   int before_tracking;
   int after_tracking;
   int after_matching;
   int after_ransac;
 
-  // Ros node handle
-  ros::NodeHandle nh;
+  // Ros node handle, which is null without ros io.
+  boost::shared_ptr<ros::NodeHandle> nh;
 
   // Subscribers and publishers.
   message_filters::Subscriber<
@@ -396,6 +508,11 @@ private:
   ros::Publisher cam0_img_pub;
   image_transport::Publisher debug_stereo_pub;
 
+  // Latency statistics of the stages.
+  LatencyDiagnostics latency_diagnostics;
+
+  FeatureCallback feature_callback;
+
   // Debugging
   std::map<FeatureIDType, int> feature_lifetime;
   void updateFeatureLifetime();
@@ -0,0 +1,153 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_IMU_BUFFER_H
+#define MSCKF_VIO_IMU_BUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <Eigen/Dense>
+#include <boost/shared_ptr.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief ImuSample The part of an IMU message used by the
+ *    estimator and the image processor.
+ */
+struct ImuSample {
+  // Time stamp in seconds.
+  double time;
+  Eigen::Vector3d angular_velocity;
+  Eigen::Vector3d linear_acceleration;
+
+  ImuSample(): time(0.0),
+    angular_velocity(Eigen::Vector3d::Zero()),
+    linear_acceleration(Eigen::Vector3d::Zero()) {}
+};
+
+/*
+ * @brief ImuBuffer Lock-free ring buffer of IMU samples with a
+ *    single producer and any number of consumers.
+ *
+ *    The samples are numbered with a sequence number which
+ *    increases by one for each pushed sample. Consumers keep
+ *    their own read position as a sequence number, so reading
+ *    never removes a sample. Once the buffer is full, the oldest
+ *    samples are overwritten. Each slot is guarded by a sequence
+ *    lock, so a consumer can detect that the sample it read has
+ *    been overwritten concurrently.
+ *
+ *    The time stamps increase with the sequence number, which
+ *    allows range queries with binary search.
+ */
+class ImuBuffer {
+  public:
+    typedef boost::shared_ptr<ImuBuffer> Ptr;
+    typedef std::uint64_t SeqType;
+
+    // The capacity is rounded up to a power of two.
+    ImuBuffer(const int& capacity = 4096);
+
+    // Disable copy and assign constructor
+    ImuBuffer(const ImuBuffer&) = delete;
+    ImuBuffer operator=(const ImuBuffer&) = delete;
+
+    /*
+     * @brief getShared Buffer shared by all the users of the
+     *    given name within the process, e.g. the image processor
+     *    and the estimator subscribing to the same IMU topic.
+     *    The buffer is created with the given capacity by its
+     *    first user, so a later user asking for more has to
+     *    check capacity() on the returned buffer.
+     */
+    static Ptr getShared(const std::string& name,
+        const int& capacity = 4096);
+
+    /*
+     * @brief requiredCapacity Number of samples that the buffer
+     *    has to hold so that none is overwritten before being
+     *    processed, given the IMU rate in Hz and the worst-case
+     *    delay in seconds between receiving and processing.
+     */
+    static int requiredCapacity(const double& imu_rate,
+        const double& max_delay);
+
+    /*
+     * @brief claimProducer Make the owner the producer if there
+     *    is none.
+     * @return True if the owner is the producer.
+     */
+    bool claimProducer(const void* owner);
+
+    // Give up the producer role if the owner has it.
+    void releaseProducer(const void* owner);
+
+    /*
+     * @brief push Append a sample. Must only be called by the
+     *    producer. Samples which are not newer than the last
+     *    one are dropped.
+     * @return True if the sample is added.
+     */
+    bool push(const ImuSample& sample);
+
+    // Sequence number of the oldest sample still stored.
+    SeqType begin() const;
+    // Sequence number following the newest sample.
+    SeqType end() const;
+
+    /*
+     * @brief get Read the sample with the given sequence number.
+     * @return False if the sample has not been pushed yet or has
+     *    been overwritten.
+     */
+    bool get(const SeqType& seq, ImuSample& sample) const;
+
+    /*
+     * @brief lowerBound First sequence number in [first, end())
+     *    whose time stamp is not less than the given time, or
+     *    end() if there is no such sample.
+     */
+    SeqType lowerBound(const double& time, const SeqType& first) const;
+
+    /*
+     * @brief upperBound First sequence number in [first, end())
+     *    whose time stamp is greater than the given time, or
+     *    end() if there is no such sample.
+     */
+    SeqType upperBound(const double& time, const SeqType& first) const;
+
+    int capacity() const { return static_cast<int>(mask + 1); }
+
+  private:
+    struct Slot {
+      // 2*seq+1 while the sample is written, 2*seq+2 after.
+      std::atomic<SeqType> version;
+      // Time, angular velocity and linear acceleration.
+      std::atomic<double> data[7];
+    };
+
+    // Binary search for the first sample in [first, end()) for
+    // which is_after(time stamp) holds. Overwritten samples are
+    // the oldest ones, so they are treated as before the bound.
+    template <typename Predicate>
+    SeqType partitionPoint(const SeqType& first,
+        const Predicate& is_after) const;
+
+    std::unique_ptr<Slot[]> slots;
+    SeqType mask;
+
+    std::atomic<SeqType> head;
+    std::atomic<const void*> producer;
+    double last_time;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_IMU_BUFFER_H
@@ -0,0 +1,150 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_IMU_STATE_TRANSITION_HPP
+#define MSCKF_VIO_IMU_STATE_TRANSITION_HPP
+
+#include <Eigen/Dense>
+
+#include "math_utils.hpp"
+#include "imu_state.h"
+
+namespace msckf_vio {
+
+/*
+ * @brief ImuStateTransition Closed-form transition matrix of the
+ *    21-dim IMU error state [theta, bg, v, ba, p, extrinsics].
+ *
+ *    With the continuous-time error dynamics F, the third order
+ *    series I + F*dt + (F*dt)^2/2 + (F*dt)^3/6 only has non-trivial
+ *    3x3 blocks at the following places:
+ *
+ *           theta     bg      v     ba      p   ext
+ *    theta [Phi_qq  Phi_qbg   0      0      0    0 ]
+ *    bg    [  0       I       0      0      0    0 ]
+ *    v     [Phi_vq  Phi_vbg   I   Phi_vba   0    0 ]
+ *    ba    [  0       0       0      I      0    0 ]
+ *    p     [Phi_pq  Phi_pbg  dt*I Phi_pba   I    0 ]
+ *    ext   [  0       0       0      0      0    I ]
+ *
+ *    Only these blocks are stored, and products with the transition
+ *    matrix only touch the rows of theta, v and p. The top left 15x15
+ *    block is the transition of the IMU error state without the
+ *    extrinsics.
+ */
+struct ImuStateTransition {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  Eigen::Matrix3d Phi_qq;
+  Eigen::Matrix3d Phi_qbg;
+  Eigen::Matrix3d Phi_vq;
+  Eigen::Matrix3d Phi_vbg;
+  Eigen::Matrix3d Phi_vba;
+  Eigen::Matrix3d Phi_pq;
+  Eigen::Matrix3d Phi_pbg;
+  Eigen::Matrix3d Phi_pba;
+  double dt;
+
+  /*
+   * @brief compute Evaluate the blocks of the transition matrix.
+   * @param gyro: angular velocity with the bias removed.
+   * @param acc: linear acceleration with the bias removed.
+   * @param R_w_i: rotation which takes a vector from the world
+   *    frame to the IMU frame.
+   * @param dtime: time interval of the propagation.
+   */
+  inline void compute(const Eigen::Vector3d& gyro,
+      const Eigen::Vector3d& acc, const Eigen::Matrix3d& R_w_i,
+      const double& dtime);
+
+  /*
+   * @brief applyOnTheLeft Perform M = Phi * M in place.
+   * @param M: a matrix with 15 or 21 rows.
+   */
+  inline void applyOnTheLeft(Eigen::Ref<Eigen::MatrixXd> M) const;
+
+  /*
+   * @brief toDense The full NxN transition matrix, where N is
+   *    IMU_STATE_SIZE or IMU_CORE_STATE_SIZE.
+   */
+  template <int N = IMU_STATE_SIZE>
+  inline Eigen::Matrix<double, N, N> toDense() const;
+};
+
+void ImuStateTransition::compute(const Eigen::Vector3d& gyro,
+    const Eigen::Vector3d& acc, const Eigen::Matrix3d& R_w_i,
+    const double& dtime) {
+  dt = dtime;
+  const double dt2 = dt*dt / 2.0;
+  const double dt3 = dt*dt*dt / 6.0;
+
+  // Non-zero blocks of F:
+  //   F_qq = -[w]x, F_qbg = -I,
+  //   F_vq = -R^T*[a]x, F_vba = -R^T,
+  //   F_pv = I.
+  const Eigen::Matrix3d F_qq = -skewSymmetric(gyro);
+  const Eigen::Matrix3d F_vq = -R_w_i.transpose()*skewSymmetric(acc);
+  const Eigen::Matrix3d F_vba = -R_w_i.transpose();
+
+  const Eigen::Matrix3d F_qq_square = F_qq * F_qq;
+  const Eigen::Matrix3d F_vq_qq = F_vq * F_qq;
+
+  Phi_qq = Eigen::Matrix3d::Identity() + F_qq*dt +
+    F_qq_square*dt2 + F_qq_square*F_qq*dt3;
+  Phi_qbg = -(Eigen::Matrix3d::Identity()*dt + F_qq*dt2 +
+    F_qq_square*dt3);
+
+  Phi_vq = F_vq*dt + F_vq_qq*dt2 + F_vq_qq*F_qq*dt3;
+  Phi_vbg = -(F_vq*dt2 + F_vq_qq*dt3);
+  Phi_vba = F_vba*dt;
+
+  Phi_pq = F_vq*dt2 + F_vq_qq*dt3;
+  Phi_pbg = -F_vq*dt3;
+  Phi_pba = F_vba*dt2;
+
+  return;
+}
+
+void ImuStateTransition::applyOnTheLeft(
+    Eigen::Ref<Eigen::MatrixXd> M) const {
+
+  for (int j = 0; j < M.cols(); ++j) {
+    const Eigen::Vector3d m_q = M.col(j).segment<3>(0);
+    const Eigen::Vector3d m_bg = M.col(j).segment<3>(3);
+    const Eigen::Vector3d m_v = M.col(j).segment<3>(6);
+    const Eigen::Vector3d m_ba = M.col(j).segment<3>(9);
+
+    M.col(j).segment<3>(0) = Phi_qq*m_q + Phi_qbg*m_bg;
+    M.col(j).segment<3>(6) += Phi_vq*m_q + Phi_vbg*m_bg + Phi_vba*m_ba;
+    M.col(j).segment<3>(12) += Phi_pq*m_q + Phi_pbg*m_bg +
+      dt*m_v + Phi_pba*m_ba;
+  }
+
+  return;
+}
+
+template <int N>
+Eigen::Matrix<double, N, N> ImuStateTransition::toDense() const {
+  Eigen::Matrix<double, N, N> Phi =
+    Eigen::Matrix<double, N, N>::Identity();
+
+  Phi.template block<3, 3>(0, 0) = Phi_qq;
+  Phi.template block<3, 3>(0, 3) = Phi_qbg;
+  Phi.template block<3, 3>(6, 0) = Phi_vq;
+  Phi.template block<3, 3>(6, 3) = Phi_vbg;
+  Phi.template block<3, 3>(6, 9) = Phi_vba;
+  Phi.template block<3, 3>(12, 0) = Phi_pq;
+  Phi.template block<3, 3>(12, 3) = Phi_pbg;
+  Phi.template block<3, 3>(12, 6) = Eigen::Matrix3d::Identity()*dt;
+  Phi.template block<3, 3>(12, 9) = Phi_pba;
+
+  return Phi;
+}
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_IMU_STATE_TRANSITION_HPP
@@ -0,0 +1,46 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_LATENCY_DIAGNOSTICS_H
+#define MSCKF_VIO_LATENCY_DIAGNOSTICS_H
+
+#include <string>
+#include <ros/ros.h>
+
+#include "latency_tracer.h"
+
+namespace msckf_vio {
+
+/*
+ * @brief LatencyDiagnostics Enables the latency tracer and
+ *    periodically publishes the latency statistics of the stages
+ *    of one node as diagnostic_msgs::DiagnosticArray on "latency".
+ *
+ *    Parameters:
+ *    latency_tracing: Whether to record the latency.
+ *    latency_trace_file: Chrome trace file, or empty for none.
+ *    latency_diagnostics_period: Seconds between two messages.
+ */
+class LatencyDiagnostics {
+  public:
+    /*
+     * @brief initialize Read the parameters and start publishing.
+     * @param prefix Prefix of the names of the stages to publish.
+     */
+    bool initialize(ros::NodeHandle& nh, const std::string& prefix);
+
+  private:
+    void timerCallback(const ros::TimerEvent& event);
+
+    std::string prefix;
+    ros::Publisher latency_pub;
+    ros::Timer timer;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_LATENCY_DIAGNOSTICS_H
@@ -0,0 +1,190 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_LATENCY_TRACER_H
+#define MSCKF_VIO_LATENCY_TRACER_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <condition_variable>
+
+#include "spsc_queue.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief TraceEvent One execution of a pipeline stage.
+ */
+struct TraceEvent {
+  // Name of the stage, which must be a string literal.
+  const char* name;
+  // Start time and duration in nanoseconds.
+  std::int64_t start;
+  std::int64_t duration;
+};
+
+/*
+ * @brief StageStatistics Latency of a stage over the most recent
+ *    executions, in milliseconds.
+ */
+struct StageStatistics {
+  std::string name;
+  // Total number of executions.
+  long count;
+  double p50;
+  double p95;
+  double p99;
+  double max;
+};
+
+/*
+ * @brief LatencyTracer Process-wide recorder of the latency of
+ *    the pipeline stages.
+ *
+ *    Each thread records its events into its own lock-free queue,
+ *    so recording never blocks. A background thread collects the
+ *    events, keeps a window of the latest durations of each stage,
+ *    and optionally writes all the events into a trace file in the
+ *    Chrome trace event format, which can be opened in
+ *    chrome://tracing or Perfetto.
+ *
+ *    Nothing is recorded before the tracer is enabled.
+ */
+class LatencyTracer {
+  public:
+    static LatencyTracer& instance();
+
+    // Disable copy and assign constructor
+    LatencyTracer(const LatencyTracer&) = delete;
+    LatencyTracer operator=(const LatencyTracer&) = delete;
+
+    /*
+     * @brief enable Start recording. The tracer is shared by all
+     *    the nodes in the process, so only the first call with a
+     *    non-empty file opens the trace file.
+     * @param trace_file Trace file, or empty to only keep the
+     *    statistics.
+     * @return False if the trace file cannot be opened, or another
+     *    trace file is already used.
+     */
+    bool enable(const std::string& trace_file);
+
+    bool isEnabled() const {
+      return is_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Monotonic time in nanoseconds.
+    static std::int64_t now();
+
+    // Record an event of the calling thread. Never blocks.
+    void record(const char* name,
+        const std::int64_t& start, const std::int64_t& duration);
+
+    /*
+     * @brief statistics Statistics of the stages whose names start
+     *    with the given prefix, in the order of the names.
+     */
+    void statistics(const std::string& prefix,
+        std::vector<StageStatistics>& stats);
+
+    // Number of events dropped because a queue was full.
+    long droppedNum() const { return dropped_num; }
+
+    // Number of buffers allocated so far. The buffer of a thread
+    // is reused by the next thread after it exits.
+    int threadBufferNum();
+
+    // Number of durations kept for each stage.
+    static const int window_size = 1024;
+
+  private:
+    LatencyTracer();
+    ~LatencyTracer();
+
+    struct ThreadBuffer {
+      SpscQueue<TraceEvent> events;
+      int thread_id;
+      // Whether no thread owns the buffer.
+      bool is_free;
+      ThreadBuffer(const int& id):
+        events(4096), thread_id(id), is_free(false) {}
+    };
+
+    struct StageWindow {
+      std::vector<double> durations;
+      int next;
+      long count;
+      StageWindow(): next(0), count(0) {}
+    };
+
+    ThreadBuffer* threadBuffer();
+    void collectorLoop();
+    // Move the recorded events into the windows and the trace file.
+    // Must be called with collect_mutex locked.
+    void collect();
+    void writeEvent(const TraceEvent& event, const int& thread_id);
+
+    std::atomic<bool> is_enabled;
+    std::atomic<long> dropped_num;
+
+    // Buffers of the threads that recorded events, including
+    // the free ones left by exited threads.
+    std::mutex buffer_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer> > buffers;
+
+    // Collected events.
+    std::mutex collect_mutex;
+    std::map<std::string, StageWindow> windows;
+    std::string trace_file;
+    std::FILE* trace;
+    bool is_first_event;
+
+    std::thread collector;
+    std::condition_variable stop_cond;
+    bool stop;
+};
+
+/*
+ * @brief ScopedTrace Records the time between its construction
+ *    and destruction as an event of the given stage.
+ */
+class ScopedTrace {
+  public:
+    // The name must be a string literal.
+    explicit ScopedTrace(const char* name):
+      name(name), start(LatencyTracer::now()) {}
+
+    ~ScopedTrace() {
+      LatencyTracer& tracer = LatencyTracer::instance();
+      if (tracer.isEnabled())
+        tracer.record(name, start, LatencyTracer::now()-start);
+    }
+
+    // Disable copy and assign constructor
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace operator=(const ScopedTrace&) = delete;
+
+    // Seconds since the construction.
+    double elapsed() const {
+      return 1e-9 * (LatencyTracer::now()-start);
+    }
+
+  private:
+    const char* name;
+    const std::int64_t start;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_LATENCY_TRACER_H
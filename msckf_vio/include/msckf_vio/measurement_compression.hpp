@@ -0,0 +1,154 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_MEASUREMENT_COMPRESSION_HPP
+#define MSCKF_VIO_MEASUREMENT_COMPRESSION_HPP
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Eigen/Householder>
+
+namespace msckf_vio {
+
+/*
+ * @brief projectLeftNullspace Project the stacked [H_f | H_x | r]
+ *    of a feature onto the left nullspace of its first cols_f
+ *    columns H_f in place.
+ *
+ *    The Householder reflections of the QR decomposition of H_f
+ *    are applied to all the following columns. The last
+ *    rows-cols_f rows of these columns then hold V^T*[H_x | r],
+ *    with V being an orthonormal basis of the left nullspace of
+ *    H_f, and the first cols_f columns hold the reflectors. This
+ *    replaces forming V from the SVD of H_f and multiplying it
+ *    with the Jacobian.
+ */
+inline void projectLeftNullspace(
+    Eigen::MatrixXd& A, const int& cols_f) {
+  Eigen::VectorXd workspace(A.cols());
+  for (int j = 0; j < cols_f; ++j) {
+    const int size = A.rows() - j;
+    double tau = 0.0;
+    double beta = 0.0;
+    A.col(j).tail(size).makeHouseholderInPlace(tau, beta);
+    A.bottomRightCorner(size, A.cols()-j-1).applyHouseholderOnTheLeft(
+        A.col(j).tail(size-1), tau, workspace.data());
+  }
+  return;
+}
+
+/*
+ * @brief compressMeasurement Compute H_thin = Q1^T*H and
+ *    r_thin = Q1^T*r, where H = [Q1 Q2]*[R; 0] is the QR
+ *    decomposition of the stacked measurement Jacobian.
+ *
+ *    After the nullspace projection, the rows of each feature
+ *    only touch the columns of the camera states observing it,
+ *    and the columns of the IMU state are all zero. The rows are
+ *    stably sorted by their first non-zero column, which gives H
+ *    a staircase shape. Each Householder reflection then only
+ *    mixes the rows whose first non-zero column has been reached,
+ *    and only updates the columns up to the last non-zero column
+ *    of these rows. Leading zero columns are never touched, and
+ *    zero columns in between are skipped.
+ *
+ *    The returned H_thin has one row for each eliminated column,
+ *    which is at most the number of columns of H. Rows of Q^T*H
+ *    which are zero carry no information on the state and are
+ *    dropped together with their residuals.
+ */
+inline void compressMeasurement(
+    const Eigen::MatrixXd& H, const Eigen::VectorXd& r,
+    Eigen::MatrixXd& H_thin, Eigen::VectorXd& r_thin) {
+
+  const int rows = H.rows();
+  const int cols = H.cols();
+
+  // Find the first and last non-zero column of each row.
+  std::vector<int> first_col(rows, cols);
+  std::vector<int> last_col(rows, -1);
+  for (int j = 0; j < cols; ++j) {
+    for (int i = 0; i < rows; ++i) {
+      if (H(i, j) == 0.0) continue;
+      if (first_col[i] == cols) first_col[i] = j;
+      last_col[i] = j;
+    }
+  }
+
+  std::vector<int> order(rows);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+      [&first_col](const int& a, const int& b) {
+        return first_col[a] < first_col[b];
+      });
+
+  // Rows which are all zero are sorted to the end and dropped.
+  int valid_rows = rows;
+  while (valid_rows > 0 && first_col[order[valid_rows-1]] == cols)
+    --valid_rows;
+
+  // Only the columns from the first non-zero one are stored.
+  const int col_offset = valid_rows > 0 ? first_col[order[0]] : cols;
+  const int valid_cols = cols - col_offset;
+
+  Eigen::MatrixXd W(valid_rows, valid_cols);
+  Eigen::VectorXd w(valid_rows);
+  for (int i = 0; i < valid_rows; ++i) {
+    W.row(i) = H.row(order[i]).tail(valid_cols);
+    w(i) = r(order[i]);
+  }
+
+  Eigen::VectorXd workspace(valid_cols+1);
+  int pivot = 0;
+  int row_end = 0;
+  int col_end = col_offset;
+
+  for (int j = col_offset; j < cols && pivot < valid_rows; ++j) {
+    // Add the rows starting at this column into the active set.
+    while (row_end < valid_rows && first_col[order[row_end]] <= j) {
+      col_end = std::max(col_end, last_col[order[row_end]]+1);
+      ++row_end;
+    }
+
+    const int size = row_end - pivot;
+    if (size <= 0) continue;
+
+    // Columns which are zero in all the active rows, e.g. of
+    // unused camera state slots, do not consume a pivot.
+    const int jw = j - col_offset;
+    if (W.col(jw).segment(pivot, size).isZero(0.0)) continue;
+
+    if (size > 1) {
+      double tau = 0.0;
+      double beta = 0.0;
+      W.col(jw).segment(pivot, size).makeHouseholderInPlace(tau, beta);
+
+      const auto essential = W.col(jw).segment(pivot+1, size-1);
+      W.block(pivot, jw+1, size, col_end-j-1).applyHouseholderOnTheLeft(
+          essential, tau, workspace.data());
+      w.segment(pivot, size).applyHouseholderOnTheLeft(
+          essential, tau, workspace.data());
+
+      W(pivot, jw) = beta;
+      W.col(jw).segment(pivot+1, size-1).setZero();
+    }
+
+    ++pivot;
+  }
+
+  H_thin = Eigen::MatrixXd::Zero(pivot, cols);
+  H_thin.rightCols(valid_cols) = W.topRows(pivot);
+  r_thin = w.head(pivot);
+
+  return;
+}
+
+} // end namespace msckf_vio
+
+#endif // MSCKF_VIO_MEASUREMENT_COMPRESSION_HPP
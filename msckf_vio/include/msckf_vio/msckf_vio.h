@@ -10,10 +10,12 @@
 
 #include <map>
 #include <set>
+#include <deque>
 #include <vector>
 #include <string>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 
 
@@ -26,6 +28,7 @@
 #include <ros/ros.h>
 #include <sensor_msgs/Imu.h>
 #include <nav_msgs/Odometry.h>
+#include <geometry_msgs/PoseStamped.h>
 #include <tf/transform_broadcaster.h>
 #include <std_srvs/Trigger.h>
 
@@ -33,6 +36,15 @@
 #include "imu_state.h"
 #include "cam_state.h"
 #include "feature.hpp"
+#include "imu_state_transition.hpp"
+#include "state_covariance.h"
+#include "square_root_covariance.h"
+#include "thread_pool.h"
+#include "imu_buffer.h"
+#include "trajectory_logger.h"
+#include "feature_cloud_publisher.h"
+#include "latency_diagnostics.h"
+#include "parameter_reader.h"
 #include <msckf_vio/CameraMeasurement.h>
 
 #include "initial_sfm/initial_sfm.h"
@@ -51,27 +63,65 @@ class MsckfVio {
 
     // Constructor
     MsckfVio(ros::NodeHandle& pnh);
+    // Constructor without any ros io, e.g. to process a dataset
+    // without a master, see initialize(params).
+    MsckfVio();
     // Disable copy and assign constructor
     MsckfVio(const MsckfVio&) = delete;
     MsckfVio operator=(const MsckfVio&) = delete;
 
     // Destructor
-    ~MsckfVio() {}
+    ~MsckfVio() {
+      if (imu_buffer) imu_buffer->releaseProducer(this);
+    }
 
     /*
      * @brief initialize Initialize the VIO.
      */
     bool initialize();
 
+    /*
+     * @brief initialize Initialize the VIO with the given
+     *    parameters. The topics are only advertised and subscribed
+     *    if the object is constructed with a node handle.
+     * @param imu_buffer: the IMU samples shared with the image
+     *    processor. If null, the buffer is shared through the
+     *    resolved IMU topic with a node handle, and private to
+     *    the VIO without one.
+     */
+    bool initialize(const ParameterReader& params,
+        const ImuBuffer::Ptr& imu_buffer = ImuBuffer::Ptr());
+
     /*
      * @brief reset Resets the VIO to initial status.
      */
     void reset();
 
+    /*
+     * @brief processImu, processFeatures Process the msgs directly,
+     *    e.g. when the sensor data are read from a dataset instead
+     *    of being subscribed.
+     */
+    void processImu(const sensor_msgs::ImuConstPtr& msg) {
+      imuCallback(msg);
+    }
+    void processFeatures(const CameraMeasurementConstPtr& msg) {
+      featureCallback(msg);
+    }
+
+    // Called with the IMU state whenever the results are published.
+    typedef boost::function<void(const IMUState&)> StateCallback;
+    void setStateCallback(const StateCallback& callback) {
+      state_callback = callback;
+    }
+
     typedef boost::shared_ptr<MsckfVio> Ptr;
     typedef boost::shared_ptr<const MsckfVio> ConstPtr;
 
   private:
+    // Runs the filter kernels on synthetic data.
+    friend class MsckfVioBenchmark;
+
     /*
      * @brief StateServer Store one IMU states and several
      *    camera states for constructing measurement
@@ -82,16 +132,63 @@ class MsckfVio {
       CamStateServer cam_states;
 
       // State covariance matrix
-      Eigen::MatrixXd state_cov;
+      StateCovariance state_cov;
+      // Square-root factor of the state covariance. If set, it
+      // replaces state_cov, which then only holds the initial
+      // covariance of the IMU state.
+      SquareRootCovarianceBase::Ptr state_cov_factor;
       Eigen::Matrix<double, 12, 12> continuous_noise_cov;
     };
 
+    /*
+     * @brief SensorConfig Noise parameters and extrinsics of
+     *    the sensors, which are shared by all the states of
+     *    the filter.
+     */
+    struct SensorConfig {
+      EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+      // Process noise
+      double gyro_noise;
+      double acc_noise;
+      double gyro_bias_noise;
+      double acc_bias_noise;
+
+      // Noise for a normalized feature measurement.
+      double observation_noise;
+
+      // Gravity vector in the world frame
+      Eigen::Vector3d gravity;
+
+      // Transformation offset from the IMU frame to
+      // the body frame. The transformation takes a
+      // vector from the IMU frame to the body frame.
+      // The z axis of the body frame should point upwards.
+      // Normally, this transform should be identity.
+      Eigen::Isometry3d T_imu_body;
+
+      // Takes a vector from the cam0 frame to the cam1 frame.
+      Eigen::Isometry3d T_cam0_cam1;
+
+      SensorConfig():
+        gyro_noise(0.001),
+        acc_noise(0.01),
+        gyro_bias_noise(0.001),
+        acc_bias_noise(0.01),
+        observation_noise(0.01),
+        gravity(0.0, 0.0, -GRAVITY_ACCELERATION),
+        T_imu_body(Eigen::Isometry3d::Identity()),
+        T_cam0_cam1(Eigen::Isometry3d::Identity()) {
+        return;
+      }
+    };
+
 
     /*
      * @brief loadParameters
-     *    Load parameters from the parameter server.
+     *    Load parameters from the parameter server or a file.
      */
-    bool loadParameters();
+    bool loadParameters(const ParameterReader& params);
 
     /*
      * @brief createRosIO
@@ -119,12 +216,33 @@ class MsckfVio {
      */
     void publish(const ros::Time& time);
 
+    /*
+     * @brief resetImuRateState Restart the IMU rate propagation
+     *    from the latest estimate, and catch up with the IMU msgs
+     *    received after it.
+     */
+    void resetImuRateState();
+
+    /*
+     * @brief propagateImuRateState Propagate the IMU rate state
+     *    with an IMU msg. The covariance is not propagated.
+     * @return True if the state is propagated.
+     */
+    bool propagateImuRateState(const ImuSample& sample);
+
+    /*
+     * @brief publishImuRateOdom Publish the IMU rate state.
+     * @param time The time stamp of output msgs.
+     */
+    void publishImuRateOdom(const ros::Time& time);
+
     /*
      * @brief initializegravityAndBias
      *    Initialize the IMU bias and initial orientation
      *    based on the first few IMU readings.
+     * @return False if no reading is available.
      */
-    void initializeGravityAndBias();
+    bool initializeGravityAndBias();
 
     /*
      * @biref resetCallback
@@ -143,12 +261,29 @@ class MsckfVio {
     void processModel(const double& time,
         const Eigen::Vector3d& m_gyro,
         const Eigen::Vector3d& m_acc);
-    void predictNewState(const double& dt,
+    // Perform P11 = Phi*(P11+Q)*Phi^T on the IMU block of the dense
+    // covariance, and P12 = Phi*P12 unless it is deferred. N is the
+    // size of the IMU state.
+    template <int N>
+    void propagateStateCovariance(const ImuStateTransition& Phi,
+        const Eigen::Matrix<double, 12, 12>& Q);
+    // Apply the transition of the batch to the IMU-camera cross
+    // covariance of the dense covariance.
+    template <int N>
+    void propagateBatchCrossCovariance();
+    static void predictNewState(const double& dt,
         const Eigen::Vector3d& gyro,
-        const Eigen::Vector3d& acc);
+        const Eigen::Vector3d& acc,
+        const Eigen::Vector3d& gravity,
+        IMUState& imu_state);
 
     // Measurement update
     void stateAugmentation(const double& time);
+    // Fill in the dense covariance of the camera state x_c = J*x_imu
+    // in the given slot.
+    template <int N>
+    void augmentStateCovariance(
+        const Eigen::Matrix<double, 6, 21>& J, const int& slot);
     void addFeatureObservations(const CameraMeasurementConstPtr& msg);
     // This function is used to compute the measurement Jacobian
     // for a single feature observed at a single camera frame.
@@ -156,38 +291,109 @@ class MsckfVio {
         const FeatureIDType& feature_id,
         Eigen::Matrix<double, 4, 6>& H_x,
         Eigen::Matrix<double, 4, 3>& H_f,
-        Eigen::Vector4d& r);
+        Eigen::Vector4d& r) const;
     // This function computes the Jacobian of all measurements viewed
     // in the given camera states of this feature.
     void featureJacobian(const FeatureIDType& feature_id,
         const std::vector<StateIDType>& cam_state_ids,
-        Eigen::MatrixXd& H_x, Eigen::VectorXd& r);
+        Eigen::MatrixXd& H_x, Eigen::VectorXd& r) const;
     void measurementUpdate(const Eigen::MatrixXd& H,
         const Eigen::VectorXd& r);
     bool gatingTest(const Eigen::MatrixXd& H,
-        const Eigen::VectorXd&r, const int& dof);
+        const Eigen::VectorXd&r, const int& dof) const;
+    // Compute the Jacobians of the given features and run the
+    // gating test on them in parallel. The Jacobians passing the
+    // test are stacked in the order of the input features, up to
+    // and including the one exceeding max_row_size, and the
+    // features after it are not processed.
+    void stackFeatureJacobians(
+        const std::vector<FeatureIDType>& feature_ids,
+        const std::vector<std::vector<StateIDType> >& cam_state_ids,
+        const std::vector<int>& dofs, const int& max_row_size,
+        Eigen::MatrixXd& H_x, Eigen::VectorXd& r);
+    // Check the motion of the given features and initialize their
+    // positions in parallel. The camera poses are computed once
+    // and shared by all the features.
+    void initializeFeatures(const std::vector<Feature*>& features,
+        std::vector<char>& is_valid);
     void removeLostFeatures();
     void findRedundantCamStates(
         std::vector<StateIDType>& rm_cam_state_ids);
     void pruneCamStateBuffer();
     // Reset the system online if the uncertainty is too large.
     void onlineReset();
+    // Reset the state covariance to the initial covariance of the
+    // IMU state given by the parameters. All the slots are unused.
+    void resetStateCovariance();
+    // Initial covariance of the velocity, the biases and the
+    // extrinsics.
+    double velocity_cov;
+    double gyro_bias_cov;
+    double acc_bias_cov;
+    double extrinsic_rotation_cov;
+    double extrinsic_translation_cov;
+    // Covariance of the IMU state without the extrinsics from
+    // either covariance backend.
+    Eigen::Matrix<double, 15, 15> imuStateCovariance() const;
     // void drawFeaturesStereo();
     // Chi squared test table.
-    static std::map<int, double> chi_squared_test_table;
+    std::map<int, double> chi_squared_test_table;
+
+    // Sensor parameters
+    SensorConfig sensor_config;
+    // Optimization configuration for solving the 3d
+    // positions of the features.
+    Feature::OptimizationConfig optimization_config;
 
     // State vector
     StateServer state_server;
+    // id for next IMU state
+    StateIDType next_state_id;
     // Maximum number of camera states
     int max_cam_state_size;
 
+    // Size of the IMU error state, which is IMU_STATE_SIZE if the
+    // IMU-camera extrinsics are estimated online, and
+    // IMU_CORE_STATE_SIZE for calibrated rigs otherwise. The
+    // camera state in slot i is at imu_state_size+6*i.
+    int imu_state_size;
+
+    // If set, the IMU-camera cross covariance is not propagated
+    // on every IMU message. The transition matrices of all IMU
+    // messages between two images are accumulated instead, and
+    // applied to the cross covariance once before the state
+    // augmentation. This makes the cost of the IMU propagation
+    // independent of the number of camera states.
+    bool defer_cross_cov_propagation;
+    // Product of the IMU transition matrices in the current batch.
+    // Its top left block is the transition without the extrinsics.
+    Eigen::Matrix<double, 21, 21> batch_transition;
+
     // Features used
     MapServer map_server;
 
+    // Threads used to compute the feature Jacobians and to
+    // triangulate the features.
+    ThreadPool::Ptr jacobian_pool;
+
     // IMU data buffer
     // This is buffer is used to handle the unsynchronization or
-    // transfer delay between IMU and Image messages.
-    std::vector<sensor_msgs::Imu> imu_msg_buffer;
+    // transfer delay between IMU and Image messages. It is shared
+    // with the image processor when both run in one process.
+    ImuBuffer::Ptr imu_buffer;
+    // Sequence number of the next IMU sample to be processed.
+    ImuBuffer::SeqType next_imu_seq;
+    // Capacity of the buffer, from the IMU rate and the
+    // worst-case delay before the samples are processed.
+    int imu_buffer_capacity;
+
+    // Latest estimate propagated with the IMU msgs received after
+    // the last update, which is published at the IMU rate.
+    bool publish_imu_rate_odom;
+    bool is_imu_rate_state_valid;
+    IMUState imu_rate_state;
+    // Bias corrected angular velocity of the last IMU msg.
+    Eigen::Vector3d imu_rate_gyro;
 
     // Indicate if the gravity vector is set.
     bool is_gravity_set;
@@ -202,6 +408,8 @@ class MsckfVio {
     // Note this online reset will be some dead-reckoning.
     // Set this threshold to nonpositive to disable online reset.
     double position_std_threshold;
+    // Number of online resets performed so far.
+    long long int online_reset_counter;
 
     // Tracking rate
     double tracking_rate;
@@ -211,19 +419,42 @@ class MsckfVio {
     double rotation_threshold;
     double tracking_rate_threshold;
 
-    // Ros node handle
-    ros::NodeHandle nh;
+    // Ros node handle, which is null without ros io.
+    boost::shared_ptr<ros::NodeHandle> nh;
 
     // Subscribers and publishers
     ros::Subscriber imu_sub;
     ros::Subscriber feature_sub;
     ros::Publisher odom_pub;
+    ros::Publisher imu_rate_odom_pub;
     ros::Publisher feature_pub;
-    tf::TransformBroadcaster tf_pub;
+    // Publishes the initialized features in the background,
+    // which is null without ros io.
+    FeatureCloudPublisher::Ptr feature_cloud;
+    // Maximum rate of the feature point cloud in Hz.
+    double feature_cloud_rate;
+    // Advertises on construction, so it is created with the
+    // other publishers.
+    boost::shared_ptr<tf::TransformBroadcaster> tf_pub;
     ros::ServiceServer reset_srv;
+    // Latency statistics of the stages.
+    LatencyDiagnostics latency_diagnostics;
+    StateCallback state_callback;
     // image_transport::Publisher debug_stereo_pub;
     // ---trajectory-----
     ros::Publisher pub_vio_path;
+    // Every new pose is also published alone, so subscribers can
+    // rebuild the full trajectory without the path being resent.
+    ros::Publisher pub_vio_pose;
+    // Poses of the published path. Only the latest path_max_length
+    // poses are kept if it is positive, and only every
+    // path_decimation-th pose is added.
+    std::deque<geometry_msgs::PoseStamped> vio_path_poses;
+    int path_max_length;
+    int path_decimation;
+    long path_pose_count;
+    // Writes the estimated poses to a file, if set.
+    TrajectoryLogger::Ptr trajectory_logger;
 
     // Frame id
     std::string fixed_frame_id;
@@ -243,6 +474,7 @@ class MsckfVio {
 
     ros::Subscriber mocap_odom_sub;
     ros::Publisher mocap_odom_pub;
+    bool first_mocap_odom_msg;
     geometry_msgs::TransformStamped raw_mocap_odom_msg;
     Eigen::Isometry3d mocap_initial_frame;
     
@@ -0,0 +1,99 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_PARAMETER_READER_H
+#define MSCKF_VIO_PARAMETER_READER_H
+
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <yaml-cpp/yaml.h>
+
+namespace msckf_vio {
+
+/*
+ * @brief ParameterReader Reads the parameters of an object either
+ *    from the parameter server through a node handle, or from a
+ *    YAML node, so that the object can run without a master.
+ *
+ *    The names are relative to the node handle or the YAML node,
+ *    and "/" separates the keys of nested maps in the YAML node,
+ *    e.g. "cam0/intrinsics".
+ */
+class ParameterReader {
+  public:
+    // Not explicit, so that a node handle can be passed wherever
+    // the parameters are read.
+    ParameterReader(const ros::NodeHandle& nh);
+    explicit ParameterReader(const YAML::Node& node);
+
+    /*
+     * @brief loadFile Load a YAML file.
+     * @return False if the file cannot be read or parsed.
+     */
+    static bool loadFile(const std::string& file_name, YAML::Node& node);
+
+    /*
+     * @brief getParam Same as ros::NodeHandle::getParam for the
+     *    scalars and the vectors of scalars.
+     * @return False if the parameter is missing or has another
+     *    type, in which case the value is left unchanged.
+     */
+    template <typename T>
+    bool getParam(const std::string& name, T& value) const;
+
+    // Matrix given as a list of rows, e.g. a Kalibr transform.
+    bool getParam(const std::string& name,
+        std::vector<std::vector<double> >& value) const;
+
+    // Same as ros::NodeHandle::param.
+    template <typename T>
+    void param(const std::string& name, T& value,
+        const T& default_value) const {
+      if (!getParam(name, value)) value = default_value;
+    }
+
+  private:
+    // The node with the given name, which is undefined if any of
+    // the keys is missing.
+    YAML::Node find(const std::string& name) const;
+
+    // Convert a node, throwing YAML::Exception if it has another
+    // type. The integers are also read from floating point values,
+    // e.g. the resolution in some calibration files, which the
+    // parameter server accepts as well.
+    template <typename T>
+    static void convert(const YAML::Node& node, T& value) {
+      value = node.as<T>();
+    }
+    static void convert(const YAML::Node& node, int& value);
+    static void convert(const YAML::Node& node, std::vector<int>& value);
+
+    // Null if the parameters are read from the YAML node.
+    const ros::NodeHandle* nh;
+    YAML::Node node;
+};
+
+template <typename T>
+bool ParameterReader::getParam(const std::string& name, T& value) const {
+  if (nh) return nh->getParam(name, value);
+
+  const YAML::Node value_node = find(name);
+  if (!value_node.IsDefined() || value_node.IsNull()) return false;
+  try {
+    T converted_value;
+    convert(value_node, converted_value);
+    value = converted_value;
+  } catch (const YAML::Exception&) {
+    return false;
+  }
+  return true;
+}
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_PARAMETER_READER_H
@@ -15,6 +15,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <msckf_vio/CameraMeasurement.h>
+#include <msckf_vio/latency_diagnostics.h>
 // #include <cuda_provider_factory.h>
 #include <onnxruntime_cxx_api.h>
 #include <cpu_provider_factory.h>
@@ -100,6 +101,9 @@ private:
     ros::Publisher feature_pub;
 
     image_transport::Publisher debug_stereo_pub;    
+
+    // Latency statistics of the stages.
+    LatencyDiagnostics latency_diagnostics;
     
     // YOLOv5
     float Sigmoid(float x){
@@ -0,0 +1,64 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_SLOT_ITERATOR_HPP
+#define MSCKF_VIO_SLOT_ITERATOR_HPP
+
+#include <vector>
+#include <cstddef>
+#include <iterator>
+
+namespace msckf_vio {
+
+/*
+ * @brief SlotIterator Bidirectional iterator over a store which
+ *    keeps its elements in the slots of a flat buffer, and a list
+ *    of the used slots in the order of iteration.
+ *
+ *    The store should provide the buffer as a member `slots` and
+ *    declare the iterator as a friend.
+ */
+template <typename Server, typename Value>
+class SlotIterator {
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef Value value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Value* pointer;
+    typedef Value& reference;
+
+    SlotIterator(): server(nullptr) {}
+    SlotIterator(Server* s, const std::vector<int>::const_iterator& p):
+      server(s), pos(p) {}
+    // Conversion from iterator to const_iterator.
+    template <typename OtherServer, typename OtherValue>
+    SlotIterator(const SlotIterator<OtherServer, OtherValue>& other):
+      server(other.server), pos(other.pos) {}
+
+    reference operator*() const { return server->slots[*pos]; }
+    pointer operator->() const { return &server->slots[*pos]; }
+
+    // Slot of the element.
+    int slot() const { return *pos; }
+
+    SlotIterator& operator++() { ++pos; return *this; }
+    SlotIterator& operator--() { --pos; return *this; }
+    SlotIterator operator++(int) { SlotIterator tmp(*this); ++pos; return tmp; }
+    SlotIterator operator--(int) { SlotIterator tmp(*this); --pos; return tmp; }
+
+    bool operator==(const SlotIterator& other) const { return pos == other.pos; }
+    bool operator!=(const SlotIterator& other) const { return pos != other.pos; }
+
+  private:
+    template <typename, typename> friend class SlotIterator;
+    Server* server;
+    std::vector<int>::const_iterator pos;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_SLOT_ITERATOR_HPP
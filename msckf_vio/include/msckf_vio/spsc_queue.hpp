@@ -0,0 +1,85 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_SPSC_QUEUE_HPP
+#define MSCKF_VIO_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace msckf_vio {
+
+/*
+ * @brief SpscQueue Bounded lock-free queue with a single producer
+ *    and a single consumer.
+ *
+ *    Neither side ever blocks: push fails if the queue is full and
+ *    pop fails if it is empty. The element type should be cheap to
+ *    copy since elements are copied in and out of the slots.
+ */
+template <typename T>
+class SpscQueue {
+  public:
+    // The capacity is rounded up to a power of two.
+    SpscQueue(const std::size_t& capacity = 1024):
+      head(0), tail(0) {
+      std::size_t size = 1;
+      while (size < capacity) size <<= 1;
+      slots.reset(new T[size]);
+      mask = size - 1;
+    }
+
+    // Disable copy and assign constructor
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue operator=(const SpscQueue&) = delete;
+
+    /*
+     * @brief push Append an element. Producer only.
+     * @return False if the queue is full.
+     */
+    bool push(const T& value) {
+      const std::size_t t = tail.load(std::memory_order_relaxed);
+      if (t - head.load(std::memory_order_acquire) > mask) return false;
+      slots[t & mask] = value;
+      tail.store(t+1, std::memory_order_release);
+      return true;
+    }
+
+    /*
+     * @brief pop Remove the oldest element. Consumer only.
+     * @return False if the queue is empty.
+     */
+    bool pop(T& value) {
+      const std::size_t h = head.load(std::memory_order_relaxed);
+      if (h == tail.load(std::memory_order_acquire)) return false;
+      value = slots[h & mask];
+      head.store(h+1, std::memory_order_release);
+      return true;
+    }
+
+    bool empty() const {
+      return head.load(std::memory_order_acquire) ==
+        tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const { return mask + 1; }
+
+  private:
+    std::unique_ptr<T[]> slots;
+    std::size_t mask;
+
+    // Keep the two indices on separate cache lines.
+    char pad0[64];
+    std::atomic<std::size_t> head;
+    char pad1[64];
+    std::atomic<std::size_t> tail;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_SPSC_QUEUE_HPP
@@ -0,0 +1,340 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_SQUARE_ROOT_COVARIANCE_H
+#define MSCKF_VIO_SQUARE_ROOT_COVARIANCE_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Eigen/Householder>
+#include <boost/shared_ptr.hpp>
+
+#include "imu_state.h"
+
+namespace msckf_vio {
+
+/*
+ * @brief SquareRootCovarianceBase Interface of the state
+ *    uncertainty kept as an upper triangular factor U with
+ *    P = U^T*U.
+ *
+ *    All the arguments and results are given in the state layout
+ *    used by the filter, i.e. the 15 or 21-dim IMU state followed
+ *    by 6 dims for each camera state slot. Unused slots have zero
+ *    covariance and are not part of the factor. The transition
+ *    and the augmentation Jacobian always cover the 21-dim IMU
+ *    state, and the extrinsic parts are ignored without them in
+ *    the state. The scalar type and the IMU state size of the
+ *    factor are hidden behind this interface so that the backend
+ *    can be selected at run time.
+ */
+class SquareRootCovarianceBase {
+  public:
+    typedef boost::shared_ptr<SquareRootCovarianceBase> Ptr;
+
+    virtual ~SquareRootCovarianceBase() {}
+
+    /*
+     * @brief reset Reset to a diagonal covariance of the
+     *    IMU state with the given variances. All the camera
+     *    state slots are unused.
+     */
+    virtual void reset(const Eigen::VectorXd& variance,
+        const int& slot_num) = 0;
+
+    /*
+     * @brief resize Change the number of camera state slots.
+     *    Slots in use are kept.
+     */
+    virtual void resize(const int& slot_num) = 0;
+
+    /*
+     * @brief propagate Perform P11 = Phi*(P11+Q)*Phi^T on the
+     *    IMU block, where Q is the noise of the first 12 states.
+     *    The IMU-camera cross terms are not changed.
+     */
+    virtual void propagate(const Eigen::Matrix<double, 21, 21>& Phi,
+        const Eigen::Matrix<double, 12, 12>& Q) = 0;
+
+    /*
+     * @brief propagateCross Perform P12 = Phi*P12 on the
+     *    IMU-camera cross terms.
+     */
+    virtual void propagateCross(
+        const Eigen::Matrix<double, 21, 21>& Phi) = 0;
+
+    /*
+     * @brief augment Add a camera state x_c = J*x_imu in the
+     *    given unused slot.
+     */
+    virtual void augment(const Eigen::Matrix<double, 6, 21>& J,
+        const int& slot) = 0;
+
+    /*
+     * @brief remove Marginalize the camera state in the given
+     *    slot, which becomes unused.
+     */
+    virtual void remove(const int& slot) = 0;
+
+    /*
+     * @brief update Perform the EKF update with the measurement
+     *    Jacobian H, the residual r and the isotropic measurement
+     *    noise variance.
+     * @return delta_x: correction of the error state.
+     */
+    virtual void update(const Eigen::MatrixXd& H,
+        const Eigen::VectorXd& r, const double& noise,
+        Eigen::VectorXd& delta_x) = 0;
+
+    /*
+     * @brief projectedCovariance Compute H*P*H^T.
+     */
+    virtual Eigen::MatrixXd projectedCovariance(
+        const Eigen::MatrixXd& H) const = 0;
+
+    /*
+     * @brief imuCovariance The covariance of the IMU state.
+     */
+    virtual Eigen::MatrixXd imuCovariance() const = 0;
+
+    /*
+     * @brief covariance The full covariance matrix.
+     */
+    virtual Eigen::MatrixXd covariance() const = 0;
+
+    // Dimension of the state including the unused slots.
+    virtual int rows() const = 0;
+};
+
+/*
+ * @brief SquareRootCovariance Square-root covariance with the
+ *    given scalar type and IMU state size.
+ *
+ *    Internally, only the camera states in use are kept, in the
+ *    order they are added, and they are ordered in front of the
+ *    IMU state, i.e. U = [Uc Uci; 0 Ui]. Propagation changes the
+ *    IMU columns only, so the factor is re-triangularized on the
+ *    IMU block Ui and the cost does not depend on the number
+ *    of camera states. Augmentation, marginalization and update
+ *    are done with QR decompositions of the corresponding
+ *    pre-arrays. The factor is never symmetrized since U^T*U is
+ *    symmetric by construction.
+ */
+template <typename Scalar, int ImuStateSize = IMU_STATE_SIZE>
+class SquareRootCovariance : public SquareRootCovarianceBase {
+  public:
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> MatrixS;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> VectorS;
+    enum { N = ImuStateSize };
+
+    SquareRootCovariance(): dim_(0), slot_num_(0) {}
+
+    void reset(const Eigen::VectorXd& variance, const int& slot_num) {
+      dim_ = variance.rows();
+      slot_num_ = slot_num;
+      slots_.clear();
+      U_ = MatrixS::Zero(dim_, dim_);
+      U_.diagonal() = variance.cwiseMax(0.0).cwiseSqrt().template cast<Scalar>();
+      return;
+    }
+
+    void resize(const int& slot_num) {
+      slot_num_ = slot_num;
+      return;
+    }
+
+    void propagate(const Eigen::Matrix<double, 21, 21>& Phi,
+        const Eigen::Matrix<double, 12, 12>& Q) {
+      const Eigen::Matrix<Scalar, N, N> Phi_s =
+        Phi.template topLeftCorner<N, N>().template cast<Scalar>();
+
+      // Pre-array [Ui; sqrt(Q)^T]*Phi^T. The noise rows are
+      // skipped if Q is zero, e.g. with zero time interval.
+      Eigen::Matrix<Scalar, N+12, N> B = Eigen::Matrix<Scalar, N+12, N>::Zero();
+      B.template topRows<N>().noalias() =
+        U_.bottomRightCorner(N, N).template triangularView<Eigen::Upper>() *
+        Phi_s.transpose();
+
+      Eigen::LLT<Eigen::Matrix<double, 12, 12> > llt(Q);
+      if (llt.info() == Eigen::Success) {
+        const Eigen::Matrix<Scalar, 12, 12> L =
+          Eigen::Matrix<double, 12, 12>(llt.matrixL()).template cast<Scalar>();
+        B.template bottomRows<12>().noalias() =
+          (Phi_s.template leftCols<12>() * L).transpose();
+      }
+
+      Eigen::HouseholderQR<Eigen::Matrix<Scalar, N+12, N> > qr(B);
+      U_.bottomRightCorner(N, N) = qr.matrixQR().template topRows<N>()
+        .template triangularView<Eigen::Upper>();
+      return;
+    }
+
+    void propagateCross(const Eigen::Matrix<double, 21, 21>& Phi) {
+      const int nc = dim_ - N;
+      if (nc <= 0) return;
+      U_.topRightCorner(nc, N) = U_.topRightCorner(nc, N) *
+        Phi.template topLeftCorner<N, N>().transpose().template cast<Scalar>();
+      return;
+    }
+
+    void augment(const Eigen::Matrix<double, 6, 21>& J, const int& slot) {
+      const int nc = dim_ - N;
+      const Eigen::Matrix<Scalar, N, 6> Jt =
+        J.template leftCols<N>().transpose().template cast<Scalar>();
+
+      // The new camera state is inserted in front of the IMU state:
+      //   [Uc Uci*J^T Uci]
+      //   [ 0  Ui*J^T  Ui]
+      //   [ 0    0     0 ]
+      // Only the last N+6 rows need to be re-triangularized.
+      MatrixS U = MatrixS::Zero(dim_+6, dim_+6);
+      U.topLeftCorner(nc, nc) = U_.topLeftCorner(nc, nc);
+      U.block(0, nc, nc, 6).noalias() = U_.topRightCorner(nc, N) * Jt;
+      U.topRightCorner(nc, N) = U_.topRightCorner(nc, N);
+
+      Eigen::Matrix<Scalar, N, N+6> B;
+      const Eigen::Matrix<Scalar, N, N> Ui = U_.bottomRightCorner(N, N);
+      B.template leftCols<6>().noalias() = Ui * Jt;
+      B.template rightCols<N>() = Ui;
+
+      Eigen::HouseholderQR<Eigen::Matrix<Scalar, N, N+6> > qr(B);
+      U.block(nc, nc, N, N+6) =
+        qr.matrixQR().template triangularView<Eigen::Upper>();
+
+      U_.swap(U);
+      dim_ += 6;
+      slots_.push_back(slot);
+      return;
+    }
+
+    void remove(const int& slot) {
+      const int k = std::find(slots_.begin(), slots_.end(), slot) - slots_.begin();
+      if (k == static_cast<int>(slots_.size())) return;
+      slots_.erase(slots_.begin()+k);
+
+      const int n = 6;
+      const int s = 6 * k;
+      const int m = dim_ - n;
+
+      // Dropping columns of U gives the factor of the marginal
+      // covariance, which has n sub-diagonals from column s on.
+      MatrixS U(dim_, m);
+      U.leftCols(s) = U_.leftCols(s);
+      U.rightCols(m-s) = U_.rightCols(dim_-s-n);
+
+      VectorS workspace(m);
+      for (int j = s; j < m; ++j) {
+        const int size = std::min(n+1, dim_-j);
+        if (size <= 1) continue;
+
+        Scalar tau = 0;
+        Scalar beta = 0;
+        U.col(j).segment(j, size).makeHouseholderInPlace(tau, beta);
+        U.block(j, j+1, size, m-j-1).applyHouseholderOnTheLeft(
+            U.col(j).segment(j+1, size-1), tau, workspace.data());
+        U(j, j) = beta;
+        U.col(j).segment(j+1, size-1).setZero();
+      }
+
+      U_ = U.topRows(m);
+      dim_ = m;
+      return;
+    }
+
+    void update(const Eigen::MatrixXd& H, const Eigen::VectorXd& r,
+        const double& noise, Eigen::VectorXd& delta_x) {
+      const int m = H.rows();
+      const MatrixS H_int = toInternal(H);
+
+      // QR of the pre-array
+      //   [sigma*I    0]   [R11 R12]
+      //   [U*H^T      U] = Q*[ 0  R22]
+      // gives R11^T*R11 = S, R12 = R11^(-T)*H*P and the
+      // updated factor R22.
+      MatrixS A = MatrixS::Zero(m+dim_, m+dim_);
+      A.topLeftCorner(m, m).diagonal().setConstant(
+          static_cast<Scalar>(std::sqrt(noise)));
+      A.bottomLeftCorner(dim_, m).noalias() =
+        U_.template triangularView<Eigen::Upper>() * H_int.transpose();
+      A.bottomRightCorner(dim_, dim_) = U_;
+
+      Eigen::HouseholderQR<MatrixS> qr(A);
+      const MatrixS& R = qr.matrixQR();
+
+      // delta_x = K*r = R12^T*R11^(-T)*r
+      VectorS y = r.template cast<Scalar>();
+      R.topLeftCorner(m, m).template triangularView<Eigen::Upper>()
+        .transpose().solveInPlace(y);
+      const VectorS dx = R.topRightCorner(m, dim_).transpose() * y;
+
+      delta_x = Eigen::VectorXd::Zero(rows());
+      delta_x.head(N) = dx.tail(N).template cast<double>();
+      for (int k = 0; k < static_cast<int>(slots_.size()); ++k)
+        delta_x.template segment<6>(N+6*slots_[k]) =
+          dx.template segment<6>(6*k).template cast<double>();
+
+      U_ = R.bottomRightCorner(dim_, dim_)
+        .template triangularView<Eigen::Upper>();
+      return;
+    }
+
+    Eigen::MatrixXd projectedCovariance(const Eigen::MatrixXd& H) const {
+      const MatrixS B = U_.template triangularView<Eigen::Upper>() *
+        toInternal(H).transpose();
+      return (B.transpose()*B).template cast<double>();
+    }
+
+    Eigen::MatrixXd imuCovariance() const {
+      const auto Ui = U_.rightCols(N);
+      return (Ui.transpose()*Ui).template cast<double>();
+    }
+
+    Eigen::MatrixXd covariance() const {
+      const int nc = dim_ - N;
+      const Eigen::MatrixXd P_int = (U_.transpose() * U_).template cast<double>();
+
+      // Index of each internal state in the filter layout.
+      std::vector<int> index(dim_);
+      for (int k = 0; k < static_cast<int>(slots_.size()); ++k)
+        for (int i = 0; i < 6; ++i) index[6*k+i] = N + 6*slots_[k] + i;
+      for (int i = 0; i < N; ++i) index[nc+i] = i;
+
+      Eigen::MatrixXd P = Eigen::MatrixXd::Zero(rows(), rows());
+      for (int j = 0; j < dim_; ++j)
+        for (int i = 0; i < dim_; ++i)
+          P(index[i], index[j]) = P_int(i, j);
+      return P;
+    }
+
+    int rows() const { return N + 6*slot_num_; }
+
+  private:
+    // Gather the columns of H into the internal state order.
+    MatrixS toInternal(const Eigen::MatrixXd& H) const {
+      MatrixS H_int(H.rows(), dim_);
+      for (int k = 0; k < static_cast<int>(slots_.size()); ++k)
+        H_int.middleCols(6*k, 6) =
+          H.middleCols(N+6*slots_[k], 6).template cast<Scalar>();
+      H_int.rightCols(N) = H.leftCols(N).template cast<Scalar>();
+      return H_int;
+    }
+
+    // Upper triangular factor in the internal state order.
+    MatrixS U_;
+    int dim_;
+
+    // Number of camera state slots in the filter layout, and
+    // the slot of each camera state in the factor.
+    int slot_num_;
+    std::vector<int> slots_;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_SQUARE_ROOT_COVARIANCE_H
@@ -0,0 +1,153 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_STATE_COVARIANCE_H
+#define MSCKF_VIO_STATE_COVARIANCE_H
+
+#include <cstddef>
+#include <algorithm>
+#include <Eigen/Dense>
+
+namespace msckf_vio {
+
+/*
+ * @brief StateCovariance Fixed-capacity storage for the state
+ *    covariance matrix.
+ *
+ *    The buffer is allocated once for the largest state the
+ *    filter can hold (imu_state_size + 6*max_cam_state_size)
+ *    and only the top-left dim x dim corner is live. Growing,
+ *    shrinking and symmetrizing the covariance are done inside
+ *    the buffer so that no memory is allocated while the filter
+ *    is running.
+ *    Exceeding the reserved capacity is still handled, but at
+ *    the price of a reallocation.
+ */
+class StateCovariance {
+  public:
+    typedef Eigen::Block<Eigen::MatrixXd> MatrixView;
+    typedef Eigen::Block<const Eigen::MatrixXd> ConstMatrixView;
+
+    StateCovariance(): dim_(0) {}
+
+    /*
+     * @brief reserve Make sure the buffer can hold a state of
+     *    the given dimension. The live block is preserved.
+     */
+    void reserve(const int& capacity) {
+      if (capacity <= buffer_.rows()) return;
+      Eigen::MatrixXd new_buffer = Eigen::MatrixXd::Zero(capacity, capacity);
+      new_buffer.topLeftCorner(dim_, dim_) =
+        buffer_.topLeftCorner(dim_, dim_);
+      buffer_.swap(new_buffer);
+      return;
+    }
+
+    /*
+     * @brief reset Set the live dimension and zero the live block.
+     */
+    void reset(const int& dim) {
+      reserve(dim);
+      dim_ = dim;
+      matrix().setZero();
+      return;
+    }
+
+    /*
+     * @brief augment Grow the live block by n rows and columns.
+     *    The contents of the new rows and columns are undefined
+     *    and should be filled by the caller.
+     */
+    void augment(const int& n) {
+      reserve(dim_+n);
+      dim_ += n;
+      return;
+    }
+
+    /*
+     * @brief remove Remove n rows and columns starting at the
+     *    given index. Later blocks are shifted in place.
+     */
+    void remove(const int& start, const int& n) {
+      const int end = start + n;
+      const int ld = buffer_.rows();
+      double* data = buffer_.data();
+
+      // Shift the rows up within each live column. The
+      // destination is always in front of the source.
+      if (end < dim_) {
+        for (int j = 0; j < dim_; ++j) {
+          double* col = data + static_cast<std::ptrdiff_t>(j)*ld;
+          std::copy(col+end, col+dim_, col+start);
+        }
+        // Shift the columns to the left.
+        for (int j = start; j < dim_-n; ++j) {
+          double* dst = data + static_cast<std::ptrdiff_t>(j)*ld;
+          const double* src = dst + static_cast<std::ptrdiff_t>(n)*ld;
+          std::copy(src, src+dim_-n, dst);
+        }
+      }
+
+      dim_ -= n;
+      return;
+    }
+
+    /*
+     * @brief clear Zero n rows and columns starting at the
+     *    given index, which marginalizes the corresponding
+     *    states without moving the others.
+     */
+    void clear(const int& start, const int& n) {
+      matrix().middleRows(start, n).setZero();
+      matrix().middleCols(start, n).setZero();
+      return;
+    }
+
+    /*
+     * @brief symmetrize Replace the live block P with (P+P^T)/2
+     *    without creating a temporary copy.
+     */
+    void symmetrize() {
+      for (int j = 0; j < dim_; ++j) {
+        for (int i = j+1; i < dim_; ++i) {
+          const double value = 0.5 * (buffer_(i, j)+buffer_(j, i));
+          buffer_(i, j) = value;
+          buffer_(j, i) = value;
+        }
+      }
+      return;
+    }
+
+    // Live dimension of the covariance matrix.
+    int rows() const { return dim_; }
+    int cols() const { return dim_; }
+    // Dimension the buffer can hold without reallocating.
+    int capacity() const { return buffer_.rows(); }
+
+    // View of the live block.
+    MatrixView matrix() {
+      return buffer_.topLeftCorner(dim_, dim_);
+    }
+    ConstMatrixView matrix() const {
+      return buffer_.topLeftCorner(dim_, dim_);
+    }
+
+    double& operator()(const int& i, const int& j) {
+      return buffer_(i, j);
+    }
+    const double& operator()(const int& i, const int& j) const {
+      return buffer_(i, j);
+    }
+
+  private:
+    Eigen::MatrixXd buffer_;
+    int dim_;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_STATE_COVARIANCE_H
@@ -0,0 +1,78 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_THREAD_POOL_H
+#define MSCKF_VIO_THREAD_POOL_H
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include <boost/shared_ptr.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief ThreadPool A fixed set of worker threads which run the
+ *    iterations of a loop in parallel.
+ *
+ *    The calling thread takes part in the work, so a pool of
+ *    size n starts n-1 workers, and a pool of size 1 runs the
+ *    loop serially. Only one thread is allowed to issue loops
+ *    to the same pool at a time.
+ */
+class ThreadPool {
+  public:
+    typedef boost::shared_ptr<ThreadPool> Ptr;
+
+    ThreadPool(const int& thread_num);
+    ~ThreadPool();
+
+    // Disable copy and assign constructor
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool operator=(const ThreadPool&) = delete;
+
+    /*
+     * @brief parallelFor Call func(i) for i in [0, n) and return
+     *    after all the calls are finished. The order in which the
+     *    indices are processed is not specified.
+     */
+    void parallelFor(const int& n,
+        const std::function<void(const int&)>& func);
+
+    // Number of threads working on a loop.
+    int size() const {
+      return workers.size() + 1;
+    }
+
+  private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex pool_mutex;
+    std::condition_variable start_cond;
+    std::condition_variable done_cond;
+
+    // The loop being processed.
+    const std::function<void(const int&)>* task_func;
+    int task_num;
+    std::atomic<int> next_task;
+
+    // Number of workers still busy with the current loop.
+    int busy_workers;
+    // Incremented for every new loop.
+    unsigned long generation;
+    bool stop;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_THREAD_POOL_H
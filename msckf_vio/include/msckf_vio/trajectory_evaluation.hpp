@@ -0,0 +1,146 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_TRAJECTORY_EVALUATION_HPP
+#define MSCKF_VIO_TRAJECTORY_EVALUATION_HPP
+
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+#include "dataset.h"
+
+namespace msckf_vio {
+
+/*
+ * @brief TrajectoryError Accuracy of an estimated trajectory.
+ *    ATE is the absolute trajectory error after aligning the
+ *    estimate to the ground truth with a rigid transformation.
+ *    RPE is the relative pose error over a fixed time interval.
+ */
+struct TrajectoryError {
+  // Number of estimated poses matched with the ground truth.
+  int pose_num;
+  // Root mean squared errors in meters and degrees.
+  double ate;
+  double rpe_translation;
+  double rpe_rotation;
+};
+
+/*
+ * @brief associatePoses Match each estimated pose with the
+ *    ground truth pose closest in time.
+ * @param max_time_diff Maximum time difference of a match.
+ * @param matches Indices of the estimated and the ground truth
+ *    poses of each match.
+ */
+inline void associatePoses(
+    const std::vector<StampedPose>& estimate,
+    const std::vector<StampedPose>& ground_truth,
+    const double& max_time_diff,
+    std::vector<std::pair<int, int> >& matches) {
+  matches.clear();
+  if (ground_truth.empty()) return;
+
+  for (int i = 0; i < estimate.size(); ++i) {
+    const double time = estimate[i].time;
+    auto iter = std::lower_bound(ground_truth.begin(), ground_truth.end(),
+        time, [](const StampedPose& pose, const double& t) {
+          return pose.time < t; });
+
+    // Compare the poses right before and after the time.
+    int j = iter - ground_truth.begin();
+    if (j == ground_truth.size() || (j > 0 &&
+          time-ground_truth[j-1].time < ground_truth[j].time-time))
+      --j;
+    if (std::abs(ground_truth[j].time-time) <= max_time_diff)
+      matches.emplace_back(i, j);
+  }
+  return;
+}
+
+/*
+ * @brief evaluateTrajectory Compute the ATE and RPE of the
+ *    estimate, with the estimate being aligned to the ground
+ *    truth with the rigid transformation minimizing the ATE.
+ * @param rpe_interval Time interval of the RPE in seconds.
+ * @return False if less than 3 poses can be matched.
+ */
+inline bool evaluateTrajectory(
+    const std::vector<StampedPose>& estimate,
+    const std::vector<StampedPose>& ground_truth,
+    const double& rpe_interval,
+    const double& max_time_diff,
+    TrajectoryError& error) {
+  error = TrajectoryError();
+  std::vector<std::pair<int, int> > matches;
+  associatePoses(estimate, ground_truth, max_time_diff, matches);
+  error.pose_num = matches.size();
+  if (matches.size() < 3) return false;
+
+  // Align the estimated positions with the ground truth.
+  const int n = matches.size();
+  Eigen::Matrix3Xd src(3, n);
+  Eigen::Matrix3Xd dst(3, n);
+  for (int k = 0; k < n; ++k) {
+    src.col(k) = estimate[matches[k].first].position;
+    dst.col(k) = ground_truth[matches[k].second].position;
+  }
+  const Eigen::Matrix4d T = Eigen::umeyama(src, dst, false);
+  const Eigen::Matrix3d R = T.topLeftCorner<3, 3>();
+  const Eigen::Vector3d t = T.topRightCorner<3, 1>();
+
+  double ate_sum = 0.0;
+  for (int k = 0; k < n; ++k)
+    ate_sum += (R*src.col(k)+t-dst.col(k)).squaredNorm();
+  error.ate = std::sqrt(ate_sum/n);
+
+  // Relative motion from pose i to pose j.
+  auto relativePose = [](const StampedPose& i, const StampedPose& j,
+      Eigen::Matrix3d& dR, Eigen::Vector3d& dp) {
+    dR = i.rotation.transpose() * j.rotation;
+    dp = i.rotation.transpose() * (j.position-i.position);
+  };
+
+  // Compare the relative motions of the pose pairs which are
+  // rpe_interval apart.
+  double rpe_translation_sum = 0.0;
+  double rpe_rotation_sum = 0.0;
+  int rpe_num = 0;
+  int l = 0;
+  for (int k = 0; k < n; ++k) {
+    const StampedPose& est_k = estimate[matches[k].first];
+    while (l < n && estimate[matches[l].first].time <
+        est_k.time+rpe_interval) ++l;
+    if (l == n) break;
+
+    Eigen::Matrix3d dR_est, dR_gt;
+    Eigen::Vector3d dp_est, dp_gt;
+    relativePose(est_k, estimate[matches[l].first], dR_est, dp_est);
+    relativePose(ground_truth[matches[k].second],
+        ground_truth[matches[l].second], dR_gt, dp_gt);
+
+    const Eigen::Matrix3d dR_error = dR_gt.transpose() * dR_est;
+    rpe_translation_sum += (dp_est-dp_gt).squaredNorm();
+    const double angle = Eigen::AngleAxisd(dR_error).angle() * 180.0/M_PI;
+    rpe_rotation_sum += angle * angle;
+    ++rpe_num;
+  }
+
+  if (rpe_num > 0) {
+    error.rpe_translation = std::sqrt(rpe_translation_sum/rpe_num);
+    error.rpe_rotation = std::sqrt(rpe_rotation_sum/rpe_num);
+  }
+  return true;
+}
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_TRAJECTORY_EVALUATION_HPP
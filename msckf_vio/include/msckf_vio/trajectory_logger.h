@@ -0,0 +1,133 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_TRAJECTORY_LOGGER_H
+#define MSCKF_VIO_TRAJECTORY_LOGGER_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <cstdio>
+#include <condition_variable>
+#include <boost/shared_ptr.hpp>
+
+#include "spsc_queue.hpp"
+
+namespace msckf_vio {
+
+/*
+ * @brief PoseRecord One pose of the trajectory.
+ */
+struct PoseRecord {
+  // Time stamp in seconds.
+  double time;
+  double position[3];
+  // Quaternion in the order of x, y, z, w.
+  double orientation[4];
+};
+
+/*
+ * @brief TrajectoryLogger Writes the estimated poses to a file
+ *    in a background thread.
+ *
+ *    The estimator only pushes the poses into a lock-free queue,
+ *    so logging does not block the filter on file I/O. The writer
+ *    thread drains the queue, flushes the file periodically and
+ *    starts a new file once the current one exceeds the size
+ *    limit. The rotated files are named <path>.1, <path>.2, ...
+ *    and a restarted logger resumes from the last of them.
+ *
+ *    Two formats are supported:
+ *    TUM: one "time tx ty tz qx qy qz qw" line per pose.
+ *    BINARY: one PoseRecord of 8 native doubles per pose.
+ */
+class TrajectoryLogger {
+  public:
+    typedef boost::shared_ptr<TrajectoryLogger> Ptr;
+
+    enum Format {
+      TUM,
+      BINARY
+    };
+
+    /*
+     * @param path Output file. Poses are appended if it exists.
+     * @param flush_period Seconds between two writes of the queued
+     *    poses, which are flushed to the file at once.
+     * @param max_file_size Bytes per file before rotating, or
+     *    nonpositive to never rotate.
+     * @param queue_size Poses the queue can hold. Poses pushed
+     *    while the queue is full are dropped.
+     */
+    TrajectoryLogger(const std::string& path,
+        const Format& format = TUM,
+        const double& flush_period = 1.0,
+        const long& max_file_size = 0,
+        const int& queue_size = 1024);
+
+    // Writes all the queued poses before returning.
+    ~TrajectoryLogger();
+
+    // Disable copy and assign constructor
+    TrajectoryLogger(const TrajectoryLogger&) = delete;
+    TrajectoryLogger operator=(const TrajectoryLogger&) = delete;
+
+    /*
+     * @brief parseFormat Format from its name, "tum" or "binary".
+     * @return False if the name is unknown.
+     */
+    static bool parseFormat(const std::string& name, Format& format);
+
+    /*
+     * @brief log Queue a pose for writing. Never blocks and must
+     *    only be called from one thread.
+     * @return False if the pose is dropped.
+     */
+    bool log(const PoseRecord& pose);
+
+    // Number of poses dropped because the queue was full.
+    long droppedNum() const { return dropped_num; }
+
+    // Whether the output file could be opened.
+    bool isOpen() const { return is_open; }
+
+  private:
+    void writerLoop();
+    // Write the queued poses to the file.
+    void drain();
+    void write(const PoseRecord& pose);
+    // Name of the file with the given rotation index.
+    std::string fileName(const int& index) const;
+    // Highest index of the consecutive existing rotated files.
+    int lastFileIndex() const;
+    // Open the file with the given rotation index.
+    bool openFile(const int& index);
+
+    const std::string path;
+    const Format format;
+    const double flush_period;
+    const long max_file_size;
+
+    SpscQueue<PoseRecord> queue;
+    std::atomic<long> dropped_num;
+    std::atomic<bool> is_open;
+
+    // Only accessed by the writer thread after construction.
+    std::FILE* file;
+    long file_size;
+    int file_index;
+
+    std::thread writer;
+    std::mutex stop_mutex;
+    std::condition_variable stop_cond;
+    bool stop;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_TRAJECTORY_LOGGER_H
@@ -0,0 +1,111 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#ifndef MSCKF_VIO_UNDISTORTION_MAP_H
+#define MSCKF_VIO_UNDISTORTION_MAP_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace msckf_vio {
+
+/*
+ * @brief UndistortionMap Maps the pixels of a camera to the
+ *    normalized image plane and back, for the radtan and the
+ *    equidistant models.
+ *
+ *    The undistortion is read from a table of the iterative
+ *    solution, which is sampled every cell_size pixels over the
+ *    image and interpolated bilinearly. With the EuRoC cameras,
+ *    the error is up to 0.005px (radtan) and 0.014px
+ *    (equidistant) with 2 pixel cells, and 0.019px and 0.055px
+ *    with 4 pixel cells. The pixels out of the
+ *    image are still undistorted iteratively. The distortion has
+ *    a closed form, which is cheaper than a table lookup.
+ */
+class UndistortionMap {
+  public:
+    UndistortionMap();
+
+    /*
+     * @brief initialize Set the calibration of the camera and
+     *    build the table. If the cell size is not positive, no
+     *    table is built and all the pixels are undistorted
+     *    iteratively.
+     * @param distortion_model: "radtan" or "equidistant", the
+     *    other models are treated as radtan.
+     */
+    void initialize(const cv::Vec2i& resolution,
+        const cv::Vec4d& intrinsics,
+        const std::string& distortion_model,
+        const cv::Vec4d& distortion_coeffs,
+        const int& cell_size);
+
+    /*
+     * @brief undistortPoints Map pixels to the normalized
+     *    image plane.
+     */
+    void undistortPoints(const std::vector<cv::Point2f>& pts_in,
+        std::vector<cv::Point2f>& pts_out) const;
+
+    /*
+     * @brief undistortPointsIteratively Map pixels to the
+     *    normalized image plane with the iterative solution
+     *    of OpenCV, which the table approximates.
+     */
+    void undistortPointsIteratively(
+        const std::vector<cv::Point2f>& pts_in,
+        std::vector<cv::Point2f>& pts_out) const;
+
+    /*
+     * @brief distortPoints Map points on the normalized image
+     *    plane to pixels.
+     */
+    void distortPoints(const std::vector<cv::Point2f>& pts_in,
+        std::vector<cv::Point2f>& pts_out) const;
+
+    bool hasTable() const {
+      return !table.empty();
+    }
+
+    // Maximum distance in pixels between the table and the
+    // iterative solution at the centers of the cells, where the
+    // bilinear interpolation is the least accurate. It is within
+    // a few percent of the maximum over the whole image, and
+    // grows with the square of the cell size.
+    double maxError() const {
+      return max_error;
+    }
+
+  private:
+    // Bilinear interpolation of the table, which requires
+    // the pixel to be within the image.
+    void lookup(const float& u, const float& v,
+        float& x, float& y) const;
+
+    // Camera calibration parameters
+    cv::Vec2i resolution;
+    cv::Vec4d intrinsics;
+    bool equidistant;
+    cv::Vec4d distortion_coeffs;
+
+    // Undistorted x and y of the nodes every cell_size pixels,
+    // interleaved and row by row, so that the two nodes of a
+    // cell in the same row share a cache line. The last row and
+    // column of nodes are at or past the border of the image.
+    float inv_cell_size;
+    int node_cols;
+    int node_rows;
+    std::vector<float> table;
+
+    double max_error;
+};
+
+} // namespace msckf_vio
+
+#endif // MSCKF_VIO_UNDISTORTION_MAP_H
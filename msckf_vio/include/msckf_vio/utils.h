@@ -12,22 +12,23 @@
 #include <string>
 #include <opencv2/core/core.hpp>
 #include <Eigen/Geometry>
+#include <msckf_vio/parameter_reader.h>
 
 namespace msckf_vio {
 /*
  * @brief utilities for msckf_vio
  */
 namespace utils {
-Eigen::Isometry3d getTransformEigen(const ros::NodeHandle &nh,
+Eigen::Isometry3d getTransformEigen(const ParameterReader &params,
                                     const std::string &field);
 
-cv::Mat getTransformCV(const ros::NodeHandle &nh,
+cv::Mat getTransformCV(const ParameterReader &params,
                        const std::string &field);
 
-cv::Mat getVec16Transform(const ros::NodeHandle &nh,
+cv::Mat getVec16Transform(const ParameterReader &params,
                           const std::string &field);
 
-cv::Mat getKalibrStyleTransform(const ros::NodeHandle &nh,
+cv::Mat getKalibrStyleTransform(const ParameterReader &params,
                                 const std::string &field);
 }
 }
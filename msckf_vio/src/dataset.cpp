@@ -0,0 +1,228 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <msckf_vio/dataset.h>
+
+using namespace std;
+using namespace Eigen;
+
+namespace msckf_vio {
+
+namespace {
+
+// Read the comma separated values of a csv file, skipping the
+// comment lines starting with '#'.
+bool readCsv(const string& file_name, vector<vector<string> >& rows) {
+  ifstream file(file_name);
+  if (!file.is_open()) {
+    cerr << "Cannot open " << file_name << endl;
+    return false;
+  }
+
+  rows.clear();
+  string line;
+  while (getline(file, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    rows.push_back(vector<string>());
+    stringstream line_stream(line);
+    string value;
+    while (getline(line_stream, value, ','))
+      rows.back().push_back(value);
+  }
+  return true;
+}
+
+// Read the time stamps of a KITTI raw sensor, which are in the
+// form of "2011-09-26 13:02:25.964389445".
+bool readKittiTimestamps(const string& file_name, vector<double>& times) {
+  ifstream file(file_name);
+  if (!file.is_open()) {
+    cerr << "Cannot open " << file_name << endl;
+    return false;
+  }
+
+  times.clear();
+  string line;
+  while (getline(file, line)) {
+    if (line.empty()) continue;
+    tm date = tm();
+    double seconds = 0.0;
+    if (sscanf(line.c_str(), "%d-%d-%d %d:%d:%lf",
+          &date.tm_year, &date.tm_mon, &date.tm_mday,
+          &date.tm_hour, &date.tm_min, &seconds) != 6) {
+      cerr << "Invalid time stamp in " << file_name << ": " << line << endl;
+      return false;
+    }
+    date.tm_year -= 1900;
+    date.tm_mon -= 1;
+    times.push_back(static_cast<double>(timegm(&date)) + seconds);
+  }
+  return true;
+}
+
+string kittiFileName(const string& folder, const int& index,
+    const string& extension) {
+  char name[16];
+  snprintf(name, sizeof(name), "%010d", index);
+  return folder + "/data/" + name + extension;
+}
+
+} // namespace
+
+void Dataset::clear() {
+  imu.clear();
+  frames.clear();
+  ground_truth.clear();
+  return;
+}
+
+bool Dataset::loadEuroc(const string& path) {
+  clear();
+  const string mav_path = path + "/mav0";
+
+  // IMU msgs: time [ns], angular velocity, linear acceleration.
+  vector<vector<string> > rows;
+  if (!readCsv(mav_path+"/imu0/data.csv", rows)) return false;
+  for (const auto& row : rows) {
+    if (row.size() < 7) continue;
+    ImuSample sample;
+    sample.time = 1e-9 * stod(row[0]);
+    sample.angular_velocity = Vector3d(
+        stod(row[1]), stod(row[2]), stod(row[3]));
+    sample.linear_acceleration = Vector3d(
+        stod(row[4]), stod(row[5]), stod(row[6]));
+    imu.push_back(sample);
+  }
+
+  // Images: time [ns], file name. The two cameras are triggered
+  // together, so the images are paired by their time stamps.
+  vector<vector<string> > cam1_rows;
+  if (!readCsv(mav_path+"/cam0/data.csv", rows)) return false;
+  if (!readCsv(mav_path+"/cam1/data.csv", cam1_rows)) return false;
+  auto cam1_iter = cam1_rows.begin();
+  for (const auto& row : rows) {
+    if (row.size() < 2) continue;
+    while (cam1_iter != cam1_rows.end() && (cam1_iter->size() < 2 ||
+          stoll((*cam1_iter)[0]) < stoll(row[0])))
+      ++cam1_iter;
+    if (cam1_iter == cam1_rows.end()) break;
+    if ((*cam1_iter)[0] != row[0]) continue;
+
+    StereoFrame frame;
+    frame.time = 1e-9 * stod(row[0]);
+    frame.cam0_file = mav_path + "/cam0/data/" + row[1];
+    frame.cam1_file = mav_path + "/cam1/data/" + (*cam1_iter)[1];
+    frames.push_back(frame);
+  }
+
+  // Ground truth: time [ns], position, quaternion (w, x, y, z).
+  // Sequences without ground truth are accepted.
+  ifstream ground_truth_file(mav_path+"/state_groundtruth_estimate0/data.csv");
+  if (ground_truth_file.is_open() &&
+      readCsv(mav_path+"/state_groundtruth_estimate0/data.csv", rows)) {
+    for (const auto& row : rows) {
+      if (row.size() < 8) continue;
+      StampedPose pose;
+      pose.time = 1e-9 * stod(row[0]);
+      pose.position = Vector3d(stod(row[1]), stod(row[2]), stod(row[3]));
+      pose.rotation = Quaterniond(stod(row[4]), stod(row[5]),
+          stod(row[6]), stod(row[7])).normalized().toRotationMatrix();
+      ground_truth.push_back(pose);
+    }
+  }
+
+  if (imu.empty() || frames.empty()) {
+    cerr << "No IMU msgs or images in " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+bool Dataset::loadKittiRaw(const string& image_path,
+    const string& oxts_path) {
+  clear();
+
+  // The images of the two cameras have the same indices.
+  vector<double> cam0_times, cam1_times;
+  if (!readKittiTimestamps(image_path+"/image_00/timestamps.txt",
+        cam0_times)) return false;
+  if (!readKittiTimestamps(image_path+"/image_01/timestamps.txt",
+        cam1_times)) return false;
+  const int frame_num = min(cam0_times.size(), cam1_times.size());
+  for (int i = 0; i < frame_num; ++i) {
+    StereoFrame frame;
+    frame.time = cam0_times[i];
+    frame.cam0_file = kittiFileName(image_path+"/image_00", i, ".png");
+    frame.cam1_file = kittiFileName(image_path+"/image_01", i, ".png");
+    frames.push_back(frame);
+  }
+
+  vector<double> oxts_times;
+  if (!readKittiTimestamps(oxts_path+"/oxts/timestamps.txt",
+        oxts_times)) return false;
+
+  // Earth radius used by the KITTI devkit to project the GPS
+  // positions with the Mercator projection.
+  const double earth_radius = 6378137.0;
+  double mercator_scale = 0.0;
+
+  for (int i = 0; i < oxts_times.size(); ++i) {
+    const string file_name = kittiFileName(oxts_path+"/oxts", i, ".txt");
+    ifstream file(file_name);
+    vector<double> values;
+    double value;
+    while (file >> value) values.push_back(value);
+    if (values.size() < 23) {
+      cerr << "Invalid OXTS data in " << file_name << endl;
+      return false;
+    }
+
+    // Acceleration and angular velocity in the IMU frame
+    // (x forward, y left, z up).
+    ImuSample sample;
+    sample.time = oxts_times[i];
+    sample.linear_acceleration = Vector3d(values[11], values[12], values[13]);
+    sample.angular_velocity = Vector3d(values[17], values[18], values[19]);
+
+    // The OXTS data may contain duplicated time stamps.
+    if (!imu.empty() && sample.time <= imu.back().time) continue;
+    imu.push_back(sample);
+
+    const double lat = values[0];
+    const double lon = values[1];
+    if (i == 0) mercator_scale = cos(lat*M_PI/180.0);
+
+    StampedPose pose;
+    pose.time = oxts_times[i];
+    pose.position(0) = mercator_scale * lon * M_PI * earth_radius / 180.0;
+    pose.position(1) = mercator_scale * earth_radius *
+      log(tan((90.0+lat)*M_PI/360.0));
+    pose.position(2) = values[2];
+    pose.rotation =
+      AngleAxisd(values[5], Vector3d::UnitZ()).toRotationMatrix() *
+      AngleAxisd(values[4], Vector3d::UnitY()).toRotationMatrix() *
+      AngleAxisd(values[3], Vector3d::UnitX()).toRotationMatrix();
+    ground_truth.push_back(pose);
+  }
+
+  if (imu.empty() || frames.empty()) {
+    cerr << "No IMU msgs or images in " << image_path << endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace msckf_vio
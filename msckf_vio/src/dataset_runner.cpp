@@ -0,0 +1,238 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+/*
+ * Runs the image processor and the filter on a sequence read from
+ * disk. The images and IMU msgs are fed to both objects in-process,
+ * without any topic transport or playback clock, so the sequence is
+ * processed as fast as possible. The frame rate, the latency of the
+ * stages and the accuracy against the ground truth are reported at
+ * the end.
+ *
+ * Usage:
+ *   dataset_runner <config> euroc <sequence path> [trajectory file]
+ *   dataset_runner <config> kitti <drive path> <oxts drive path>
+ *       [trajectory file]
+ *
+ * The parameters are read from the image_processor and msckf_vio
+ * maps of the YAML config, along with the calibration file it
+ * names, see config/dataset_runner_*.yaml. Neither a master nor the
+ * parameter server is needed, and nothing is advertised. The
+ * trajectory file replaces the trajectory_file of the config, and
+ * is written by the filter like the one of the node.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/image_encodings.h>
+#include <cv_bridge/cv_bridge.h>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <msckf_vio/dataset.h>
+#include <msckf_vio/imu_buffer.h>
+#include <msckf_vio/trajectory_evaluation.hpp>
+#include <msckf_vio/image_processor.h>
+#include <msckf_vio/msckf_vio.h>
+#include <msckf_vio/math_utils.hpp>
+#include <msckf_vio/latency_tracer.h>
+#include <msckf_vio/parameter_reader.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+sensor_msgs::ImuConstPtr toImuMsg(const ImuSample& sample) {
+  sensor_msgs::ImuPtr msg(new sensor_msgs::Imu());
+  msg->header.stamp.fromSec(sample.time);
+  msg->header.frame_id = "imu";
+  msg->angular_velocity.x = sample.angular_velocity(0);
+  msg->angular_velocity.y = sample.angular_velocity(1);
+  msg->angular_velocity.z = sample.angular_velocity(2);
+  msg->linear_acceleration.x = sample.linear_acceleration(0);
+  msg->linear_acceleration.y = sample.linear_acceleration(1);
+  msg->linear_acceleration.z = sample.linear_acceleration(2);
+  return msg;
+}
+
+sensor_msgs::ImageConstPtr toImageMsg(const string& file_name,
+    const double& time, const string& frame_id) {
+  cv_bridge::CvImage image;
+  image.image = cv::imread(file_name, cv::IMREAD_GRAYSCALE);
+  if (image.image.empty()) return sensor_msgs::ImageConstPtr();
+  image.header.stamp.fromSec(time);
+  image.header.frame_id = frame_id;
+  image.encoding = sensor_msgs::image_encodings::MONO8;
+  return image.toImageMsg();
+}
+
+// Load the config and add the calibration to both sections, unless
+// a section sets the same key.
+bool loadConfig(const string& file_name,
+    YAML::Node& processor_config, YAML::Node& vio_config) {
+  YAML::Node config;
+  if (!ParameterReader::loadFile(file_name, config)) return false;
+  processor_config.reset(config["image_processor"]);
+  vio_config.reset(config["msckf_vio"]);
+  if (!processor_config.IsMap() || !vio_config.IsMap()) {
+    ROS_ERROR("No image_processor or msckf_vio map in %s",
+        file_name.c_str());
+    return false;
+  }
+
+  if (!config["calibration_file"]) return true;
+  string calibration_file = config["calibration_file"].as<string>();
+  const size_t dir_end = file_name.rfind('/');
+  if (calibration_file[0] != '/' && dir_end != string::npos)
+    calibration_file = file_name.substr(0, dir_end+1) + calibration_file;
+
+  YAML::Node calibration;
+  if (!ParameterReader::loadFile(calibration_file, calibration)) return false;
+  for (const auto& item : calibration) {
+    const string key = item.first.as<string>();
+    if (!processor_config[key]) processor_config[key] = item.second;
+    if (!vio_config[key]) vio_config[key] = item.second;
+  }
+  return true;
+}
+
+// Samples that the IMU buffer of a pipeline has to hold, with
+// the defaults of both objects.
+int imuBufferCapacity(const ParameterReader& params) {
+  double imu_rate, imu_buffer_duration;
+  params.param<double>("imu_rate", imu_rate, 200.0);
+  params.param<double>("imu_buffer_duration", imu_buffer_duration, 20.0);
+  return ImuBuffer::requiredCapacity(imu_rate, imu_buffer_duration);
+}
+
+// Append the IMU pose whenever the filter publishes its results.
+void recordState(const IMUState& imu_state,
+    vector<StampedPose>& trajectory) {
+  StampedPose pose;
+  pose.time = imu_state.time;
+  pose.position = imu_state.position;
+  pose.rotation = quaternionToRotation(imu_state.orientation).transpose();
+  trajectory.push_back(pose);
+  return;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  // Only the clock used by the throttled logs, no master.
+  ros::Time::init();
+
+  Dataset dataset;
+  string trajectory_file;
+  const string type = argc > 2 ? argv[2] : "";
+  if (type == "euroc" && argc >= 4) {
+    if (!dataset.loadEuroc(argv[3])) return 1;
+    if (argc > 4) trajectory_file = argv[4];
+  } else if (type == "kitti" && argc >= 5) {
+    if (!dataset.loadKittiRaw(argv[3], argv[4])) return 1;
+    if (argc > 5) trajectory_file = argv[5];
+  } else {
+    fprintf(stderr,
+        "Usage: %s <config> euroc <sequence path> [trajectory file]\n"
+        "       %s <config> kitti <drive path> <oxts drive path> "
+        "[trajectory file]\n", argv[0], argv[0]);
+    return 1;
+  }
+  ROS_INFO("Loaded %lu IMU msgs and %lu stereo frames",
+      dataset.imu.size(), dataset.frames.size());
+
+  YAML::Node processor_config;
+  YAML::Node vio_config;
+  if (!loadConfig(argv[1], processor_config, vio_config)) return 1;
+  // The filter writes the trajectory with its own logger.
+  if (!trajectory_file.empty())
+    vio_config["trajectory_file"] = trajectory_file;
+
+  // Without a node handle, the objects neither advertise nor
+  // subscribe to any topic. The IMU samples are shared through
+  // a buffer of this pipeline only.
+  const ParameterReader processor_params(processor_config);
+  const ParameterReader vio_params(vio_config);
+  ImuBuffer::Ptr imu_buffer(new ImuBuffer(std::max(
+          imuBufferCapacity(processor_params),
+          imuBufferCapacity(vio_params))));
+
+  ImageProcessor image_processor;
+  MsckfVio vio;
+  if (!image_processor.initialize(processor_params, imu_buffer) ||
+      !vio.initialize(vio_params, imu_buffer)) {
+    ROS_ERROR("Cannot initialize the image processor or msckf vio...");
+    return 1;
+  }
+
+  LatencyTracer::instance().enable("");
+
+  vector<StampedPose> trajectory;
+  image_processor.setFeatureCallback(
+      boost::bind(&MsckfVio::processFeatures, &vio, _1));
+  vio.setStateCallback(
+      boost::bind(&recordState, _1, boost::ref(trajectory)));
+
+  // Feed the IMU msgs up to each frame before the frame, which is
+  // the order the msgs are received online.
+  const auto start_time = chrono::steady_clock::now();
+  int processed_frame_num = 0;
+  size_t imu_index = 0;
+  for (const auto& frame : dataset.frames) {
+    for (; imu_index < dataset.imu.size() &&
+        dataset.imu[imu_index].time <= frame.time; ++imu_index) {
+      const sensor_msgs::ImuConstPtr msg = toImuMsg(dataset.imu[imu_index]);
+      image_processor.processImu(msg);
+      vio.processImu(msg);
+    }
+
+    const sensor_msgs::ImageConstPtr cam0_img =
+      toImageMsg(frame.cam0_file, frame.time, "cam0");
+    const sensor_msgs::ImageConstPtr cam1_img =
+      toImageMsg(frame.cam1_file, frame.time, "cam1");
+    if (!cam0_img || !cam1_img) {
+      ROS_WARN("Cannot read the images at %f", frame.time);
+      continue;
+    }
+    image_processor.processStereo(cam0_img, cam1_img);
+    ++processed_frame_num;
+  }
+  const double elapsed = chrono::duration<double>(
+      chrono::steady_clock::now()-start_time).count();
+
+  printf("Processed %d frames in %.3fs: %.1f fps, %.1fx real time\n",
+      processed_frame_num, elapsed, processed_frame_num/elapsed,
+      (dataset.frames.back().time-dataset.frames.front().time)/elapsed);
+
+  vector<StageStatistics> stats;
+  LatencyTracer::instance().statistics("", stats);
+  printf("%-48s %8s %8s %8s %8s %8s\n",
+      "stage [ms]", "count", "p50", "p95", "p99", "max");
+  for (const auto& stage : stats)
+    printf("%-48s %8ld %8.3f %8.3f %8.3f %8.3f\n", stage.name.c_str(),
+        stage.count, stage.p50, stage.p95, stage.p99, stage.max);
+
+  TrajectoryError error;
+  if (dataset.ground_truth.empty()) {
+    printf("No ground truth\n");
+  } else if (evaluateTrajectory(
+        trajectory, dataset.ground_truth, 1.0, 0.02, error)) {
+    printf("ATE %.3fm, RPE(1s) %.3fm %.3fdeg over %d poses\n",
+        error.ate, error.rpe_translation, error.rpe_rotation,
+        error.pose_num);
+  } else {
+    printf("Cannot match the trajectory with the ground truth\n");
+  }
+  return 0;
+}
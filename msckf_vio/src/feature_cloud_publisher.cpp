@@ -0,0 +1,141 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <iterator>
+#include <pcl_ros/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <msckf_vio/feature_cloud_publisher.h>
+
+using namespace std;
+using namespace Eigen;
+
+namespace msckf_vio {
+
+void FeatureCloudPublisher::Delta::append(Delta& delta) {
+  // Earlier changes are overridden by a cleared map.
+  if (delta.is_cleared) {
+    swap(*this, delta);
+    return;
+  }
+  added.insert(added.end(),
+      make_move_iterator(delta.added.begin()),
+      make_move_iterator(delta.added.end()));
+  removed.insert(removed.end(),
+      delta.removed.begin(), delta.removed.end());
+  return;
+}
+
+FeatureCloudPublisher::FeatureCloudPublisher(
+    const ros::Publisher& publisher,
+    const string& frame_id,
+    const Matrix3d& R_imu_body,
+    const double& rate):
+  publisher(publisher),
+  frame_id(frame_id),
+  R_imu_body(R_imu_body),
+  period(rate > 0.0 ? 1.0/rate : 0.0),
+  is_queued(false),
+  is_publish_requested(false),
+  stop(false) {
+  worker = thread(&FeatureCloudPublisher::publisherLoop, this);
+  return;
+}
+
+FeatureCloudPublisher::~FeatureCloudPublisher() {
+  {
+    lock_guard<mutex> lock(delta_mutex);
+    stop = true;
+  }
+  delta_cond.notify_one();
+  worker.join();
+  return;
+}
+
+void FeatureCloudPublisher::add(
+    const FeatureIDType& id, const Vector3d& position) {
+  pending_delta.added.emplace_back(id, position);
+  return;
+}
+
+void FeatureCloudPublisher::remove(const FeatureIDType& id) {
+  pending_delta.removed.push_back(id);
+  return;
+}
+
+void FeatureCloudPublisher::clear() {
+  pending_delta = Delta();
+  pending_delta.is_cleared = true;
+  return;
+}
+
+void FeatureCloudPublisher::publish(const ros::Time& time) {
+
+  // The time may go backwards if the system is reset.
+  const bool is_due = publisher.getNumSubscribers() > 0 &&
+    (time < last_publish_time ||
+     (time-last_publish_time).toSec() >= period);
+  if (is_due) last_publish_time = time;
+
+  {
+    lock_guard<mutex> lock(delta_mutex);
+    queued_delta.append(pending_delta);
+    is_queued = true;
+    if (is_due) {
+      is_publish_requested = true;
+      publish_time = time;
+    }
+  }
+  delta_cond.notify_one();
+
+  pending_delta = Delta();
+  return;
+}
+
+void FeatureCloudPublisher::publisherLoop() {
+  while (true) {
+    Delta delta;
+    bool is_publishing = false;
+    ros::Time time;
+    {
+      unique_lock<mutex> lock(delta_mutex);
+      delta_cond.wait(lock, [this]() { return stop || is_queued; });
+      if (stop) return;
+
+      swap(delta, queued_delta);
+      is_queued = false;
+      is_publishing = is_publish_requested;
+      is_publish_requested = false;
+      time = publish_time;
+    }
+
+    if (delta.is_cleared) positions.clear();
+    for (const auto& item : delta.added)
+      positions[item.first] = item.second;
+    for (const auto& id : delta.removed)
+      positions.erase(id);
+
+    if (!is_publishing) continue;
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr feature_msg_ptr(
+        new pcl::PointCloud<pcl::PointXYZ>());
+    feature_msg_ptr->header.frame_id = frame_id;
+    // PCL time stamps are in microseconds.
+    feature_msg_ptr->header.stamp = time.toNSec() / 1000ull;
+    feature_msg_ptr->height = 1;
+    feature_msg_ptr->points.reserve(positions.size());
+    for (const auto& item : positions) {
+      const Vector3d feature_position = R_imu_body * item.second;
+      feature_msg_ptr->points.push_back(pcl::PointXYZ(
+            feature_position(0), feature_position(1), feature_position(2)));
+    }
+    feature_msg_ptr->width = feature_msg_ptr->points.size();
+    publisher.publish(feature_msg_ptr);
+  }
+}
+
+} // namespace msckf_vio
@@ -24,58 +24,67 @@ using namespace Eigen;
 
 namespace msckf_vio {
 ImageProcessor::ImageProcessor(ros::NodeHandle& n) :
-  nh(n),
+  nh(new ros::NodeHandle(n)),
   is_first_img(true),
   //img_transport(n),
   // stereo_sub(10),
-  cam0_img_sub(nh, "cam0_image", 10),
-  cam1_img_sub(nh, "cam1_image", 10),
   stereo_sub(message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::Image>(10), cam0_img_sub, cam1_img_sub),
   prev_features_ptr(new GridFeatures()),
-  curr_features_ptr(new GridFeatures()){ 
+  curr_features_ptr(new GridFeatures()),
+  tracking_pool(new ThreadPool(1)){ 
+  return;
+}
+
+ImageProcessor::ImageProcessor() :
+  is_first_img(true),
+  stereo_sub(message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::Image>(10), cam0_img_sub, cam1_img_sub),
+  prev_features_ptr(new GridFeatures()),
+  curr_features_ptr(new GridFeatures()),
+  tracking_pool(new ThreadPool(1)) {
   return;
 }
 
 ImageProcessor::~ImageProcessor() {
   destroyAllWindows();
+  if (imu_buffer) imu_buffer->releaseProducer(this);
   //ROS_INFO("Feature lifetime statistics:");
   //featureLifetimeStatistics();
   return;
 }
 
-bool ImageProcessor::loadParameters() {
+bool ImageProcessor::loadParameters(const ParameterReader& params) {
   // Camera calibration parameters
-  nh.param<string>("cam0/distortion_model",
+  params.param<string>("cam0/distortion_model",
       cam0_distortion_model, string("radtan"));
-  nh.param<string>("cam1/distortion_model",
+  params.param<string>("cam1/distortion_model",
       cam1_distortion_model, string("radtan"));
 
   vector<int> cam0_resolution_temp(2);
-  nh.getParam("cam0/resolution", cam0_resolution_temp);
+  params.getParam("cam0/resolution", cam0_resolution_temp);
   cam0_resolution[0] = cam0_resolution_temp[0];
   cam0_resolution[1] = cam0_resolution_temp[1];
 
   vector<int> cam1_resolution_temp(2);
-  nh.getParam("cam1/resolution", cam1_resolution_temp);
+  params.getParam("cam1/resolution", cam1_resolution_temp);
   cam1_resolution[0] = cam1_resolution_temp[0];
   cam1_resolution[1] = cam1_resolution_temp[1];
 
   vector<double> cam0_intrinsics_temp(4);
-  nh.getParam("cam0/intrinsics", cam0_intrinsics_temp);
+  params.getParam("cam0/intrinsics", cam0_intrinsics_temp);
   cam0_intrinsics[0] = cam0_intrinsics_temp[0];
   cam0_intrinsics[1] = cam0_intrinsics_temp[1];
   cam0_intrinsics[2] = cam0_intrinsics_temp[2];
   cam0_intrinsics[3] = cam0_intrinsics_temp[3];
 
   vector<double> cam1_intrinsics_temp(4);
-  nh.getParam("cam1/intrinsics", cam1_intrinsics_temp);
+  params.getParam("cam1/intrinsics", cam1_intrinsics_temp);
   cam1_intrinsics[0] = cam1_intrinsics_temp[0];
   cam1_intrinsics[1] = cam1_intrinsics_temp[1];
   cam1_intrinsics[2] = cam1_intrinsics_temp[2];
   cam1_intrinsics[3] = cam1_intrinsics_temp[3];
 
   vector<double> cam0_distortion_coeffs_temp(4);
-  nh.getParam("cam0/distortion_coeffs",
+  params.getParam("cam0/distortion_coeffs",
       cam0_distortion_coeffs_temp);
   cam0_distortion_coeffs[0] = cam0_distortion_coeffs_temp[0];
   cam0_distortion_coeffs[1] = cam0_distortion_coeffs_temp[1];
@@ -83,20 +92,20 @@ bool ImageProcessor::loadParameters() {
   cam0_distortion_coeffs[3] = cam0_distortion_coeffs_temp[3];
 
   vector<double> cam1_distortion_coeffs_temp(4);
-  nh.getParam("cam1/distortion_coeffs",
+  params.getParam("cam1/distortion_coeffs",
       cam1_distortion_coeffs_temp);
   cam1_distortion_coeffs[0] = cam1_distortion_coeffs_temp[0];
   cam1_distortion_coeffs[1] = cam1_distortion_coeffs_temp[1];
   cam1_distortion_coeffs[2] = cam1_distortion_coeffs_temp[2];
   cam1_distortion_coeffs[3] = cam1_distortion_coeffs_temp[3];
 
-  cv::Mat     T_imu_cam0 = utils::getTransformCV(nh, "cam0/T_cam_imu");
+  cv::Mat     T_imu_cam0 = utils::getTransformCV(params, "cam0/T_cam_imu");
   cv::Matx33d R_imu_cam0(T_imu_cam0(cv::Rect(0,0,3,3)));
   cv::Vec3d   t_imu_cam0 = T_imu_cam0(cv::Rect(3,0,1,3));
   R_cam0_imu = R_imu_cam0.t();
   t_cam0_imu = -R_imu_cam0.t() * t_imu_cam0;
 
-  cv::Mat T_cam0_cam1 = utils::getTransformCV(nh, "cam1/T_cn_cnm1");
+  cv::Mat T_cam0_cam1 = utils::getTransformCV(params, "cam1/T_cn_cnm1");
   cv::Mat T_imu_cam1 = T_cam0_cam1 * T_imu_cam0;
   cv::Matx33d R_imu_cam1(T_imu_cam1(cv::Rect(0,0,3,3)));
   cv::Vec3d   t_imu_cam1 = T_imu_cam1(cv::Rect(3,0,1,3));
@@ -104,26 +113,45 @@ bool ImageProcessor::loadParameters() {
   t_cam1_imu = -R_imu_cam1.t() * t_imu_cam1;
 
   // Processor parameters
-  nh.param<int>("grid_row", processor_config.grid_row, 4);
-  nh.param<int>("grid_col", processor_config.grid_col, 4);
-  nh.param<int>("grid_min_feature_num",
+  params.param<int>("grid_row", processor_config.grid_row, 4);
+  params.param<int>("grid_col", processor_config.grid_col, 4);
+  params.param<int>("grid_min_feature_num",
       processor_config.grid_min_feature_num, 2);
-  nh.param<int>("grid_max_feature_num",
+  params.param<int>("grid_max_feature_num",
       processor_config.grid_max_feature_num, 4);
-  nh.param<int>("pyramid_levels",
+  params.param<int>("pyramid_levels",
       processor_config.pyramid_levels, 3);
-  nh.param<int>("patch_size",
+  params.param<int>("patch_size",
       processor_config.patch_size, 31);
-  nh.param<int>("fast_threshold",
+  params.param<int>("fast_threshold",
       processor_config.fast_threshold, 20);
-  nh.param<int>("max_iteration",
+  params.param<int>("max_iteration",
       processor_config.max_iteration, 30);
-  nh.param<double>("track_precision",
+  params.param<double>("track_precision",
       processor_config.track_precision, 0.01);
-  nh.param<double>("ransac_threshold",
+  params.param<double>("ransac_threshold",
       processor_config.ransac_threshold, 3);
-  nh.param<double>("stereo_threshold",
+  params.param<bool>("ransac_adaptive_termination",
+      processor_config.ransac_adaptive_termination, true);
+  params.param<double>("stereo_threshold",
       processor_config.stereo_threshold, 3);
+  params.param<int>("undistortion_cell_size",
+      processor_config.undistortion_cell_size, 2);
+
+  // Threads for the independent stages of the tracking, i.e. the
+  // pyramids of the two cameras, the temporal tracking and the
+  // RANSAC of each camera, and the detection in each grid.
+  int tracking_thread_num;
+  params.param<int>("tracking_thread_num", tracking_thread_num, 1);
+  tracking_pool.reset(new ThreadPool(std::max(tracking_thread_num, 1)));
+
+  // The IMU buffer holds the samples received over the
+  // worst-case delay before they are used.
+  double imu_rate, imu_buffer_duration;
+  params.param<double>("imu_rate", imu_rate, 200.0);
+  params.param<double>("imu_buffer_duration", imu_buffer_duration, 20.0);
+  imu_buffer_capacity = ImuBuffer::requiredCapacity(
+      imu_rate, imu_buffer_duration);
 
   ROS_INFO("===========================================");
   ROS_INFO("cam0_resolution: %d, %d",
@@ -171,45 +199,81 @@ bool ImageProcessor::loadParameters() {
       processor_config.track_precision);
   ROS_INFO("ransac_threshold: %f",
       processor_config.ransac_threshold);
+  ROS_INFO("ransac_adaptive_termination: %d",
+      processor_config.ransac_adaptive_termination);
   ROS_INFO("stereo_threshold: %f",
       processor_config.stereo_threshold);
+  ROS_INFO("undistortion_cell_size: %d",
+      processor_config.undistortion_cell_size);
+  ROS_INFO("tracking_thread_num: %d",
+      tracking_pool->size());
+  ROS_INFO("imu_rate: %f", imu_rate);
+  ROS_INFO("imu_buffer_duration: %f", imu_buffer_duration);
   ROS_INFO("===========================================");
   return true;
 }
 
 bool ImageProcessor::createRosIO() {
-  feature_pub = nh.advertise<CameraMeasurement>(
+  feature_pub = nh->advertise<CameraMeasurement>(
       "features", 3); 
-  tracking_info_pub = nh.advertise<TrackingInfo>(
+  tracking_info_pub = nh->advertise<TrackingInfo>(
       "tracking_info", 1);
-  cam0_img_pub = nh.advertise<sensor_msgs::Image>(
+  cam0_img_pub = nh->advertise<sensor_msgs::Image>(
       "cam0_rgb_image",3);
   // cam1_img_pub = nh.advertise<sensor_msgs::Image>(
   //     "cam1_rgb_image",3);
-  image_transport::ImageTransport it(nh);
+  image_transport::ImageTransport it(*nh);
   debug_stereo_pub = it.advertise("debug_stereo_image", 1);
 
-  // cam0_img_sub.subscribe(nh, "cam0_image", 10);
-  // cam1_img_sub.subscribe(nh, "cam1_image", 10);
+  cam0_img_sub.subscribe(*nh, "cam0_image", 10);
+  cam1_img_sub.subscribe(*nh, "cam1_image", 10);
   // stereo_sub.connectInput(cam0_img_sub, cam1_img_sub);
   
   // message_filters::Synchronizer<MySyncPolicy> stereo_sub(MySyncPolicy(10), cam0_img_sub, cam1_img_sub);
   stereo_sub.registerCallback(&ImageProcessor::stereoCallback, this);
 
-  imu_sub = nh.subscribe("imu", 50,
+  imu_sub = nh->subscribe("imu", 50,
       &ImageProcessor::imuCallback, this);
 
+  latency_diagnostics.initialize(*nh, "image_processor/");
+
   return true;
 }
 
 bool ImageProcessor::initialize() {
-  if (!loadParameters()) return false;
+  if (!nh) return false;
+  return initialize(ParameterReader(*nh));
+}
+
+bool ImageProcessor::initialize(const ParameterReader& params,
+    const ImuBuffer::Ptr& shared_imu_buffer) {
+  if (!loadParameters(params)) return false;
   ROS_INFO("Finish loading ROS parameters...");
 
   // Create feature detector.
   // 特征提取初始化
   detector_ptr = FastFeatureDetector::create(processor_config.fast_threshold);
 
+  allocateBuffers();
+  createUndistortionMaps();
+
+  // The IMU samples are shared with the estimator if both
+  // run in one process. Without a node handle, only the given
+  // buffer is shared, so that several pipelines in one process
+  // do not read each other's samples.
+  if (shared_imu_buffer)
+    imu_buffer = shared_imu_buffer;
+  else if (nh)
+    imu_buffer = ImuBuffer::getShared(
+        nh->resolveName("imu"), imu_buffer_capacity);
+  else
+    imu_buffer.reset(new ImuBuffer(imu_buffer_capacity));
+  next_imu_seq = imu_buffer->end();
+  if (imu_buffer->capacity() < imu_buffer_capacity)
+    ROS_WARN("Shared IMU buffer holds %d samples, %d required.",
+        imu_buffer->capacity(), imu_buffer_capacity);
+
+  if (!nh) return true;
   if (!createRosIO()) return false;
   ROS_INFO("Finish creating ROS IO...");
 
@@ -220,6 +284,7 @@ void ImageProcessor::stereoCallback(
     const sensor_msgs::ImageConstPtr& cam0_img,
     const sensor_msgs::ImageConstPtr& cam1_img) 
     {
+  ScopedTrace trace("image_processor/stereoCallback");
 
   // cout << "==================================" << endl;
   // Get the current image.
@@ -229,118 +294,154 @@ void ImageProcessor::stereoCallback(
   cam1_curr_img_ptr = cv_bridge::toCvShare(cam1_img,
       sensor_msgs::image_encodings::MONO8);
 
-  cam0_color_img_ptr = cv_bridge::toCvShare(cam0_img,
+  // The color image is only published with ros io.
+  if (nh) cam0_color_img_ptr = cv_bridge::toCvShare(cam0_img,
       sensor_msgs::image_encodings::RGB8);
 
-  // Build the image pyramids once since they're used at multiple places
-  createImagePyramids();
-
   // Detect features in the first frame.
   if (is_first_img) {
-    ros::Time start_time = ros::Time::now();
+    // Build the image pyramids once since they're used at multiple places
+    createImagePyramids();
+
     // 初始化第一批特征点
     initializeFirstFrame();
-    //ROS_INFO("Detection time: %f",
-    //    (ros::Time::now()-start_time).toSec());
 
     is_first_img = false;
 
     // Draw results.
-    start_time = ros::Time::now();
-    drawFeaturesMono();
+    if (nh) drawFeaturesMono();
     // drawFeaturesStereo();
-    //ROS_INFO("Draw features: %f",
-    //    (ros::Time::now()-start_time).toSec());
   } else {
-    // Track the feature in the previous image.
-    ros::Time start_time = ros::Time::now();
+    // Track the feature in the previous image. The pyramids
+    // are built along with the tracking.
     trackFeatures();
-    //ROS_INFO("Tracking time: %f",
-    //    (ros::Time::now()-start_time).toSec());
-    // ROS_INFO("trackFeatures DONE.");
     // Add new features into the current image.
-    start_time = ros::Time::now();
     // 左右目提取新特征，通过左右目光流法跟踪去外点，向变量添加新的特征
     addNewFeatures();
-    //ROS_INFO("Addition time: %f",
-    //    (ros::Time::now()-start_time).toSec());
-    // ROS_INFO("addNewFeatures DONE.");
     // Add new features into the current image.
-    start_time = ros::Time::now();
     pruneGridFeatures();
-    // ROS_INFO("pruneGridFeatures DONE.");
-    //ROS_INFO("Prune grid features: %f",
-    //    (ros::Time::now()-start_time).toSec());
 
     // Draw results.
-    start_time = ros::Time::now();
-
     // 当有其他节点订阅了 debug_stereo_image消息时，将双目图像拼接起来画出特征点位置，作为消息发送出去
-    drawFeaturesMono();
+    if (nh) drawFeaturesMono();
     // drawFeaturesStereo();
-    // ROS_INFO("drawFeaturesStereo DONE.");
-    // ROS_INFO("===========================================");
-    // ROS_INFO("Draw features: %f",
-    //    (ros::Time::now()-start_time).toSec());
   }
 
-  //ros::Time start_time = ros::Time::now();
   //updateFeatureLifetime();
-  //ROS_INFO("Statistics: %f",
-  //    (ros::Time::now()-start_time).toSec());
 
   // Publish features in the current image.
-  ros::Time start_time = ros::Time::now();
   publish();
-  //ROS_INFO("Publishing: %f",
-  //    (ros::Time::now()-start_time).toSec());
 
-  // Update the previous image and previous features.
+  // Update the previous image and previous features. The
+  // pyramid and the grids of the previous image are reused
+  // for the next image.
   cam0_prev_img_ptr = cam0_curr_img_ptr;
-  prev_features_ptr = curr_features_ptr;
+  std::swap(prev_features_ptr, curr_features_ptr);
   std::swap(prev_cam0_pyramid_, curr_cam0_pyramid_);
 
   // Initialize the current features to empty vectors.
-  curr_features_ptr.reset(new GridFeatures());
-  for (int code = 0; code <
-      processor_config.grid_row*processor_config.grid_col; ++code) {
-    (*curr_features_ptr)[code] = vector<FeatureMetaData>(0);
-  }
+  for (auto& item : *curr_features_ptr)
+    item.second.clear();
 
   return;
 }
 
 void ImageProcessor::imuCallback(
     const sensor_msgs::ImuConstPtr& msg) {
-  // Wait for the first image to be set.
+  // The msgs are pushed even before the first image, since
+  // the buffer is bounded and may be used by the estimator.
+  // Only one of the users of a shared buffer pushes the msgs.
+  if (!imu_buffer->claimProducer(this)) return;
+
+  ImuSample sample;
+  sample.time = msg->header.stamp.toSec();
+  sample.angular_velocity = Eigen::Vector3d(msg->angular_velocity.x,
+      msg->angular_velocity.y, msg->angular_velocity.z);
+  sample.linear_acceleration = Eigen::Vector3d(msg->linear_acceleration.x,
+      msg->linear_acceleration.y, msg->linear_acceleration.z);
+  imu_buffer->push(sample);
+  return;
+}
+
+void ImageProcessor::allocateBuffers() {
+  // The pyramids are rebuilt in place as long as the size of
+  // the images does not change, so building them once on blank
+  // images allocates the buffers for all the following frames.
+  const Mat cam0_img = Mat::zeros(
+      cam0_resolution[1], cam0_resolution[0], CV_8U);
+  const Mat cam1_img = Mat::zeros(
+      cam1_resolution[1], cam1_resolution[0], CV_8U);
+  createImagePyramid(cam0_img, prev_cam0_pyramid_);
+  createImagePyramid(cam0_img, curr_cam0_pyramid_);
+  createImagePyramid(cam1_img, curr_cam1_pyramid_);
+  feature_occupancy.assign(cam0_img.total(), 0);
+
+  const int grid_num =
+    processor_config.grid_row*processor_config.grid_col;
+  for (int code = 0; code < grid_num; ++code) {
+    (*prev_features_ptr)[code].reserve(
+        processor_config.grid_max_feature_num);
+    (*curr_features_ptr)[code].reserve(
+        processor_config.grid_max_feature_num);
+    grid_new_features[code].clear();
+  }
+  new_feature_sieve.resize(grid_num);
+  grid_keypoints.resize(grid_num);
+  return;
+}
 
-  if (is_first_img) return;
-  imu_msg_buffer.push_back(*msg);
+void ImageProcessor::createUndistortionMaps() {
+  if (cam0_distortion_model != "radtan" &&
+      cam0_distortion_model != "equidistant")
+    ROS_WARN("The model %s is unrecognized, using radtan instead...",
+        cam0_distortion_model.c_str());
+  if (cam1_distortion_model != "radtan" &&
+      cam1_distortion_model != "equidistant")
+    ROS_WARN("The model %s is unrecognized, using radtan instead...",
+        cam1_distortion_model.c_str());
+
+  cam0_undistortion_map.initialize(cam0_resolution, cam0_intrinsics,
+      cam0_distortion_model, cam0_distortion_coeffs,
+      processor_config.undistortion_cell_size);
+  cam1_undistortion_map.initialize(cam1_resolution, cam1_intrinsics,
+      cam1_distortion_model, cam1_distortion_coeffs,
+      processor_config.undistortion_cell_size);
+
+  if (cam0_undistortion_map.hasTable())
+    ROS_INFO("Undistortion table error: cam0 %fpx, cam1 %fpx",
+        cam0_undistortion_map.maxError(),
+        cam1_undistortion_map.maxError());
   return;
 }
 
 void ImageProcessor::createImagePyramids() {
-  const Mat& curr_cam0_img = cam0_curr_img_ptr->image;
-  buildOpticalFlowPyramid(
-      curr_cam0_img, curr_cam0_pyramid_,
-      Size(processor_config.patch_size, processor_config.patch_size),
-      processor_config.pyramid_levels, true, BORDER_REFLECT_101,
-      BORDER_CONSTANT, false);
+  ScopedTrace trace("image_processor/createImagePyramids");
+  tracking_pool->parallelFor(2, [&](const int& i) {
+    if (i == 0)
+      createImagePyramid(cam0_curr_img_ptr->image, curr_cam0_pyramid_);
+    else
+      createImagePyramid(cam1_curr_img_ptr->image, curr_cam1_pyramid_);
+  });
+  return;
+}
 
-  const Mat& curr_cam1_img = cam1_curr_img_ptr->image;
+void ImageProcessor::createImagePyramid(
+    const Mat& img, vector<Mat>& pyramid) const {
   buildOpticalFlowPyramid(
-      curr_cam1_img, curr_cam1_pyramid_,
+      img, pyramid,
       Size(processor_config.patch_size, processor_config.patch_size),
       processor_config.pyramid_levels, true, BORDER_REFLECT_101,
       BORDER_CONSTANT, false);
+  return;
 }
 
 void ImageProcessor::initializeFirstFrame() {
+  ScopedTrace trace("image_processor/initializeFirstFrame");
   // Size of each grid.
   
   const Mat& img = cam0_curr_img_ptr->image;
-  static int grid_height = img.rows / processor_config.grid_row;
-  static int grid_width = img.cols / processor_config.grid_col;
+  const int grid_height = img.rows / processor_config.grid_row;
+  const int grid_width = img.cols / processor_config.grid_col;
 
   // Detect new features on the frist image.
   // 计算原图fast特征点
@@ -357,24 +458,30 @@ void ImageProcessor::initializeFirstFrame() {
   // 利用LKT光流法在cam1中找到与cam0中特征匹配的点，然后使用双目约束筛选内点
   vector<cv::Point2f> cam1_points(0);
   vector<unsigned char> inlier_markers(0);
-  stereoMatch(cam0_points, cam1_points, inlier_markers);
+  vector<cv::Point2f> cam0_points_undistorted(0);
+  vector<cv::Point2f> cam1_points_undistorted(0);
+  stereoMatch(cam0_points, cam1_points, inlier_markers,
+      cam0_points_undistorted, cam1_points_undistorted);
 
   vector<cv::Point2f> cam0_inliers(0);
   vector<cv::Point2f> cam1_inliers(0);
+  vector<cv::Point2f> cam0_undistorted_inliers(0);
+  vector<cv::Point2f> cam1_undistorted_inliers(0);
   vector<float> response_inliers(0);
   for (int i = 0; i < inlier_markers.size(); ++i) {
     if (inlier_markers[i] == 0) continue;
     cam0_inliers.push_back(cam0_points[i]);
     cam1_inliers.push_back(cam1_points[i]);
+    cam0_undistorted_inliers.push_back(cam0_points_undistorted[i]);
+    cam1_undistorted_inliers.push_back(cam1_points_undistorted[i]);
     response_inliers.push_back(new_features[i].response);
   }
 
   // Group the features into grids
   // 分格存入
-  GridFeatures grid_new_features;
   for (int code = 0; code <
       processor_config.grid_row*processor_config.grid_col; ++code)
-      grid_new_features[code] = vector<FeatureMetaData>(0);
+      grid_new_features[code].clear();
 
   for (int i = 0; i < cam0_inliers.size(); ++i) {
     const cv::Point2f& cam0_point = cam0_inliers[i];
@@ -389,6 +496,8 @@ void ImageProcessor::initializeFirstFrame() {
     new_feature.response = response;
     new_feature.cam0_point = cam0_point;
     new_feature.cam1_point = cam1_point;
+    new_feature.cam0_point_undistorted = cam0_undistorted_inliers[i];
+    new_feature.cam1_point_undistorted = cam1_undistorted_inliers[i];
     grid_new_features[code].push_back(new_feature);
   }
 
@@ -447,10 +556,11 @@ void ImageProcessor::predictFeatureTracking(
 // 当前帧再通过双目跟踪，进一步去除一些外点
 // 最后左右目分别跟上一帧左右目做ransac
 void ImageProcessor::trackFeatures() {
+  ScopedTrace trace("image_processor/trackFeatures");
   // Size of each grid.
-  static int grid_height =
+  const int grid_height =
     cam0_curr_img_ptr->image.rows / processor_config.grid_row;
-  static int grid_width =
+  const int grid_width =
     cam0_curr_img_ptr->image.cols / processor_config.grid_col;
 
   // Compute a rough relative rotation which takes a vector
@@ -464,6 +574,8 @@ void ImageProcessor::trackFeatures() {
   vector<int> prev_lifetime(0);
   vector<Point2f> prev_cam0_points(0);
   vector<Point2f> prev_cam1_points(0);
+  vector<Point2f> prev_cam0_points_undistorted(0);
+  vector<Point2f> prev_cam1_points_undistorted(0);
 
   for (const auto& item : *prev_features_ptr) {
     for (const auto& prev_feature : item.second) {
@@ -471,16 +583,16 @@ void ImageProcessor::trackFeatures() {
       prev_lifetime.push_back(prev_feature.lifetime);
       prev_cam0_points.push_back(prev_feature.cam0_point);
       prev_cam1_points.push_back(prev_feature.cam1_point);
+      prev_cam0_points_undistorted.push_back(
+          prev_feature.cam0_point_undistorted);
+      prev_cam1_points_undistorted.push_back(
+          prev_feature.cam1_point_undistorted);
     }
   }
 
   // Number of the features before tracking.
   before_tracking = prev_cam0_points.size();
 
-  // Abort tracking if there is no features in
-  // the previous frame.
-  if (prev_ids.size() == 0) return;
-
   // Track features using LK optical flow method.
   vector<Point2f> curr_cam0_points(0);
   vector<unsigned char> track_inliers(0);
@@ -488,16 +600,34 @@ void ImageProcessor::trackFeatures() {
   predictFeatureTracking(prev_cam0_points,
       cam0_R_p_c, cam0_intrinsics, curr_cam0_points);
 
-  calcOpticalFlowPyrLK(
-      prev_cam0_pyramid_, curr_cam0_pyramid_,
-      prev_cam0_points, curr_cam0_points,
-      track_inliers, noArray(),
-      Size(processor_config.patch_size, processor_config.patch_size),
-      processor_config.pyramid_levels,
-      TermCriteria(TermCriteria::COUNT+TermCriteria::EPS,
-        processor_config.max_iteration,
-        processor_config.track_precision),
-      cv::OPTFLOW_USE_INITIAL_FLOW);
+  // The temporal tracking only needs the cam0 pyramids, so
+  // the cam1 pyramid is built in the meantime.
+  {
+    ScopedTrace trace("image_processor/temporalTracking");
+    tracking_pool->parallelFor(2, [&](const int& i) {
+      if (i == 1) {
+        createImagePyramid(cam1_curr_img_ptr->image, curr_cam1_pyramid_);
+        return;
+      }
+      createImagePyramid(cam0_curr_img_ptr->image, curr_cam0_pyramid_);
+      if (prev_cam0_points.size() == 0) return;
+
+      calcOpticalFlowPyrLK(
+          prev_cam0_pyramid_, curr_cam0_pyramid_,
+          prev_cam0_points, curr_cam0_points,
+          track_inliers, noArray(),
+          Size(processor_config.patch_size, processor_config.patch_size),
+          processor_config.pyramid_levels,
+          TermCriteria(TermCriteria::COUNT+TermCriteria::EPS,
+            processor_config.max_iteration,
+            processor_config.track_precision),
+          cv::OPTFLOW_USE_INITIAL_FLOW);
+    });
+  }
+
+  // Abort tracking if there is no features in
+  // the previous frame.
+  if (prev_ids.size() == 0) return;
 
   // Mark those tracked points out of the image region
   // as untracked.
@@ -515,6 +645,8 @@ void ImageProcessor::trackFeatures() {
   vector<int> prev_tracked_lifetime(0);
   vector<Point2f> prev_tracked_cam0_points(0);
   vector<Point2f> prev_tracked_cam1_points(0);
+  vector<Point2f> prev_tracked_cam0_points_undistorted(0);
+  vector<Point2f> prev_tracked_cam1_points_undistorted(0);
   vector<Point2f> curr_tracked_cam0_points(0);
 
   removeUnmarkedElements(
@@ -525,6 +657,10 @@ void ImageProcessor::trackFeatures() {
       prev_cam0_points, track_inliers, prev_tracked_cam0_points);
   removeUnmarkedElements(
       prev_cam1_points, track_inliers, prev_tracked_cam1_points);
+  removeUnmarkedElements(prev_cam0_points_undistorted,
+      track_inliers, prev_tracked_cam0_points_undistorted);
+  removeUnmarkedElements(prev_cam1_points_undistorted,
+      track_inliers, prev_tracked_cam1_points_undistorted);
   removeUnmarkedElements(
       curr_cam0_points, track_inliers, curr_tracked_cam0_points);
 
@@ -549,11 +685,16 @@ void ImageProcessor::trackFeatures() {
   //
   // For Step 3, tracking between the images is no longer needed.
   // The stereo matching results are directly used in the RANSAC.
+  // The RANSAC also uses the points undistorted in the stereo
+  // matching of the previous and current images.
 
   // Step 1: stereo matching.
   vector<Point2f> curr_cam1_points(0);
   vector<unsigned char> match_inliers(0);
-  stereoMatch(curr_tracked_cam0_points, curr_cam1_points, match_inliers);
+  vector<Point2f> curr_cam0_points_undistorted(0);
+  vector<Point2f> curr_cam1_points_undistorted(0);
+  stereoMatch(curr_tracked_cam0_points, curr_cam1_points, match_inliers,
+      curr_cam0_points_undistorted, curr_cam1_points_undistorted);
 
   vector<FeatureIDType> prev_matched_ids(0);
   vector<int> prev_matched_lifetime(0);
@@ -561,6 +702,10 @@ void ImageProcessor::trackFeatures() {
   vector<Point2f> prev_matched_cam1_points(0);
   vector<Point2f> curr_matched_cam0_points(0);
   vector<Point2f> curr_matched_cam1_points(0);
+  vector<Point2f> prev_matched_cam0_points_undistorted(0);
+  vector<Point2f> prev_matched_cam1_points_undistorted(0);
+  vector<Point2f> curr_matched_cam0_points_undistorted(0);
+  vector<Point2f> curr_matched_cam1_points_undistorted(0);
 
   removeUnmarkedElements(
       prev_tracked_ids, match_inliers, prev_matched_ids);
@@ -574,22 +719,36 @@ void ImageProcessor::trackFeatures() {
       curr_tracked_cam0_points, match_inliers, curr_matched_cam0_points);
   removeUnmarkedElements(
       curr_cam1_points, match_inliers, curr_matched_cam1_points);
+  removeUnmarkedElements(prev_tracked_cam0_points_undistorted,
+      match_inliers, prev_matched_cam0_points_undistorted);
+  removeUnmarkedElements(prev_tracked_cam1_points_undistorted,
+      match_inliers, prev_matched_cam1_points_undistorted);
+  removeUnmarkedElements(curr_cam0_points_undistorted,
+      match_inliers, curr_matched_cam0_points_undistorted);
+  removeUnmarkedElements(curr_cam1_points_undistorted,
+      match_inliers, curr_matched_cam1_points_undistorted);
 
   // Number of features left after stereo matching.
   after_matching = curr_matched_cam0_points.size();
 
-  // Step 2 and 3: RANSAC on temporal image pairs of cam0 and cam1.
+  // Step 2 and 3: RANSAC on temporal image pairs of cam0 and cam1,
+  // which are independent of each other.
   vector<int> cam0_ransac_inliers(0);
-  twoPointRansac(prev_matched_cam0_points, curr_matched_cam0_points,
-      cam0_R_p_c, cam0_intrinsics, cam0_distortion_model,
-      cam0_distortion_coeffs, processor_config.ransac_threshold,
-      0.99, cam0_ransac_inliers);
-
   vector<int> cam1_ransac_inliers(0);
-  twoPointRansac(prev_matched_cam1_points, curr_matched_cam1_points,
-      cam1_R_p_c, cam1_intrinsics, cam1_distortion_model,
-      cam1_distortion_coeffs, processor_config.ransac_threshold,
-      0.99, cam1_ransac_inliers);
+  tracking_pool->parallelFor(2, [&](const int& i) {
+    if (i == 0)
+      twoPointRansac(prev_matched_cam0_points_undistorted,
+          curr_matched_cam0_points_undistorted, cam0_R_p_c,
+          cam0_intrinsics, processor_config.ransac_threshold, 0.99,
+          processor_config.ransac_adaptive_termination,
+          cam0_ransac_inliers);
+    else
+      twoPointRansac(prev_matched_cam1_points_undistorted,
+          curr_matched_cam1_points_undistorted, cam1_R_p_c,
+          cam1_intrinsics, processor_config.ransac_threshold, 0.99,
+          processor_config.ransac_adaptive_termination,
+          cam1_ransac_inliers);
+  });
 
   // Number of features after ransac.
   after_ransac = 0;
@@ -609,6 +768,10 @@ void ImageProcessor::trackFeatures() {
     grid_new_feature.lifetime = ++prev_matched_lifetime[i];
     grid_new_feature.cam0_point = curr_matched_cam0_points[i];
     grid_new_feature.cam1_point = curr_matched_cam1_points[i];
+    grid_new_feature.cam0_point_undistorted =
+      curr_matched_cam0_points_undistorted[i];
+    grid_new_feature.cam1_point_undistorted =
+      curr_matched_cam1_points_undistorted[i];
 
     ++after_ransac;
   }
@@ -639,20 +802,32 @@ void ImageProcessor::trackFeatures() {
 void ImageProcessor::stereoMatch(
     const vector<cv::Point2f>& cam0_points,
     vector<cv::Point2f>& cam1_points,
-    vector<unsigned char>& inlier_markers) {
+    vector<unsigned char>& inlier_markers,
+    vector<cv::Point2f>& cam0_points_undistorted,
+    vector<cv::Point2f>& cam1_points_undistorted) {
+  ScopedTrace trace("image_processor/stereoMatch");
 
   if (cam0_points.size() == 0) return;
 
+  // The undistorted cam0 points are used by both the initial
+  // guess and the epipolar check.
+  cam0_undistortion_map.undistortPoints(
+      cam0_points, cam0_points_undistorted);
+
+  // Compute the relative rotation between the cam0
+  // frame and cam1 frame.
+  const cv::Matx33d R_cam0_cam1 = R_cam1_imu.t() * R_cam0_imu;
+
   if(cam1_points.size() == 0) {
     // Initialize cam1_points by projecting cam0_points to cam1 using the
     // rotation from stereo extrinsics
-    const cv::Matx33d R_cam0_cam1 = R_cam1_imu.t() * R_cam0_imu;
-    vector<cv::Point2f> cam0_points_undistorted;
-    undistortPoints(cam0_points, cam0_intrinsics, cam0_distortion_model,
-                    cam0_distortion_coeffs, cam0_points_undistorted,
-                    R_cam0_cam1);
-    cam1_points = distortPoints(cam0_points_undistorted, cam1_intrinsics,
-                                cam1_distortion_model, cam1_distortion_coeffs);
+    vector<cv::Point2f> cam0_points_rectified(cam0_points.size());
+    for (int i = 0; i < cam0_points.size(); ++i) {
+      const cv::Vec3d pt = R_cam0_cam1 * cv::Vec3d(
+          cam0_points_undistorted[i].x, cam0_points_undistorted[i].y, 1.0);
+      cam0_points_rectified[i] = cv::Point2f(pt[0]/pt[2], pt[1]/pt[2]);
+    }
+    cam1_undistortion_map.distortPoints(cam0_points_rectified, cam1_points);
   }
 
   // Track features using LK optical flow method.
@@ -677,9 +852,6 @@ void ImageProcessor::stereoMatch(
       inlier_markers[i] = 0;
   }
 
-  // Compute the relative rotation between the cam0
-  // frame and cam1 frame.
-  const cv::Matx33d R_cam0_cam1 = R_cam1_imu.t() * R_cam0_imu;
   const cv::Vec3d t_cam0_cam1 = R_cam1_imu.t() * (t_cam0_imu-t_cam1_imu);
   // Compute the essential matrix.
   const cv::Matx33d t_cam0_cam1_hat(
@@ -690,16 +862,8 @@ void ImageProcessor::stereoMatch(
 
   // Further remove outliers based on the known
   // essential matrix.
-  vector<cv::Point2f> cam0_points_undistorted(0);
-  vector<cv::Point2f> cam1_points_undistorted(0);
-
-  undistortPoints(
-      cam0_points, cam0_intrinsics, cam0_distortion_model,
-      cam0_distortion_coeffs, cam0_points_undistorted);
-
-  undistortPoints(
-      cam1_points, cam1_intrinsics, cam1_distortion_model,
-      cam1_distortion_coeffs, cam1_points_undistorted);
+  cam1_undistortion_map.undistortPoints(
+      cam1_points, cam1_points_undistorted);
 
   double norm_pixel_unit = 4.0 / (
       cam0_intrinsics[0]+cam0_intrinsics[1]+
@@ -723,89 +887,55 @@ void ImageProcessor::stereoMatch(
 }
 
 void ImageProcessor::addNewFeatures() {
+  ScopedTrace trace("image_processor/addNewFeatures");
   const Mat& curr_img = cam0_curr_img_ptr->image;
 
   // Size of each grid.
-  static int grid_height =
+  const int grid_height =
     cam0_curr_img_ptr->image.rows / processor_config.grid_row;
-  static int grid_width =
+  const int grid_width =
     cam0_curr_img_ptr->image.cols / processor_config.grid_col;
 
-  // Create a mask to avoid redetecting existing features.
-  Mat mask(curr_img.rows, curr_img.cols, CV_8U, Scalar(1));
-
-  for (const auto& features : *curr_features_ptr) {
-    for (const auto& feature : features.second) {
-      const int y = static_cast<int>(feature.cam0_point.y);
-      const int x = static_cast<int>(feature.cam0_point.x);
-
-      int up_lim = y-2, bottom_lim = y+3,
-          left_lim = x-2, right_lim = x+3;
-      if (up_lim < 0) up_lim = 0;
-      if (bottom_lim > curr_img.rows) bottom_lim = curr_img.rows;
-      if (left_lim < 0) left_lim = 0;
-      if (right_lim > curr_img.cols) right_lim = curr_img.cols;
-
-      Range row_range(up_lim, bottom_lim);
-      Range col_range(left_lim, right_lim);
-      mask(row_range, col_range) = 0;
-    }
+  // Only the grids short of features are searched, so the cost
+  // of the detection is proportional to the missing coverage.
+  detection_grids.clear();
+  for (int code = 0; code <
+      processor_config.grid_row*processor_config.grid_col; ++code) {
+    if ((*curr_features_ptr)[code].size() <
+        processor_config.grid_min_feature_num)
+      detection_grids.push_back(code);
   }
 
-  // Detect new features.
-  vector<KeyPoint> new_features(0);
-  detector_ptr->detect(curr_img, new_features, mask);
+  // Mark the pixels around the existing features as occupied
+  // to avoid redetecting them.
+  if (feature_occupancy.size() != curr_img.total())
+    feature_occupancy.assign(curr_img.total(), 0);
+  markFeatureOccupancy(curr_img.rows, curr_img.cols, 1);
 
-  // Collect the new detected features based on the grid.
-  // Select the ones with top response within each grid afterwards.
-  vector<vector<KeyPoint> > new_feature_sieve(
+  // Detect new features in each of the grids and keep the
+  // ones with top response.
+  new_feature_sieve.resize(
       processor_config.grid_row*processor_config.grid_col);
-
-  // 确保 new_feature_sieve 中每个网格都有一个空的特征列表
-  // for (int i = 0; i < processor_config.grid_row * processor_config.grid_col; ++i) {
-  //     new_feature_sieve[i] = std::vector<KeyPoint>();
-  // }   
-
-  for (const auto& feature : new_features) {
-    int row = static_cast<int>(feature.pt.y / grid_height);
-    int col = static_cast<int>(feature.pt.x / grid_width);
-
-    if (row >= 0 && row < processor_config.grid_row &&
-    col >= 0 && col < processor_config.grid_col) {
-
-    new_feature_sieve[
-      row*processor_config.grid_col+col].push_back(feature);}
-
-      
-    else{
-      ROS_ERROR("Something wrong");
-      // if (row < 0) {
-      //   row = 0;  // 将row调整为最小值
-      // } else if (row >= processor_config.grid_row) {
-      //   row = processor_config.grid_row - 1;  // 将row调整为最大值
-      // } 
-
-      // if (col < 0) {
-      //     col = 0;  // 将col调整为最小值
-      // } else if (col >= processor_config.grid_col) {
-      //     col = processor_config.grid_col - 1;  // 将col调整为最大值
-      // }
-
-      // // 将特征添加到最近的有效网格中
-      // new_feature_sieve[row * processor_config.grid_col + col].push_back(feature);
-    }
-  }
-
+  grid_keypoints.resize(new_feature_sieve.size());
+  tracking_pool->parallelFor(detection_grids.size(), [&](const int& i) {
+    const int code = detection_grids[i];
+    const Rect grid(
+        (code%processor_config.grid_col)*grid_width,
+        (code/processor_config.grid_col)*grid_height,
+        grid_width, grid_height);
+    detectGridFeatures(curr_img, grid,
+        grid_keypoints[code], new_feature_sieve[code]);
+  });
+
+  // The occupancy is cleared the same way it is marked, which
+  // is cheaper than clearing the whole image.
+  markFeatureOccupancy(curr_img.rows, curr_img.cols, 0);
+
+  vector<KeyPoint>& new_features = new_keypoints;
   new_features.clear();
-  for (auto& item : new_feature_sieve) {
-    if (item.size() > processor_config.grid_max_feature_num) {
-      std::sort(item.begin(), item.end(),
-          &ImageProcessor::keyPointCompareByResponse);
-      item.erase(
-          item.begin()+processor_config.grid_max_feature_num, item.end());
-    }
-    new_features.insert(new_features.end(), item.begin(), item.end());
-  }
+  for (const int& code : detection_grids)
+    new_features.insert(new_features.end(),
+        new_feature_sieve[code].begin(), new_feature_sieve[code].end());
 
   int detected_new_features = new_features.size();
 
@@ -817,15 +947,22 @@ void ImageProcessor::addNewFeatures() {
 
   vector<cv::Point2f> cam1_points(0);
   vector<unsigned char> inlier_markers(0);
-  stereoMatch(cam0_points, cam1_points, inlier_markers);
+  vector<cv::Point2f> cam0_points_undistorted(0);
+  vector<cv::Point2f> cam1_points_undistorted(0);
+  stereoMatch(cam0_points, cam1_points, inlier_markers,
+      cam0_points_undistorted, cam1_points_undistorted);
 
   vector<cv::Point2f> cam0_inliers(0);
   vector<cv::Point2f> cam1_inliers(0);
+  vector<cv::Point2f> cam0_undistorted_inliers(0);
+  vector<cv::Point2f> cam1_undistorted_inliers(0);
   vector<float> response_inliers(0);
   for (int i = 0; i < inlier_markers.size(); ++i) {
     if (inlier_markers[i] == 0) continue;
     cam0_inliers.push_back(cam0_points[i]);
     cam1_inliers.push_back(cam1_points[i]);
+    cam0_undistorted_inliers.push_back(cam0_points_undistorted[i]);
+    cam1_undistorted_inliers.push_back(cam1_points_undistorted[i]);
     response_inliers.push_back(new_features[i].response);
   }
 
@@ -838,10 +975,9 @@ void ImageProcessor::addNewFeatures() {
         cam0_curr_img_ptr->header.stamp.toSec());
 
   // Group the features into grids
-  GridFeatures grid_new_features;
   for (int code = 0; code <
       processor_config.grid_row*processor_config.grid_col; ++code)
-      grid_new_features[code] = vector<FeatureMetaData>(0);
+      grid_new_features[code].clear();
 
   for (int i = 0; i < cam0_inliers.size(); ++i) {
     const cv::Point2f& cam0_point = cam0_inliers[i];
@@ -856,6 +992,8 @@ void ImageProcessor::addNewFeatures() {
     new_feature.response = response;
     new_feature.cam0_point = cam0_point;
     new_feature.cam1_point = cam1_point;
+    new_feature.cam0_point_undistorted = cam0_undistorted_inliers[i];
+    new_feature.cam1_point_undistorted = cam1_undistorted_inliers[i];
     grid_new_features[code].push_back(new_feature);
   }
 
@@ -892,7 +1030,72 @@ void ImageProcessor::addNewFeatures() {
   return;
 }
 
+void ImageProcessor::markFeatureOccupancy(
+    const int& rows, const int& cols, const unsigned char& value) {
+  for (const auto& features : *curr_features_ptr) {
+    for (const auto& feature : features.second) {
+      const int y = static_cast<int>(feature.cam0_point.y);
+      const int x = static_cast<int>(feature.cam0_point.x);
+
+      int up_lim = y-2, bottom_lim = y+3,
+          left_lim = x-2, right_lim = x+3;
+      if (up_lim < 0) up_lim = 0;
+      if (bottom_lim > rows) bottom_lim = rows;
+      if (left_lim < 0) left_lim = 0;
+      if (right_lim > cols) right_lim = cols;
+      if (left_lim >= right_lim) continue;
+
+      for (int row = up_lim; row < bottom_lim; ++row)
+        std::fill(feature_occupancy.begin()+row*cols+left_lim,
+            feature_occupancy.begin()+row*cols+right_lim, value);
+    }
+  }
+  return;
+}
+
+void ImageProcessor::detectGridFeatures(
+    const Mat& img, const Rect& grid,
+    vector<KeyPoint>& keypoints,
+    vector<KeyPoint>& grid_features) const {
+  // FAST skips 3 pixels at the border of the image, and the
+  // non-maximum suppression needs the score of one more pixel.
+  // With this margin, the corners within the grid are the same
+  // as the ones detected on the whole image.
+  const int margin = 4;
+  const Rect roi = Rect(grid.x-margin, grid.y-margin,
+      grid.width+2*margin, grid.height+2*margin) &
+    Rect(0, 0, img.cols, img.rows);
+  FAST(img(roi), keypoints, processor_config.fast_threshold, true);
+
+  // Keep the strongest corners in a heap of bounded size with
+  // the weakest one on top.
+  grid_features.clear();
+  for (auto& keypoint : keypoints) {
+    keypoint.pt.x += roi.x;
+    keypoint.pt.y += roi.y;
+    if (!grid.contains(keypoint.pt)) continue;
+    const int y = static_cast<int>(keypoint.pt.y);
+    const int x = static_cast<int>(keypoint.pt.x);
+    if (feature_occupancy[y*img.cols+x]) continue;
+
+    if (grid_features.size() < processor_config.grid_max_feature_num) {
+      grid_features.push_back(keypoint);
+      std::push_heap(grid_features.begin(), grid_features.end(),
+          &ImageProcessor::keyPointCompareByResponse);
+    } else if (!grid_features.empty() &&
+        keypoint.response > grid_features.front().response) {
+      std::pop_heap(grid_features.begin(), grid_features.end(),
+          &ImageProcessor::keyPointCompareByResponse);
+      grid_features.back() = keypoint;
+      std::push_heap(grid_features.begin(), grid_features.end(),
+          &ImageProcessor::keyPointCompareByResponse);
+    }
+  }
+  return;
+}
+
 void ImageProcessor::pruneGridFeatures() {
+  ScopedTrace trace("image_processor/pruneGridFeatures");
   for (auto& item : *curr_features_ptr) {
     auto& grid_features = item.second;
     // Continue if the number of features in this grid does
@@ -908,102 +1111,28 @@ void ImageProcessor::pruneGridFeatures() {
   return;
 }
 
-void ImageProcessor::undistortPoints(
-    const vector<cv::Point2f>& pts_in,
-    const cv::Vec4d& intrinsics,
-    const string& distortion_model,
-    const cv::Vec4d& distortion_coeffs,
-    vector<cv::Point2f>& pts_out,
-    const cv::Matx33d &rectification_matrix,
-    const cv::Vec4d &new_intrinsics) {
-
-  if (pts_in.size() == 0) return;
-
-  const cv::Matx33d K(
-      intrinsics[0], 0.0, intrinsics[2],
-      0.0, intrinsics[1], intrinsics[3],
-      0.0, 0.0, 1.0);
-
-  const cv::Matx33d K_new(
-      new_intrinsics[0], 0.0, new_intrinsics[2],
-      0.0, new_intrinsics[1], new_intrinsics[3],
-      0.0, 0.0, 1.0);
-
-  if (distortion_model == "radtan") {
-    cv::undistortPoints(pts_in, pts_out, K, distortion_coeffs,
-                        rectification_matrix, K_new);
-  } else if (distortion_model == "equidistant") {
-    cv::fisheye::undistortPoints(pts_in, pts_out, K, distortion_coeffs,
-                                 rectification_matrix, K_new);
-  } else {
-    ROS_WARN_ONCE("The model %s is unrecognized, use radtan instead...",
-                  distortion_model.c_str());
-    cv::undistortPoints(pts_in, pts_out, K, distortion_coeffs,
-                        rectification_matrix, K_new);
-  }
-
-  return;
-}
-
-vector<cv::Point2f> ImageProcessor::distortPoints(
-    const vector<cv::Point2f>& pts_in,
-    const cv::Vec4d& intrinsics,
-    const string& distortion_model,
-    const cv::Vec4d& distortion_coeffs) {
-
-  const cv::Matx33d K(intrinsics[0], 0.0, intrinsics[2],
-                      0.0, intrinsics[1], intrinsics[3],
-                      0.0, 0.0, 1.0);
-
-  vector<cv::Point2f> pts_out;
-  if (distortion_model == "radtan") {
-    vector<cv::Point3f> homogenous_pts;
-    cv::convertPointsToHomogeneous(pts_in, homogenous_pts);
-    cv::projectPoints(homogenous_pts, cv::Vec3d::zeros(), cv::Vec3d::zeros(), K,
-                      distortion_coeffs, pts_out);
-  } else if (distortion_model == "equidistant") {
-    cv::fisheye::distortPoints(pts_in, pts_out, K, distortion_coeffs);
-  } else {
-    ROS_WARN_ONCE("The model %s is unrecognized, using radtan instead...",
-                  distortion_model.c_str());
-    vector<cv::Point3f> homogenous_pts;
-    cv::convertPointsToHomogeneous(pts_in, homogenous_pts);
-    cv::projectPoints(homogenous_pts, cv::Vec3d::zeros(), cv::Vec3d::zeros(), K,
-                      distortion_coeffs, pts_out);
-  }
-
-  return pts_out;
-}
-
 void ImageProcessor::integrateImuData(
     Matx33f& cam0_R_p_c, Matx33f& cam1_R_p_c) {
+  ScopedTrace trace("image_processor/integrateImuData");
   // Find the start and the end limit within the imu msg buffer.
-  auto begin_iter = imu_msg_buffer.begin();
-  while (begin_iter != imu_msg_buffer.end()) {
-    if ((begin_iter->header.stamp-
-          cam0_prev_img_ptr->header.stamp).toSec() < -0.01)
-      ++begin_iter;
-    else
-      break;
-  }
-
-  auto end_iter = begin_iter;
-  while (end_iter != imu_msg_buffer.end()) {
-    if ((end_iter->header.stamp-
-          cam0_curr_img_ptr->header.stamp).toSec() < 0.005)
-      ++end_iter;
-    else
-      break;
-  }
+  const ImuBuffer::SeqType begin_seq = imu_buffer->lowerBound(
+      cam0_prev_img_ptr->header.stamp.toSec()-0.01, next_imu_seq);
+  const ImuBuffer::SeqType end_seq = imu_buffer->lowerBound(
+      cam0_curr_img_ptr->header.stamp.toSec()+0.005, begin_seq);
 
   // Compute the mean angular velocity in the IMU frame.
   Vec3f mean_ang_vel(0.0, 0.0, 0.0);
-  for (auto iter = begin_iter; iter < end_iter; ++iter)
-    mean_ang_vel += Vec3f(iter->angular_velocity.x,
-        iter->angular_velocity.y, iter->angular_velocity.z);
+  int imu_sample_num = 0;
+  ImuSample sample;
+  for (ImuBuffer::SeqType seq = begin_seq; seq < end_seq; ++seq) {
+    if (!imu_buffer->get(seq, sample)) continue;
+    mean_ang_vel += Vec3f(sample.angular_velocity(0),
+        sample.angular_velocity(1), sample.angular_velocity(2));
+    ++imu_sample_num;
+  }
 
-  if (end_iter-begin_iter > 0)
-    mean_ang_vel *= 1.0f / (end_iter-begin_iter);
+  if (imu_sample_num > 0)
+    mean_ang_vel *= 1.0f / imu_sample_num;
 
   // Transform the mean angular velocity from the IMU
   // frame to the cam0 and cam1 frames.
@@ -1018,8 +1147,8 @@ void ImageProcessor::integrateImuData(
   cam0_R_p_c = cam0_R_p_c.t();
   cam1_R_p_c = cam1_R_p_c.t();
 
-  // Delete the useless and used imu messages.
-  imu_msg_buffer.erase(imu_msg_buffer.begin(), end_iter);
+  // Skip the useless and used imu messages.
+  next_imu_seq = end_seq;
   return;
 }
 
@@ -1048,11 +1177,11 @@ void ImageProcessor::rescalePoints(
 void ImageProcessor::twoPointRansac(
     const vector<Point2f>& pts1, const vector<Point2f>& pts2,
     const cv::Matx33f& R_p_c, const cv::Vec4d& intrinsics,
-    const std::string& distortion_model,
-    const cv::Vec4d& distortion_coeffs,
     const double& inlier_error,
     const double& success_probability,
+    const bool& adaptive_termination,
     vector<int>& inlier_markers) {
+  ScopedTrace trace("image_processor/twoPointRansac");
 
   // Check the size of input point size.
   if (pts1.size() != pts2.size())
@@ -1067,15 +1196,9 @@ void ImageProcessor::twoPointRansac(
   inlier_markers.clear();
   inlier_markers.resize(pts1.size(), 1);
 
-  // Undistort all the points.
-  vector<Point2f> pts1_undistorted(pts1.size());
-  vector<Point2f> pts2_undistorted(pts2.size());
-  undistortPoints(
-      pts1, intrinsics, distortion_model,
-      distortion_coeffs, pts1_undistorted);
-  undistortPoints(
-      pts2, intrinsics, distortion_model,
-      distortion_coeffs, pts2_undistorted);
+  // The points are undistorted already.
+  vector<Point2f> pts1_undistorted(pts1);
+  vector<Point2f> pts2_undistorted(pts2);
 
   // Compenstate the points in the previous image with
   // the relative rotation.
@@ -1143,44 +1266,53 @@ void ImageProcessor::twoPointRansac(
   }
 
   // In the case of general motion, the RANSAC model can be applied.
-  // The three column corresponds to tx, ty, and tz respectively.
-  MatrixXd coeff_t(pts_diff.size(), 3);
-  for (int i = 0; i < pts_diff.size(); ++i) {
-    coeff_t(i, 0) = pts_diff[i].y;
-    coeff_t(i, 1) = -pts_diff[i].x;
-    coeff_t(i, 2) = pts1_undistorted[i].x*pts2_undistorted[i].y -
-      pts1_undistorted[i].y*pts2_undistorted[i].x;
-  }
-
+  // Only the raw inliers are kept. The three columns correspond to
+  // tx, ty, and tz respectively, and are stored one after another,
+  // so that the errors of a model are computed with vector
+  // instructions.
   vector<int> raw_inlier_idx;
   for (int i = 0; i < inlier_markers.size(); ++i) {
     if (inlier_markers[i] != 0)
       raw_inlier_idx.push_back(i);
   }
+  const int raw_inlier_num = raw_inlier_idx.size();
+
+  Matrix<double, Dynamic, 3> coeff_t(raw_inlier_num, 3);
+  for (int i = 0; i < raw_inlier_num; ++i) {
+    const int idx = raw_inlier_idx[i];
+    coeff_t(i, 0) = pts_diff[idx].y;
+    coeff_t(i, 1) = -pts_diff[idx].x;
+    coeff_t(i, 2) = pts1_undistorted[idx].x*pts2_undistorted[idx].y -
+      pts1_undistorted[idx].y*pts2_undistorted[idx].x;
+  }
+
+  // A model needs at least 20% of all the points as inliers,
+  // otherwise it is probably wrong.
+  const int min_inlier_num = static_cast<int>(ceil(0.2*pts1.size()));
+  const double max_error = inlier_error*norm_pixel_unit;
+  const int block_size = 64;
 
-  vector<int> best_inlier_set;
-  double best_error = 1e10;
-  random_numbers::RandomNumberGenerator random_gen;
+  Vector3d best_model(0.0, 0.0, 0.0);
+  int best_inlier_num = 0;
+  // Seeded so that the inliers only depend on the input.
+  random_numbers::RandomNumberGenerator random_gen(0);
 
   for (int iter_idx = 0; iter_idx < iter_num; ++iter_idx) {
     // Randomly select two point pairs.
     // Although this is a weird way of selecting two pairs, but it
     // is able to efficiently avoid selecting repetitive pairs.
     int select_idx1 = random_gen.uniformInteger(
-        0, raw_inlier_idx.size()-1);
+        0, raw_inlier_num-1);
     int select_idx_diff = random_gen.uniformInteger(
-        1, raw_inlier_idx.size()-1);
-    int select_idx2 = select_idx1+select_idx_diff<raw_inlier_idx.size() ?
+        1, raw_inlier_num-1);
+    int select_idx2 = select_idx1+select_idx_diff<raw_inlier_num ?
       select_idx1+select_idx_diff :
-      select_idx1+select_idx_diff-raw_inlier_idx.size();
-
-    int pair_idx1 = raw_inlier_idx[select_idx1];
-    int pair_idx2 = raw_inlier_idx[select_idx2];
+      select_idx1+select_idx_diff-raw_inlier_num;
 
     // Construct the model;
-    Vector2d coeff_tx(coeff_t(pair_idx1, 0), coeff_t(pair_idx2, 0));
-    Vector2d coeff_ty(coeff_t(pair_idx1, 1), coeff_t(pair_idx2, 1));
-    Vector2d coeff_tz(coeff_t(pair_idx1, 2), coeff_t(pair_idx2, 2));
+    Vector2d coeff_tx(coeff_t(select_idx1, 0), coeff_t(select_idx2, 0));
+    Vector2d coeff_ty(coeff_t(select_idx1, 1), coeff_t(select_idx2, 1));
+    Vector2d coeff_tz(coeff_t(select_idx1, 2), coeff_t(select_idx2, 2));
     vector<double> coeff_l1_norm(3);
     coeff_l1_norm[0] = coeff_tx.lpNorm<1>();
     coeff_l1_norm[1] = coeff_ty.lpNorm<1>();
@@ -1212,112 +1344,82 @@ void ImageProcessor::twoPointRansac(
       model(2) = 1.0;
     }
 
-    // Find all the inliers among point pairs.
-    VectorXd error = coeff_t * model;
-
-    vector<int> inlier_set;
-    for (int i = 0; i < error.rows(); ++i) {
-      if (inlier_markers[i] == 0) continue;
-      if (std::abs(error(i)) < inlier_error*norm_pixel_unit)
-        inlier_set.push_back(i);
-    }
-
-    // If the number of inliers is small, the current
-    // model is probably wrong.
-    if (inlier_set.size() < 0.2*pts1_undistorted.size())
-      continue;
-
-    // Refit the model using all of the possible inliers.
-    VectorXd coeff_tx_better(inlier_set.size());
-    VectorXd coeff_ty_better(inlier_set.size());
-    VectorXd coeff_tz_better(inlier_set.size());
-    for (int i = 0; i < inlier_set.size(); ++i) {
-      coeff_tx_better(i) = coeff_t(inlier_set[i], 0);
-      coeff_ty_better(i) = coeff_t(inlier_set[i], 1);
-      coeff_tz_better(i) = coeff_t(inlier_set[i], 2);
-    }
-
-    Vector3d model_better(0.0, 0.0, 0.0);
-    if (base_indicator == 0) {
-      MatrixXd A(inlier_set.size(), 2);
-      A << coeff_ty_better, coeff_tz_better;
-      Vector2d solution =
-          (A.transpose() * A).inverse() * A.transpose() * (-coeff_tx_better);
-      model_better(0) = 1.0;
-      model_better(1) = solution(0);
-      model_better(2) = solution(1);
-    } else if (base_indicator ==1) {
-      MatrixXd A(inlier_set.size(), 2);
-      A << coeff_tx_better, coeff_tz_better;
-      Vector2d solution =
-          (A.transpose() * A).inverse() * A.transpose() * (-coeff_ty_better);
-      model_better(0) = solution(0);
-      model_better(1) = 1.0;
-      model_better(2) = solution(1);
-    } else {
-      MatrixXd A(inlier_set.size(), 2);
-      A << coeff_tx_better, coeff_ty_better;
-      Vector2d solution =
-          (A.transpose() * A).inverse() * A.transpose() * (-coeff_tz_better);
-      model_better(0) = solution(0);
-      model_better(1) = solution(1);
-      model_better(2) = 1.0;
-    }
-
-    // Compute the error and upate the best model if possible.
-    VectorXd new_error = coeff_t * model_better;
-
-    double this_error = 0.0;
-    for (const auto& inlier_idx : inlier_set)
-      this_error += std::abs(new_error(inlier_idx));
-    this_error /= inlier_set.size();
-
-    if (inlier_set.size() > best_inlier_set.size()) {
-      best_error = this_error;
-      best_inlier_set = inlier_set;
+    // Count the inliers block by block. The model is dropped as
+    // soon as it cannot beat the best model even if all of the
+    // remaining points are inliers, which does not change the
+    // result of the RANSAC.
+    const int required_inlier_num =
+      std::max(min_inlier_num, best_inlier_num+1);
+    int inlier_num = 0;
+    for (int start = 0; start < raw_inlier_num &&
+        inlier_num+raw_inlier_num-start >= required_inlier_num;
+        start += block_size) {
+      const int rows = std::min(block_size, raw_inlier_num-start);
+      inlier_num += ((
+          coeff_t.col(0).segment(start, rows)*model(0) +
+          coeff_t.col(1).segment(start, rows)*model(1) +
+          coeff_t.col(2).segment(start, rows)*model(2)
+          ).array().abs() < max_error).count();
     }
+    if (inlier_num < required_inlier_num) continue;
+
+    best_model = model;
+    best_inlier_num = inlier_num;
+
+    // Stop once the number of iterations is enough for the
+    // inlier ratio of the best model.
+    if (!adaptive_termination) continue;
+    const double inlier_ratio =
+      static_cast<double>(inlier_num) / raw_inlier_num;
+    if (inlier_ratio >= 1.0) break;
+    iter_num = std::min(iter_num, static_cast<int>(ceil(
+            log(1-success_probability) /
+            log(1-inlier_ratio*inlier_ratio))));
   }
 
   // Fill in the markers.
   inlier_markers.clear();
   inlier_markers.resize(pts1.size(), 0);
-  for (const auto& inlier_idx : best_inlier_set)
-    inlier_markers[inlier_idx] = 1;
+  if (best_inlier_num == 0) return;
+
+  const ArrayXd best_error = (
+      coeff_t.col(0)*best_model(0) +
+      coeff_t.col(1)*best_model(1) +
+      coeff_t.col(2)*best_model(2)).array().abs();
+  for (int i = 0; i < raw_inlier_num; ++i) {
+    if (best_error(i) < max_error)
+      inlier_markers[raw_inlier_idx[i]] = 1;
+  }
 
-  //printf("inlier ratio: %lu/%lu\n",
-  //    best_inlier_set.size(), inlier_markers.size());
+  //printf("inlier ratio: %d/%lu\n",
+  //    best_inlier_num, inlier_markers.size());
 
   return;
 }
 
 void ImageProcessor::publish() {
+  ScopedTrace trace("image_processor/publish");
 
   // Publish features.
   CameraMeasurementPtr feature_msg_ptr(new CameraMeasurement);
   feature_msg_ptr->header.stamp = cam0_curr_img_ptr->header.stamp;
 
+  // The points were undistorted when they were matched
+  // in the stereo images.
   vector<FeatureIDType> curr_ids(0);
-  vector<Point2f> curr_cam0_points(0);
-  vector<Point2f> curr_cam1_points(0);
+  vector<Point2f> curr_cam0_points_undistorted(0);
+  vector<Point2f> curr_cam1_points_undistorted(0);
 
   for (const auto& grid_features : (*curr_features_ptr)) {
     for (const auto& feature : grid_features.second) {
       curr_ids.push_back(feature.id);
-      curr_cam0_points.push_back(feature.cam0_point);
-      curr_cam1_points.push_back(feature.cam1_point);
+      curr_cam0_points_undistorted.push_back(
+          feature.cam0_point_undistorted);
+      curr_cam1_points_undistorted.push_back(
+          feature.cam1_point_undistorted);
     }
   }
 
-  vector<Point2f> curr_cam0_points_undistorted(0);
-  vector<Point2f> curr_cam1_points_undistorted(0);
-
-  undistortPoints(
-      curr_cam0_points, cam0_intrinsics, cam0_distortion_model,
-      cam0_distortion_coeffs, curr_cam0_points_undistorted);
-  undistortPoints(
-      curr_cam1_points, cam1_intrinsics, cam1_distortion_model,
-      cam1_distortion_coeffs, curr_cam1_points_undistorted);
-
   // 发送消息，存放id和点的位置
   // 遍历curr_ids数组
   // 使用 feature_msg_ptr 创建 FeatureMeasurement 对象，添加到features数组中
@@ -1335,6 +1437,8 @@ void ImageProcessor::publish() {
    
   }
 
+  if (feature_callback) feature_callback(feature_msg_ptr);
+  if (!nh) return;
   cam0_img_pub.publish(cam0_color_img_ptr);
   feature_pub.publish(feature_msg_ptr);
   
@@ -1351,13 +1455,14 @@ void ImageProcessor::publish() {
 }
 
 void ImageProcessor::drawFeaturesMono() {
+  ScopedTrace trace("image_processor/drawFeaturesMono");
   // Colors for different features.
   Scalar tracked(0, 255, 0);
   Scalar new_feature(0, 255, 0);
 
-  static int grid_height =
+  const int grid_height =
     cam0_curr_img_ptr->image.rows / processor_config.grid_row;
-  static int grid_width =
+  const int grid_width =
     cam0_curr_img_ptr->image.cols / processor_config.grid_col;
 
   // Create an output image.
@@ -1428,9 +1533,9 @@ void ImageProcessor::drawFeaturesStereo() {
     Scalar tracked(0, 255, 0);
     Scalar new_feature(0, 255, 0);
 
-    static int grid_height =
+    const int grid_height =
       cam0_curr_img_ptr->image.rows / processor_config.grid_row;
-    static int grid_width =
+    const int grid_width =
       cam0_curr_img_ptr->image.cols / processor_config.grid_col;
 
     // Create an output image.
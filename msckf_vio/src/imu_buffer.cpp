@@ -0,0 +1,146 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <limits>
+#include <boost/weak_ptr.hpp>
+#include <msckf_vio/imu_buffer.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+ImuBuffer::ImuBuffer(const int& capacity):
+  mask(0),
+  head(0),
+  producer(nullptr),
+  last_time(-numeric_limits<double>::infinity()) {
+  SeqType size = 1;
+  while (size < static_cast<SeqType>(max(capacity, 1))) size <<= 1;
+  mask = size - 1;
+
+  slots.reset(new Slot[size]);
+  for (SeqType i = 0; i < size; ++i) {
+    slots[i].version.store(0, memory_order_relaxed);
+    for (auto& d : slots[i].data) d.store(0.0, memory_order_relaxed);
+  }
+  return;
+}
+
+ImuBuffer::Ptr ImuBuffer::getShared(const string& name,
+    const int& capacity) {
+  // The buffer is released once all its users are gone.
+  static mutex registry_mutex;
+  static map<string, boost::weak_ptr<ImuBuffer> > registry;
+
+  lock_guard<mutex> lock(registry_mutex);
+  Ptr buffer = registry[name].lock();
+  if (!buffer) {
+    buffer.reset(new ImuBuffer(capacity));
+    registry[name] = buffer;
+  }
+  return buffer;
+}
+
+int ImuBuffer::requiredCapacity(const double& imu_rate,
+    const double& max_delay) {
+  // One more sample for the one being written.
+  return static_cast<int>(ceil(max(imu_rate*max_delay, 0.0))) + 1;
+}
+
+bool ImuBuffer::claimProducer(const void* owner) {
+  const void* expected = nullptr;
+  producer.compare_exchange_strong(expected, owner, memory_order_acq_rel);
+  return producer.load(memory_order_acquire) == owner;
+}
+
+void ImuBuffer::releaseProducer(const void* owner) {
+  const void* expected = owner;
+  producer.compare_exchange_strong(expected, nullptr, memory_order_acq_rel);
+  return;
+}
+
+bool ImuBuffer::push(const ImuSample& sample) {
+  if (sample.time <= last_time) return false;
+  last_time = sample.time;
+
+  const SeqType seq = head.load(memory_order_relaxed);
+  Slot& slot = slots[seq & mask];
+
+  // Mark the slot as being written before changing the data.
+  slot.version.store(2*seq+1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  slot.data[0].store(sample.time, memory_order_relaxed);
+  for (int i = 0; i < 3; ++i) {
+    slot.data[1+i].store(sample.angular_velocity(i), memory_order_relaxed);
+    slot.data[4+i].store(sample.linear_acceleration(i), memory_order_relaxed);
+  }
+
+  slot.version.store(2*seq+2, memory_order_release);
+  head.store(seq+1, memory_order_release);
+  return true;
+}
+
+ImuBuffer::SeqType ImuBuffer::begin() const {
+  const SeqType seq = head.load(memory_order_acquire);
+  return seq > mask ? seq-mask-1 : 0;
+}
+
+ImuBuffer::SeqType ImuBuffer::end() const {
+  return head.load(memory_order_acquire);
+}
+
+bool ImuBuffer::get(const SeqType& seq, ImuSample& sample) const {
+  if (seq >= head.load(memory_order_acquire)) return false;
+
+  const Slot& slot = slots[seq & mask];
+  const SeqType version = slot.version.load(memory_order_acquire);
+  if (version != 2*seq+2) return false;
+
+  sample.time = slot.data[0].load(memory_order_relaxed);
+  for (int i = 0; i < 3; ++i) {
+    sample.angular_velocity(i) = slot.data[1+i].load(memory_order_relaxed);
+    sample.linear_acceleration(i) = slot.data[4+i].load(memory_order_relaxed);
+  }
+
+  // The sample is valid if the slot was not rewritten meanwhile.
+  atomic_thread_fence(memory_order_acquire);
+  return slot.version.load(memory_order_relaxed) == version;
+}
+
+template <typename Predicate>
+ImuBuffer::SeqType ImuBuffer::partitionPoint(
+    const SeqType& first, const Predicate& is_after) const {
+  SeqType low = max(first, begin());
+  SeqType high = end();
+  ImuSample sample;
+
+  while (low < high) {
+    const SeqType mid = low + (high-low)/2;
+    if (get(mid, sample) && is_after(sample.time)) high = mid;
+    else low = mid + 1;
+  }
+  return low;
+}
+
+ImuBuffer::SeqType ImuBuffer::lowerBound(
+    const double& time, const SeqType& first) const {
+  return partitionPoint(first,
+      [&time](const double& t) { return t >= time; });
+}
+
+ImuBuffer::SeqType ImuBuffer::upperBound(
+    const double& time, const SeqType& first) const {
+  return partitionPoint(first,
+      [&time](const double& t) { return t > time; });
+}
+
+} // namespace msckf_vio
@@ -0,0 +1,80 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <vector>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include <msckf_vio/latency_diagnostics.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+bool LatencyDiagnostics::initialize(
+    ros::NodeHandle& nh, const string& prefix) {
+  this->prefix = prefix;
+
+  bool latency_tracing;
+  string latency_trace_file;
+  double latency_diagnostics_period;
+  nh.param<bool>("latency_tracing", latency_tracing, false);
+  nh.param<string>("latency_trace_file", latency_trace_file, "");
+  nh.param<double>("latency_diagnostics_period",
+      latency_diagnostics_period, 1.0);
+
+  ROS_INFO("latency tracing: %d", latency_tracing);
+  if (!latency_tracing) return true;
+  ROS_INFO("latency trace file: %s", latency_trace_file.c_str());
+  ROS_INFO("latency diagnostics period: %f", latency_diagnostics_period);
+
+  if (!LatencyTracer::instance().enable(latency_trace_file))
+    ROS_WARN("Cannot write latency trace to %s", latency_trace_file.c_str());
+
+  latency_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("latency", 1);
+  if (latency_diagnostics_period > 0.0)
+    timer = nh.createTimer(ros::Duration(latency_diagnostics_period),
+        &LatencyDiagnostics::timerCallback, this);
+  return true;
+}
+
+void LatencyDiagnostics::timerCallback(const ros::TimerEvent& event) {
+  if (latency_pub.getNumSubscribers() == 0) return;
+
+  vector<StageStatistics> stats;
+  LatencyTracer::instance().statistics(prefix, stats);
+
+  // One status per stage with the latency in milliseconds.
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  for (const auto& stage : stats) {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = stage.name;
+    status.message = "latency in ms";
+
+    const pair<const char*, double> values[] = {
+      {"p50", stage.p50}, {"p95", stage.p95},
+      {"p99", stage.p99}, {"max", stage.max}};
+    for (const auto& value : values) {
+      diagnostic_msgs::KeyValue key_value;
+      key_value.key = value.first;
+      key_value.value = to_string(value.second);
+      status.values.push_back(key_value);
+    }
+    diagnostic_msgs::KeyValue count;
+    count.key = "count";
+    count.value = to_string(stage.count);
+    status.values.push_back(count);
+
+    msg.status.push_back(status);
+  }
+
+  latency_pub.publish(msg);
+  return;
+}
+
+} // namespace msckf_vio
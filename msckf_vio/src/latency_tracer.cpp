@@ -0,0 +1,193 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <unistd.h>
+
+#include <msckf_vio/latency_tracer.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+const int LatencyTracer::window_size;
+
+LatencyTracer& LatencyTracer::instance() {
+  static LatencyTracer tracer;
+  return tracer;
+}
+
+LatencyTracer::LatencyTracer():
+  is_enabled(false),
+  dropped_num(0),
+  trace(nullptr),
+  is_first_event(true),
+  stop(false) {
+  return;
+}
+
+LatencyTracer::~LatencyTracer() {
+  is_enabled = false;
+  {
+    lock_guard<mutex> lock(collect_mutex);
+    stop = true;
+  }
+  stop_cond.notify_one();
+  if (collector.joinable()) collector.join();
+
+  lock_guard<mutex> lock(collect_mutex);
+  collect();
+  if (trace) {
+    fprintf(trace, "\n]\n");
+    fclose(trace);
+  }
+  return;
+}
+
+int64_t LatencyTracer::now() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool LatencyTracer::enable(const string& trace_file) {
+  lock_guard<mutex> lock(collect_mutex);
+  if (!collector.joinable())
+    collector = thread(&LatencyTracer::collectorLoop, this);
+  is_enabled = true;
+
+  if (trace_file.empty()) return true;
+  if (trace) return trace_file == this->trace_file;
+
+  trace = fopen(trace_file.c_str(), "w");
+  if (!trace) return false;
+  this->trace_file = trace_file;
+
+  // The closing bracket is optional in the array format, so the
+  // file can still be loaded if the process is killed.
+  fprintf(trace, "[\n");
+  return true;
+}
+
+LatencyTracer::ThreadBuffer* LatencyTracer::threadBuffer() {
+  // There is only one tracer, so each thread has one buffer,
+  // which is given back when the thread exits. The events left
+  // in it are still collected.
+  struct BufferHolder {
+    ThreadBuffer* buffer;
+    BufferHolder(): buffer(nullptr) {}
+    ~BufferHolder() {
+      if (!buffer) return;
+      LatencyTracer& tracer = instance();
+      lock_guard<mutex> lock(tracer.buffer_mutex);
+      buffer->is_free = true;
+    }
+  };
+  static thread_local BufferHolder holder;
+  if (holder.buffer) return holder.buffer;
+
+  lock_guard<mutex> lock(buffer_mutex);
+  for (const auto& buffer : buffers) {
+    if (!buffer->is_free) continue;
+    buffer->is_free = false;
+    holder.buffer = buffer.get();
+    return holder.buffer;
+  }
+  buffers.emplace_back(new ThreadBuffer(buffers.size()));
+  holder.buffer = buffers.back().get();
+  return holder.buffer;
+}
+
+int LatencyTracer::threadBufferNum() {
+  lock_guard<mutex> lock(buffer_mutex);
+  return buffers.size();
+}
+
+void LatencyTracer::record(const char* name,
+    const int64_t& start, const int64_t& duration) {
+  TraceEvent event;
+  event.name = name;
+  event.start = start;
+  event.duration = duration;
+  if (!threadBuffer()->events.push(event)) ++dropped_num;
+  return;
+}
+
+void LatencyTracer::collectorLoop() {
+  unique_lock<mutex> lock(collect_mutex);
+  while (!stop) {
+    stop_cond.wait_for(lock, chrono::milliseconds(100));
+    collect();
+    if (trace) fflush(trace);
+  }
+  return;
+}
+
+void LatencyTracer::collect() {
+  lock_guard<mutex> lock(buffer_mutex);
+  TraceEvent event;
+  for (const auto& buffer : buffers) {
+    while (buffer->events.pop(event)) {
+      StageWindow& window = windows[event.name];
+      if (window.durations.size() < window_size)
+        window.durations.push_back(1e-6 * event.duration);
+      else
+        window.durations[window.next] = 1e-6 * event.duration;
+      window.next = (window.next+1) % window_size;
+      ++window.count;
+
+      if (trace) writeEvent(event, buffer->thread_id);
+    }
+  }
+  return;
+}
+
+void LatencyTracer::writeEvent(
+    const TraceEvent& event, const int& thread_id) {
+  // Time stamps are in microseconds.
+  fprintf(trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+      "\"ts\":%.3f,\"dur\":%.3f}", is_first_event ? "" : ",\n",
+      event.name, static_cast<int>(getpid()), thread_id,
+      1e-3*event.start, 1e-3*event.duration);
+  is_first_event = false;
+  return;
+}
+
+void LatencyTracer::statistics(const string& prefix,
+    vector<StageStatistics>& stats) {
+  stats.clear();
+
+  lock_guard<mutex> lock(collect_mutex);
+  collect();
+
+  vector<double> durations;
+  for (const auto& item : windows) {
+    if (item.first.compare(0, prefix.size(), prefix) != 0) continue;
+    durations = item.second.durations;
+    const int n = durations.size();
+
+    // Nearest-rank percentiles.
+    auto percentile = [&](const double& p) {
+      const int k = min(max(static_cast<int>(ceil(p*n))-1, 0), n-1);
+      nth_element(durations.begin(), durations.begin()+k, durations.end());
+      return durations[k];
+    };
+
+    StageStatistics stage;
+    stage.name = item.first;
+    stage.count = item.second.count;
+    stage.p50 = percentile(0.5);
+    stage.p95 = percentile(0.95);
+    stage.p99 = percentile(0.99);
+    stage.max = *max_element(durations.begin(), durations.end());
+    stats.push_back(stage);
+  }
+  return;
+}
+
+} // namespace msckf_vio
@@ -13,26 +13,24 @@
 #include <cmath>
 #include <iterator>
 #include <algorithm>
+#include <limits>
 
 #include <Eigen/SVD>
 #include <Eigen/QR>
-#include <Eigen/SparseCore>
-#include <Eigen/SPQRSupport>
 #include <boost/math/distributions/chi_squared.hpp>
 
 #include <eigen_conversions/eigen_msg.h>
 #include <tf_conversions/tf_eigen.h>
 #include <sensor_msgs/PointCloud2.h>
-#include <pcl_ros/point_cloud.h>
-#include <pcl/point_types.h>
 
 #include <msckf_vio/msckf_vio.h>
 #include <msckf_vio/math_utils.hpp>
+#include <msckf_vio/imu_state_transition.hpp>
+#include <msckf_vio/measurement_compression.hpp>
 #include <msckf_vio/utils.h>
 
 //----codes for SFM---------
 #include <nav_msgs/Path.h>
-#include <fstream>
 #define SFM 1
 //-------------------------
 
@@ -40,110 +38,142 @@ using namespace std;
 using namespace Eigen;
 
 namespace msckf_vio{
-// Static member variables in IMUState class.
-StateIDType IMUState::next_id = 0;
-double IMUState::gyro_noise = 0.001;
-double IMUState::acc_noise = 0.01;
-double IMUState::gyro_bias_noise = 0.001;
-double IMUState::acc_bias_noise = 0.01;
-Vector3d IMUState::gravity = Vector3d(0, 0, -GRAVITY_ACCELERATION);
-Isometry3d IMUState::T_imu_body = Isometry3d::Identity();
 
-// Static member variables in CAMState class.
-Isometry3d CAMState::T_cam0_cam1 = Isometry3d::Identity();
+namespace {
 
-// Static member variables in Feature class.
-FeatureIDType Feature::next_id = 0;
-double Feature::observation_noise = 0.01;
-Feature::OptimizationConfig Feature::optimization_config;
-
-map<int, double> MsckfVio::chi_squared_test_table;
+template <typename Scalar>
+SquareRootCovarianceBase::Ptr createSquareRootCovariance(
+    const int& imu_state_size) {
+  if (imu_state_size == IMU_CORE_STATE_SIZE)
+    return SquareRootCovarianceBase::Ptr(
+        new SquareRootCovariance<Scalar, IMU_CORE_STATE_SIZE>());
+  return SquareRootCovarianceBase::Ptr(
+      new SquareRootCovariance<Scalar, IMU_STATE_SIZE>());
+}
 
-//----codes for tarjectory---------
-nav_msgs::Path vio_path;
+} // namespace
 
 MsckfVio::MsckfVio(ros::NodeHandle& pnh):
+  next_state_id(0),
+  imu_state_size(IMU_STATE_SIZE),
+  publish_imu_rate_odom(false),
+  is_imu_rate_state_valid(false),
+  imu_rate_gyro(Vector3d::Zero()),
+  is_gravity_set(false),
+  is_first_img(true),
+  online_reset_counter(0),
+  nh(new ros::NodeHandle(pnh)),
+  path_pose_count(0),
+  first_mocap_odom_msg(true) {
+  return;
+}
+
+MsckfVio::MsckfVio():
+  next_state_id(0),
+  imu_state_size(IMU_STATE_SIZE),
+  publish_imu_rate_odom(false),
+  is_imu_rate_state_valid(false),
+  imu_rate_gyro(Vector3d::Zero()),
   is_gravity_set(false),
   is_first_img(true),
-  nh(pnh) {
+  online_reset_counter(0),
+  path_pose_count(0),
+  first_mocap_odom_msg(true) {
   return;
 }
 
-bool MsckfVio::loadParameters() {
+bool MsckfVio::loadParameters(const ParameterReader& params) {
   // Frame id
-  nh.param<string>("fixed_frame_id", fixed_frame_id, "world");
-  nh.param<string>("child_frame_id", child_frame_id, "robot");
-  nh.param<bool>("publish_tf", publish_tf, true);
-  nh.param<double>("frame_rate", frame_rate, 40.0);
-  nh.param<double>("position_std_threshold", position_std_threshold, 8.0);
+  params.param<string>("fixed_frame_id", fixed_frame_id, "world");
+  params.param<string>("child_frame_id", child_frame_id, "robot");
+  params.param<bool>("publish_tf", publish_tf, true);
+  params.param<double>("frame_rate", frame_rate, 40.0);
+  params.param<double>("feature_cloud_rate", feature_cloud_rate, 0.0);
+  params.param<double>("position_std_threshold", position_std_threshold, 8.0);
 
-  nh.param<double>("rotation_threshold", rotation_threshold, 0.2618);
-  nh.param<double>("translation_threshold", translation_threshold, 0.4);
-  nh.param<double>("tracking_rate_threshold", tracking_rate_threshold, 0.5);
+  params.param<double>("rotation_threshold", rotation_threshold, 0.2618);
+  params.param<double>("translation_threshold", translation_threshold, 0.4);
+  params.param<double>("tracking_rate_threshold", tracking_rate_threshold, 0.5);
 
   // Feature optimization parameters
-  nh.param<double>("feature/config/translation_threshold",
-      Feature::optimization_config.translation_threshold, 0.2);
+  params.param<double>("feature/config/translation_threshold",
+      optimization_config.translation_threshold, 0.2);
 
   // Noise related parameters
-  nh.param<double>("noise/gyro", IMUState::gyro_noise, 0.001);
-  nh.param<double>("noise/acc", IMUState::acc_noise, 0.01);
-  nh.param<double>("noise/gyro_bias", IMUState::gyro_bias_noise, 0.001);
-  nh.param<double>("noise/acc_bias", IMUState::acc_bias_noise, 0.01);
-  nh.param<double>("noise/feature", Feature::observation_noise, 0.01);
+  params.param<double>("noise/gyro", sensor_config.gyro_noise, 0.001);
+  params.param<double>("noise/acc", sensor_config.acc_noise, 0.01);
+  params.param<double>("noise/gyro_bias", sensor_config.gyro_bias_noise, 0.001);
+  params.param<double>("noise/acc_bias", sensor_config.acc_bias_noise, 0.01);
+  params.param<double>("noise/feature", sensor_config.observation_noise, 0.01);
 
   // Use variance instead of standard deviation. --squared value
-  IMUState::gyro_noise *= IMUState::gyro_noise;
-  IMUState::acc_noise *= IMUState::acc_noise;
-  IMUState::gyro_bias_noise *= IMUState::gyro_bias_noise;
-  IMUState::acc_bias_noise *= IMUState::acc_bias_noise;
-  Feature::observation_noise *= Feature::observation_noise;
+  sensor_config.gyro_noise *= sensor_config.gyro_noise;
+  sensor_config.acc_noise *= sensor_config.acc_noise;
+  sensor_config.gyro_bias_noise *= sensor_config.gyro_bias_noise;
+  sensor_config.acc_bias_noise *= sensor_config.acc_bias_noise;
+  sensor_config.observation_noise *= sensor_config.observation_noise;
 
   // Set the initial IMU state.
   // The intial orientation and position will be set to the origin
   // implicitly. But the initial velocity and bias can be
   // set by parameters.
   // TODO: is it reasonable to set the initial bias to 0?
-  nh.param<double>("initial_state/velocity/x",
+  params.param<double>("initial_state/velocity/x",
       state_server.imu_state.velocity(0), 0.0);
-  nh.param<double>("initial_state/velocity/y",
+  params.param<double>("initial_state/velocity/y",
       state_server.imu_state.velocity(1), 0.0);
-  nh.param<double>("initial_state/velocity/z",
+  params.param<double>("initial_state/velocity/z",
       state_server.imu_state.velocity(2), 0.0);
 
   // The initial covariance of orientation and position can be
   // set to 0. But for velocity, bias and extrinsic parameters,
   // there should be nontrivial uncertainty.
-  double gyro_bias_cov, acc_bias_cov, velocity_cov;
-  nh.param<double>("initial_covariance/velocity",
+  params.param<double>("initial_covariance/velocity",
       velocity_cov, 0.25);
-  nh.param<double>("initial_covariance/gyro_bias",
+  params.param<double>("initial_covariance/gyro_bias",
       gyro_bias_cov, 1e-4);
-  nh.param<double>("initial_covariance/acc_bias",
+  params.param<double>("initial_covariance/acc_bias",
       acc_bias_cov, 1e-2);
 
-  double extrinsic_rotation_cov, extrinsic_translation_cov;
-  nh.param<double>("initial_covariance/extrinsic_rotation_cov",
+  params.param<double>("initial_covariance/extrinsic_rotation_cov",
       extrinsic_rotation_cov, 3.0462e-4);
-  nh.param<double>("initial_covariance/extrinsic_translation_cov",
+  params.param<double>("initial_covariance/extrinsic_translation_cov",
       extrinsic_translation_cov, 1e-4);
 
+  // The extrinsics can be left out of the state for calibrated
+  // rigs, which shrinks all the products with the covariance.
+  bool estimate_extrinsics;
+  params.param<bool>("estimate_extrinsics", estimate_extrinsics, true);
+  imu_state_size = estimate_extrinsics ?
+    IMU_STATE_SIZE : IMU_CORE_STATE_SIZE;
+
+  // Representation of the state covariance. "square_root"
+  // and "square_root_float" keep an upper triangular factor of
+  // the covariance in double or single precision.
+  string covariance_backend;
+  params.param<string>("covariance_backend", covariance_backend, "dense");
+  if (covariance_backend == "square_root") {
+    state_server.state_cov_factor = createSquareRootCovariance<double>(
+        imu_state_size);
+  } else if (covariance_backend == "square_root_float") {
+    state_server.state_cov_factor = createSquareRootCovariance<float>(
+        imu_state_size);
+  } else if (covariance_backend != "dense") {
+    ROS_WARN("Unknown covariance backend %s, use dense instead.",
+        covariance_backend.c_str());
+    covariance_backend = "dense";
+  }
 
-  state_server.state_cov = MatrixXd::Zero(21, 21);
-  for (int i = 3; i < 6; ++i)
-    state_server.state_cov(i, i) = gyro_bias_cov;
-  for (int i = 6; i < 9; ++i)
-    state_server.state_cov(i, i) = velocity_cov;
-  for (int i = 9; i < 12; ++i)
-    state_server.state_cov(i, i) = acc_bias_cov;
-  for (int i = 15; i < 18; ++i)
-    state_server.state_cov(i, i) = extrinsic_rotation_cov;
-  for (int i = 18; i < 21; ++i)
-    state_server.state_cov(i, i) = extrinsic_translation_cov;
+  // Maximum number of camera states to be stored. A slot is
+  // allocated for each of them, and the covariance is kept at
+  // the size of all the slots.
+  params.param<int>("max_cam_state_size", max_cam_state_size, 30);
+  state_server.cam_states.reserve(max_cam_state_size);
+  resetStateCovariance();
 
   // Transformation offsets between the frames involved.
-  Isometry3d T_imu_cam0 = utils::getTransformEigen(nh, "cam0/T_cam_imu");
-  Isometry3d T_imu_cam1 = utils::getTransformEigen(nh, "cam1/T_cam_imu");
+  Isometry3d T_imu_cam0 = utils::getTransformEigen(params, "cam0/T_cam_imu");
+  Isometry3d T_imu_cam1 = utils::getTransformEigen(params, "cam1/T_cam_imu");
   Isometry3d T_cam0_imu = T_imu_cam0.inverse();
   Isometry3d T_cam1_imu = T_imu_cam1.inverse();
 
@@ -164,31 +194,82 @@ bool MsckfVio::loadParameters() {
 
   state_server.imu_state.R_imu_cam0 = T_cam0_imu.linear().transpose();
   state_server.imu_state.t_cam0_imu = T_cam0_imu.translation();
-  CAMState::T_cam0_cam1 =
-    utils::getTransformEigen(nh, "cam1/T_cn_cnm1");
+  sensor_config.T_cam0_cam1 =
+    utils::getTransformEigen(params, "cam1/T_cn_cnm1");
     
   // this should be Identity normally, since imu frame is consider as body frame
-  IMUState::T_imu_body =
-    utils::getTransformEigen(nh, "T_imu_body").inverse();
-
-  // Maximum number of camera states to be stored
-  nh.param<int>("max_cam_state_size", max_cam_state_size, 30);
-  
+  sensor_config.T_imu_body =
+    utils::getTransformEigen(params, "T_imu_body").inverse();
+
+  // Number of threads used to compute the feature Jacobians
+  // and to triangulate the features.
+  int jacobian_thread_num;
+  params.param<int>("jacobian_thread_num", jacobian_thread_num, 1);
+  jacobian_pool.reset(new ThreadPool(max(jacobian_thread_num, 1)));
+
+  // The IMU buffer holds the samples received over the
+  // worst-case delay before they are processed.
+  double imu_rate, imu_buffer_duration;
+  params.param<double>("imu_rate", imu_rate, 200.0);
+  params.param<double>("imu_buffer_duration", imu_buffer_duration, 20.0);
+  imu_buffer_capacity = ImuBuffer::requiredCapacity(
+      imu_rate, imu_buffer_duration);
+
+  params.param<bool>("defer_cross_cov_propagation",
+      defer_cross_cov_propagation, false);
+
+  // Publish the latest estimate propagated with every IMU msg.
+  params.param<bool>("publish_imu_rate_odom",
+      publish_imu_rate_odom, false);
+  // Nothing is published without ros io.
+  if (!nh) publish_imu_rate_odom = false;
+
+  // Length of the published path and the number of poses
+  // between two consecutive poses on it. The path is unbounded
+  // only if the length is explicitly set to a non-positive value.
+  params.param<int>("path_max_length", path_max_length, 5000);
+  params.param<int>("path_decimation", path_decimation, 1);
+  path_decimation = max(path_decimation, 1);
+
+  // The trajectory is written to a file in the background
+  // if a path is given.
+  string trajectory_file, trajectory_format;
+  double trajectory_flush_period;
+  int trajectory_max_file_size_mb;
+  params.param<string>("trajectory_file", trajectory_file, "");
+  params.param<string>("trajectory_format", trajectory_format, "tum");
+  params.param<double>("trajectory_flush_period", trajectory_flush_period, 1.0);
+  params.param<int>("trajectory_max_file_size_mb",
+      trajectory_max_file_size_mb, 0);
+
+  TrajectoryLogger::Format format;
+  if (!TrajectoryLogger::parseFormat(trajectory_format, format)) {
+    ROS_ERROR("Unknown trajectory format: %s", trajectory_format.c_str());
+    return false;
+  }
+  if (!trajectory_file.empty()) {
+    trajectory_logger.reset(new TrajectoryLogger(trajectory_file, format,
+          trajectory_flush_period,
+          static_cast<long>(trajectory_max_file_size_mb) << 20));
+    if (!trajectory_logger->isOpen())
+      ROS_WARN("Cannot open trajectory file: %s", trajectory_file.c_str());
+  }
 
   ROS_INFO("===========================================");
   ROS_INFO("fixed frame id: %s", fixed_frame_id.c_str());
   ROS_INFO("child frame id: %s", child_frame_id.c_str());
   ROS_INFO("publish tf: %d", publish_tf);
   ROS_INFO("frame rate: %f", frame_rate);
+  ROS_INFO("feature cloud rate: %f", feature_cloud_rate);
   ROS_INFO("position std threshold: %f", position_std_threshold);
   ROS_INFO("Keyframe rotation threshold: %f", rotation_threshold);
   ROS_INFO("Keyframe translation threshold: %f", translation_threshold);
   ROS_INFO("Keyframe tracking rate threshold: %f", tracking_rate_threshold);
-  ROS_INFO("gyro noise: %.10f", IMUState::gyro_noise);
-  ROS_INFO("gyro bias noise: %.10f", IMUState::gyro_bias_noise);
-  ROS_INFO("acc noise: %.10f", IMUState::acc_noise);
-  ROS_INFO("acc bias noise: %.10f", IMUState::acc_bias_noise);
-  ROS_INFO("observation noise: %.10f", Feature::observation_noise);
+  ROS_INFO("gyro noise: %.10f", sensor_config.gyro_noise);
+  ROS_INFO("gyro bias noise: %.10f", sensor_config.gyro_bias_noise);
+  ROS_INFO("acc noise: %.10f", sensor_config.acc_noise);
+  ROS_INFO("acc bias noise: %.10f", sensor_config.acc_bias_noise);
+  ROS_INFO("observation noise: %.10f", sensor_config.observation_noise);
   ROS_INFO("initial velocity: %f, %f, %f",
       state_server.imu_state.velocity(0),
       state_server.imu_state.velocity(1),
@@ -201,32 +282,60 @@ bool MsckfVio::loadParameters() {
   ROS_INFO("initial extrinsic translation cov: %f",
       extrinsic_translation_cov);
 
+  ROS_INFO("estimate extrinsics: %d", estimate_extrinsics);
   ROS_INFO("max camera state #: %d", max_cam_state_size);
+  ROS_INFO("defer cross covariance propagation: %d",
+      defer_cross_cov_propagation);
+  ROS_INFO("publish imu rate odom: %d", publish_imu_rate_odom);
+  ROS_INFO("path max length: %d", path_max_length);
+  ROS_INFO("path decimation: %d", path_decimation);
+  ROS_INFO("trajectory file: %s", trajectory_file.c_str());
+  ROS_INFO("trajectory format: %s", trajectory_format.c_str());
+  ROS_INFO("trajectory flush period: %f", trajectory_flush_period);
+  ROS_INFO("trajectory max file size (MB): %d", trajectory_max_file_size_mb);
+  ROS_INFO("covariance backend: %s", covariance_backend.c_str());
+  ROS_INFO("jacobian thread #: %d", jacobian_pool->size());
+  ROS_INFO("imu rate: %f", imu_rate);
+  ROS_INFO("imu buffer duration: %f", imu_buffer_duration);
   ROS_INFO("===========================================");
   
   return true;
 }
 
 bool MsckfVio::createRosIO() {
-  odom_pub = nh.advertise<nav_msgs::Odometry>("odom", 10);
-  feature_pub = nh.advertise<sensor_msgs::PointCloud2>("feature_point_cloud", 10);
+  odom_pub = nh->advertise<nav_msgs::Odometry>("odom", 10);
+  if (publish_imu_rate_odom)
+    imu_rate_odom_pub = nh->advertise<nav_msgs::Odometry>("imu_rate_odom", 100);
+  feature_pub = nh->advertise<sensor_msgs::PointCloud2>("feature_point_cloud", 10);
+  feature_cloud.reset(new FeatureCloudPublisher(feature_pub, fixed_frame_id,
+        sensor_config.T_imu_body.linear(), feature_cloud_rate));
 
-  reset_srv = nh.advertiseService("reset", &MsckfVio::resetCallback, this);
+  reset_srv = nh->advertiseService("reset", &MsckfVio::resetCallback, this);
 
-  imu_sub = nh.subscribe("imu", 100, &MsckfVio::imuCallback, this);
-  feature_sub = nh.subscribe("features_", 40, &MsckfVio::featureCallback, this);
+  imu_sub = nh->subscribe("imu", 100, &MsckfVio::imuCallback, this);
+  feature_sub = nh->subscribe("features_", 40, &MsckfVio::featureCallback, this);
   
-  mocap_odom_sub = nh.subscribe("mocap_odom", 10, &MsckfVio::mocapOdomCallback, this);
-  mocap_odom_pub = nh.advertise<nav_msgs::Odometry>("gt_odom", 1);
+  mocap_odom_sub = nh->subscribe("mocap_odom", 10, &MsckfVio::mocapOdomCallback, this);
+  mocap_odom_pub = nh->advertise<nav_msgs::Odometry>("gt_odom", 1);
+  tf_pub.reset(new tf::TransformBroadcaster());
 
   //-------code for tarjectory--------
-  pub_vio_path = nh.advertise<nav_msgs::Path>("vio_path", 1000);
+  pub_vio_path = nh->advertise<nav_msgs::Path>("vio_path", 1000);
+  pub_vio_pose = nh->advertise<geometry_msgs::PoseStamped>("vio_pose", 100);
+
+  latency_diagnostics.initialize(*nh, "msckf_vio/");
 
   return true;
 }
 
 bool MsckfVio::initialize() {
-  if (!loadParameters()) return false;
+  if (!nh) return false;
+  return initialize(ParameterReader(*nh));
+}
+
+bool MsckfVio::initialize(const ParameterReader& params,
+    const ImuBuffer::Ptr& shared_imu_buffer) {
+  if (!loadParameters(params)) return false;
   ROS_INFO("Finish loading ROS parameters...");
   
  
@@ -234,13 +343,13 @@ bool MsckfVio::initialize() {
     
   // diagonal matrix, directly multiply
   state_server.continuous_noise_cov.block<3, 3>(0, 0) =
-    Matrix3d::Identity()*IMUState::gyro_noise;
+    Matrix3d::Identity()*sensor_config.gyro_noise;
   state_server.continuous_noise_cov.block<3, 3>(3, 3) =
-    Matrix3d::Identity()*IMUState::gyro_bias_noise;
+    Matrix3d::Identity()*sensor_config.gyro_bias_noise;
   state_server.continuous_noise_cov.block<3, 3>(6, 6) =
-    Matrix3d::Identity()*IMUState::acc_noise;
+    Matrix3d::Identity()*sensor_config.acc_noise;
   state_server.continuous_noise_cov.block<3, 3>(9, 9) =
-    Matrix3d::Identity()*IMUState::acc_bias_noise;
+    Matrix3d::Identity()*sensor_config.acc_bias_noise;
 
 
   for (int i = 1; i < 100; ++i) {
@@ -253,7 +362,24 @@ bool MsckfVio::initialize() {
   initSFM_ = new initial_sfm::InitSFM(ric, tic);
 
 #endif
-  
+
+  // The IMU samples are shared with the image processor if both
+  // run in one process. Without a node handle, only the given
+  // buffer is shared, so that several pipelines in one process
+  // do not read each other's samples.
+  if (shared_imu_buffer)
+    imu_buffer = shared_imu_buffer;
+  else if (nh)
+    imu_buffer = ImuBuffer::getShared(
+        nh->resolveName("imu"), imu_buffer_capacity);
+  else
+    imu_buffer.reset(new ImuBuffer(imu_buffer_capacity));
+  next_imu_seq = imu_buffer->end();
+  if (imu_buffer->capacity() < imu_buffer_capacity)
+    ROS_WARN("Shared IMU buffer holds %d samples, %d required.",
+        imu_buffer->capacity(), imu_buffer_capacity);
+
+  if (!nh) return true;
   if (!createRosIO()) return false;
   ROS_INFO("Finish creating ROS IO...");
 
@@ -265,8 +391,19 @@ void MsckfVio::imuCallback(const sensor_msgs::ImuConstPtr& msg) {
   // IMU msgs are pushed backed into a buffer instead of
   // being processed immediately. The IMU msgs are processed
   // when the next image is available, in which way, we can
-  // easily handle the transfer delay.
-  imu_msg_buffer.push_back(*msg);
+  // easily handle the transfer delay. Only one of the users
+  // of a shared buffer pushes the msgs.
+  ImuSample sample;
+  sample.time = msg->header.stamp.toSec();
+  tf::vectorMsgToEigen(msg->angular_velocity, sample.angular_velocity);
+  tf::vectorMsgToEigen(msg->linear_acceleration, sample.linear_acceleration);
+  if (imu_buffer->claimProducer(this))
+    imu_buffer->push(sample);
+
+  // Forward the latest estimate to the time of this msg.
+  if (publish_imu_rate_odom && is_imu_rate_state_valid &&
+      propagateImuRateState(sample))
+    publishImuRateOdom(msg->header.stamp);
 
 #if SFM    
   if (!is_gravity_set)
@@ -280,8 +417,7 @@ void MsckfVio::imuCallback(const sensor_msgs::ImuConstPtr& msg) {
     
     if (initSFM_->initResult())
     {
-        initializeGravityAndBias();
-        is_gravity_set = true;
+        is_gravity_set = initializeGravityAndBias();
         
         delete initSFM_;
     }
@@ -292,10 +428,9 @@ void MsckfVio::imuCallback(const sensor_msgs::ImuConstPtr& msg) {
 #else
 
   if (!is_gravity_set) {
-    if (imu_msg_buffer.size() < 200) return;
-    //if (imu_msg_buffer.size() < 10) return;
-    initializeGravityAndBias();
-    is_gravity_set = true;
+    if (imu_buffer->end()-max(next_imu_seq, imu_buffer->begin()) < 200) return;
+    //if (imu_buffer->end()-max(next_imu_seq, imu_buffer->begin()) < 10) return;
+    is_gravity_set = initializeGravityAndBias();
   }
     return;
 
@@ -303,7 +438,7 @@ void MsckfVio::imuCallback(const sensor_msgs::ImuConstPtr& msg) {
 
 }
 
-void MsckfVio::initializeGravityAndBias() {
+bool MsckfVio::initializeGravityAndBias() {
 
 #if SFM
   //---- sfm code---------
@@ -327,32 +462,40 @@ void MsckfVio::initializeGravityAndBias() {
   Vector3d sum_angular_vel = Vector3d::Zero();
   Vector3d sum_linear_acc = Vector3d::Zero();
 
-  for (const auto& imu_msg : imu_msg_buffer) {
-    Vector3d angular_vel = Vector3d::Zero();
-    Vector3d linear_acc = Vector3d::Zero();
+  int imu_sample_num = 0;
 
-    tf::vectorMsgToEigen(imu_msg.angular_velocity, angular_vel);
-    tf::vectorMsgToEigen(imu_msg.linear_acceleration, linear_acc);
+  ImuSample sample;
+  const ImuBuffer::SeqType end_seq = imu_buffer->end();
+  for (ImuBuffer::SeqType seq = max(next_imu_seq, imu_buffer->begin());
+      seq < end_seq; ++seq) {
+    if (!imu_buffer->get(seq, sample)) continue;
+    sum_angular_vel += sample.angular_velocity;
+    sum_linear_acc += sample.linear_acceleration;
+    ++imu_sample_num;
+  }
 
-    sum_angular_vel += angular_vel;
-    sum_linear_acc += linear_acc;
+  // All the samples may have been overwritten since they
+  // were counted, in which case wait for more.
+  if (imu_sample_num == 0) {
+    ROS_WARN("No IMU msg left to initialize gravity and bias.");
+    return false;
   }
 
-  state_server.imu_state.gyro_bias = sum_angular_vel / imu_msg_buffer.size();
+  state_server.imu_state.gyro_bias = sum_angular_vel / imu_sample_num;
   cout << "gyro_bias: " << state_server.imu_state.gyro_bias.transpose() << endl;
   
-  //IMUState::gravity =
-  //  -sum_linear_acc / imu_msg_buffer.size();
+  //gravity =
+  //  -sum_linear_acc / imu_sample_num;
 
 
-  Vector3d gravity_imu = sum_linear_acc / imu_msg_buffer.size();
+  Vector3d gravity_imu = sum_linear_acc / imu_sample_num;
   cout << "g_imu: " << gravity_imu.transpose() << endl;
   
   // Initialize the initial orientation, so that the estimation
   // is consistent with the inertial frame.
   double gravity_norm = gravity_imu.norm();
-  IMUState::gravity = Vector3d(0.0, 0.0, -gravity_norm);
-  Quaterniond q0_i_w = Quaterniond::FromTwoVectors(gravity_imu, -IMUState::gravity);
+  sensor_config.gravity = Vector3d(0.0, 0.0, -gravity_norm);
+  Quaterniond q0_i_w = Quaterniond::FromTwoVectors(gravity_imu, -sensor_config.gravity);
   
   // from world to imu
   state_server.imu_state.orientation = rotationToQuaternion(q0_i_w.toRotationMatrix().transpose());
@@ -360,7 +503,7 @@ void MsckfVio::initializeGravityAndBias() {
   
 #endif
 
-  return;
+  return true;
 }
 
 bool MsckfVio::resetCallback(
@@ -389,46 +532,24 @@ bool MsckfVio::resetCallback(
   state_server.cam_states.clear();
 
   // Reset the state covariance.
-  double gyro_bias_cov, acc_bias_cov, velocity_cov;
-  nh.param<double>("initial_covariance/velocity",
-      velocity_cov, 0.25);
-  nh.param<double>("initial_covariance/gyro_bias",
-      gyro_bias_cov, 1e-4);
-  nh.param<double>("initial_covariance/acc_bias",
-      acc_bias_cov, 1e-2);
-
-  double extrinsic_rotation_cov, extrinsic_translation_cov;
-  nh.param<double>("initial_covariance/extrinsic_rotation_cov",
-      extrinsic_rotation_cov, 3.0462e-4);
-  nh.param<double>("initial_covariance/extrinsic_translation_cov",
-      extrinsic_translation_cov, 1e-4);
-
-  state_server.state_cov = MatrixXd::Zero(21, 21);
-  for (int i = 3; i < 6; ++i)
-    state_server.state_cov(i, i) = gyro_bias_cov;
-  for (int i = 6; i < 9; ++i)
-    state_server.state_cov(i, i) = velocity_cov;
-  for (int i = 9; i < 12; ++i)
-    state_server.state_cov(i, i) = acc_bias_cov;
-  for (int i = 15; i < 18; ++i)
-    state_server.state_cov(i, i) = extrinsic_rotation_cov;
-  for (int i = 18; i < 21; ++i)
-    state_server.state_cov(i, i) = extrinsic_translation_cov;
+  resetStateCovariance();
 
   // Clear all exsiting features in the map.
   map_server.clear();
+  if (feature_cloud) feature_cloud->clear();
 
-  // Clear the IMU msg buffer.
-  imu_msg_buffer.clear();
+  // Skip the IMU msgs received so far.
+  next_imu_seq = imu_buffer->end();
 
   // Reset the starting flags.
   is_gravity_set = false;
   is_first_img = true;
+  is_imu_rate_state_valid = false;
 
   // Restart the subscribers.
-  imu_sub = nh.subscribe("imu", 100,
+  imu_sub = nh->subscribe("imu", 100,
       &MsckfVio::imuCallback, this);
-  feature_sub = nh.subscribe("features", 40,
+  feature_sub = nh->subscribe("features", 40,
       &MsckfVio::featureCallback, this);
 
   // TODO: When can the reset fail?
@@ -476,69 +597,38 @@ void MsckfVio::featureCallback(const CameraMeasurementConstPtr& msg)
     state_server.imu_state.time = msg->header.stamp.toSec();
   }
 
-  static double max_processing_time = 0.0;
-  static int critical_time_cntr = 0;
-  double processing_start_time = ros::Time::now().toSec();
+  // The stages are traced in their own functions.
+  ScopedTrace trace("msckf_vio/featureCallback");
 
   // Propogate the IMU state.
   // that are received before the image msg.
-  ros::Time start_time = ros::Time::now();
   batchImuProcessing(msg->header.stamp.toSec());
-  double imu_processing_time = (
-      ros::Time::now()-start_time).toSec();
 
   // Augment the state vector.
-  start_time = ros::Time::now();
   stateAugmentation(msg->header.stamp.toSec());
-  double state_augmentation_time = (
-      ros::Time::now()-start_time).toSec();
 
   // Add new observations for existing features or new
   // features in the map server.
-  start_time = ros::Time::now();
   addFeatureObservations(msg);
-  double add_observations_time = (
-      ros::Time::now()-start_time).toSec();
 
   // Perform measurement update if necessary.
-  start_time = ros::Time::now();
   removeLostFeatures();
-  double remove_lost_features_time = (
-      ros::Time::now()-start_time).toSec();
 
-  start_time = ros::Time::now();
   pruneCamStateBuffer();
-  double prune_cam_states_time = (
-      ros::Time::now()-start_time).toSec();
 
   // Publish the odometry.
-  start_time = ros::Time::now();
   publish(msg->header.stamp);
-  double publish_time = (
-      ros::Time::now()-start_time).toSec();
 
   // Reset the system if necessary.
   onlineReset();
 
-  double processing_end_time = ros::Time::now().toSec();
-  double processing_time =
-    processing_end_time - processing_start_time;
+  // Restart the IMU rate output from the updated state.
+  if (publish_imu_rate_odom) resetImuRateState();
+
+  const double processing_time = trace.elapsed();
   if (processing_time > 1.0/frame_rate) {
-    ++critical_time_cntr;
-    ROS_INFO("\033[1;31mTotal processing time %f/%d...\033[0m",
-        processing_time, critical_time_cntr);
-    //printf("IMU processing time: %f/%f\n",
-    //    imu_processing_time, imu_processing_time/processing_time);
-    //printf("State augmentation time: %f/%f\n",
-    //    state_augmentation_time, state_augmentation_time/processing_time);
-    //printf("Add observations time: %f/%f\n",
-    //    add_observations_time, add_observations_time/processing_time);
-    printf("Remove lost features time: %f/%f\n",
-        remove_lost_features_time, remove_lost_features_time/processing_time);
-    printf("Remove camera states time: %f/%f\n",
-        prune_cam_states_time, prune_cam_states_time/processing_time);
-    //printf("Publish time: %f/%f\n",
-    //    publish_time, publish_time/processing_time);
+    ROS_INFO("\033[1;31mTotal processing time %f...\033[0m",
+        processing_time);
   }
 
   return;
@@ -546,8 +636,6 @@ void MsckfVio::featureCallback(const CameraMeasurementConstPtr& msg)
 
 void MsckfVio::mocapOdomCallback(
     const nav_msgs::OdometryConstPtr& msg) {
-  static bool first_mocap_odom_msg = true;
-
   // If this is the first mocap odometry messsage, set
   // the initial frame.
   if (first_mocap_odom_msg) {
@@ -592,7 +680,7 @@ void MsckfVio::mocapOdomCallback(
   if (publish_tf) {
     tf::Transform T_b_w_gt_tf;
     tf::transformEigenToTF(T_b_w_gt, T_b_w_gt_tf);
-    tf_pub.sendTransform(tf::StampedTransform(
+    tf_pub->sendTransform(tf::StampedTransform(
           T_b_w_gt_tf, msg->header.stamp, fixed_frame_id, child_frame_id+"_mocap"));
   }
 
@@ -611,35 +699,53 @@ void MsckfVio::mocapOdomCallback(
 }
 
 void MsckfVio::batchImuProcessing(const double& time_bound) {
-  // Counter how many IMU msgs in the buffer are used.
-  int used_imu_msg_cntr = 0;
+  ScopedTrace trace("msckf_vio/batchImuProcessing");
+  if (defer_cross_cov_propagation)
+    batch_transition = Matrix<double, 21, 21>::Identity();
 
   // imu data interval:  state_server.header.stamp =< msgs.stamp <= time_bound 
-  for (const auto& imu_msg : imu_msg_buffer) {
-    double imu_time = imu_msg.header.stamp.toSec();
-    if (imu_time < state_server.imu_state.time) {
-      ++used_imu_msg_cntr;
+  // Older msgs are skipped.
+  const ImuBuffer::SeqType begin_seq = imu_buffer->lowerBound(
+      state_server.imu_state.time, next_imu_seq);
+  const ImuBuffer::SeqType end_seq = imu_buffer->upperBound(
+      time_bound, begin_seq);
+
+  ImuSample sample;
+  int overwritten_num = 0;
+  for (ImuBuffer::SeqType seq = begin_seq; seq < end_seq; ++seq) {
+    if (!imu_buffer->get(seq, sample)) {
+      ++overwritten_num;
       continue;
     }
-    if (imu_time > time_bound) break;
-
-    // Convert the msgs.
-    Vector3d m_gyro, m_acc;
-    tf::vectorMsgToEigen(imu_msg.angular_velocity, m_gyro);
-    tf::vectorMsgToEigen(imu_msg.linear_acceleration, m_acc);
 
     // Execute process model.
     // update X_imu, covariance matrix P
-    processModel(imu_time, m_gyro, m_acc);
-    ++used_imu_msg_cntr;
+    processModel(sample.time, sample.angular_velocity,
+        sample.linear_acceleration);
+  }
+
+  // The skipped samples are integrated over as one long step.
+  if (overwritten_num > 0)
+    ROS_WARN("%d IMU msgs overwritten before being processed, "
+        "increase imu_buffer_duration.", overwritten_num);
+
+  // Propagate the IMU-camera cross covariance with the
+  // accumulated transition of the whole batch.
+  if (defer_cross_cov_propagation && state_server.state_cov_factor) {
+    state_server.state_cov_factor->propagateCross(batch_transition);
+  } else if (defer_cross_cov_propagation &&
+      state_server.cam_states.size() > 0) {
+    if (imu_state_size == IMU_STATE_SIZE)
+      propagateBatchCrossCovariance<IMU_STATE_SIZE>();
+    else
+      propagateBatchCrossCovariance<IMU_CORE_STATE_SIZE>();
   }
 
   // Set the state ID for the new IMU state.
-  state_server.imu_state.id = IMUState::next_id++;
+  state_server.imu_state.id = next_state_id++;
 
-  // Remove all used IMU msgs.
-  imu_msg_buffer.erase(imu_msg_buffer.begin(),
-      imu_msg_buffer.begin()+used_imu_msg_cntr);
+  // Skip all used IMU msgs.
+  next_imu_seq = end_seq;
 
   return;
 }
@@ -656,66 +762,51 @@ void MsckfVio::processModel(const double& time,
   Vector3d acc = m_acc - imu_state.acc_bias;
   double dtime = time - imu_state.time;
 
-  // Compute discrete transition and noise covariance matrix
-  
-  Matrix<double, 21, 21> F = Matrix<double, 21, 21>::Zero();
-  Matrix<double, 21, 12> G = Matrix<double, 21, 12>::Zero();
-
-  F.block<3, 3>(0, 0) = -skewSymmetric(gyro);
-  F.block<3, 3>(0, 3) = -Matrix3d::Identity();
-  F.block<3, 3>(6, 0) = -quaternionToRotation(
-      imu_state.orientation).transpose()*skewSymmetric(acc);
-  F.block<3, 3>(6, 9) = -quaternionToRotation(
-      imu_state.orientation).transpose();
-  F.block<3, 3>(12, 6) = Matrix3d::Identity();
-
-  G.block<3, 3>(0, 0) = -Matrix3d::Identity();
-  G.block<3, 3>(3, 3) = Matrix3d::Identity();
-  G.block<3, 3>(6, 6) = -quaternionToRotation(
-      imu_state.orientation).transpose();
-  G.block<3, 3>(9, 9) = Matrix3d::Identity();
-  
-  Matrix<double, 21, 21> Fdt = F * dtime;
-  Matrix<double, 21, 21> Fdt_square = Fdt * Fdt;
-  Matrix<double, 21, 21> Fdt_cube = Fdt_square * Fdt;
-  Matrix<double, 21, 21> Phi = Matrix<double, 21, 21>::Identity() +
-    Fdt + 0.5*Fdt_square + (1.0/6.0)*Fdt_cube;
+  // Compute the discrete transition matrix in closed form.
+  // Only the non-trivial 3x3 blocks are evaluated.
+  const Matrix3d R_w_i = quaternionToRotation(imu_state.orientation);
+  ImuStateTransition Phi;
+  Phi.compute(gyro, acc, R_w_i, dtime);
+
+  // G*Qc*G^T, where G = diag(-I, I, -R^T, I) maps the noise into
+  // the first 12 error states. The continuous noise covariance is
+  // block diagonal, so only the accelerometer block is rotated.
+  Matrix<double, 12, 12> G_noise_G = state_server.continuous_noise_cov;
+  G_noise_G.block<3, 3>(6, 6) = R_w_i.transpose() *
+    state_server.continuous_noise_cov.block<3, 3>(6, 6) * R_w_i;
 
   // Propogate the state using 4th order Runge-Kutta
-  predictNewState(dtime, gyro, acc);
+  predictNewState(dtime, gyro, acc, sensor_config.gravity, imu_state);
 
   // Modify the transition matrix
   Matrix3d R_kk_1 = quaternionToRotation(imu_state.orientation_null);
-  Phi.block<3, 3>(0, 0) = quaternionToRotation(imu_state.orientation) * R_kk_1.transpose();
+  Phi.Phi_qq = quaternionToRotation(imu_state.orientation) * R_kk_1.transpose();
 
-  Vector3d u = R_kk_1 * IMUState::gravity;
+  Vector3d u = R_kk_1 * sensor_config.gravity;
   RowVector3d s = (u.transpose()*u).inverse() * u.transpose();
 
-  Matrix3d A1 = Phi.block<3, 3>(6, 0);
-  Vector3d w1 = skewSymmetric(imu_state.velocity_null-imu_state.velocity) * IMUState::gravity;
-  Phi.block<3, 3>(6, 0) = A1 - (A1*u-w1)*s;
+  Matrix3d A1 = Phi.Phi_vq;
+  Vector3d w1 = skewSymmetric(imu_state.velocity_null-imu_state.velocity) * sensor_config.gravity;
+  Phi.Phi_vq = A1 - (A1*u-w1)*s;
 
-  Matrix3d A2 = Phi.block<3, 3>(12, 0);
+  Matrix3d A2 = Phi.Phi_pq;
   Vector3d w2 = skewSymmetric(dtime*imu_state.velocity_null+imu_state.position_null-imu_state.position) *
-                IMUState::gravity;
-  Phi.block<3, 3>(12, 0) = A2 - (A2*u-w2)*s;
-
-  Matrix<double, 21, 21> Q = Phi*G*state_server.continuous_noise_cov*G.transpose()*Phi.transpose()*dtime;
-  state_server.state_cov.block<21, 21>(0, 0) = Phi*state_server.state_cov.block<21, 21>(0, 0)*Phi.transpose() + Q;
-
-  if (state_server.cam_states.size() > 0) {
-    
-    state_server.state_cov.block(0, 21, 21, state_server.state_cov.cols()-21) =
-      Phi * state_server.state_cov.block(0, 21, 21, state_server.state_cov.cols()-21);
-    
-    state_server.state_cov.block(21, 0, state_server.state_cov.rows()-21, 21) =
-      state_server.state_cov.block(21, 0, state_server.state_cov.rows()-21, 21) * Phi.transpose();
+                sensor_config.gravity;
+  Phi.Phi_pq = A2 - (A2*u-w2)*s;
+
+  if (state_server.state_cov_factor) {
+    const Matrix<double, 21, 21> Phi_dense = Phi.toDense();
+    state_server.state_cov_factor->propagate(Phi_dense, G_noise_G*dtime);
+    if (defer_cross_cov_propagation)
+      Phi.applyOnTheLeft(batch_transition);
+    else
+      state_server.state_cov_factor->propagateCross(Phi_dense);
+  } else if (imu_state_size == IMU_STATE_SIZE) {
+    propagateStateCovariance<IMU_STATE_SIZE>(Phi, G_noise_G*dtime);
+  } else {
+    propagateStateCovariance<IMU_CORE_STATE_SIZE>(Phi, G_noise_G*dtime);
   }
 
-  // make sure P is symmetric matrix
-  MatrixXd state_cov_fixed = (state_server.state_cov + state_server.state_cov.transpose()) / 2.0;
-  state_server.state_cov = state_cov_fixed;
-
   // Update the state correspondes to null space.
   imu_state.orientation_null = imu_state.orientation;
   imu_state.position_null = imu_state.position;
@@ -728,9 +819,56 @@ void MsckfVio::processModel(const double& time,
   return;
 }
 
+template <int N>
+void MsckfVio::propagateStateCovariance(
+    const ImuStateTransition& Phi, const Matrix<double, 12, 12>& Q) {
+  // P11 = Phi*(P11+G*Qc*G^T*dt)*Phi^T, which is the same as
+  // Phi*P11*Phi^T+Q. Since P11 is symmetric, the right product
+  // is done by applying Phi on the transposed left product.
+  StateCovariance::MatrixView P = state_server.state_cov.matrix();
+  Matrix<double, N, N> P11 = P.block<N, N>(0, 0);
+  P11.template topLeftCorner<12, 12>() += Q;
+  Phi.applyOnTheLeft(P11);
+  P11.transposeInPlace();
+  Phi.applyOnTheLeft(P11);
+
+  // make sure P is symmetric matrix
+  P.block<N, N>(0, 0) = (P11 + P11.transpose()) / 2.0;
+
+  if (defer_cross_cov_propagation) {
+    Phi.applyOnTheLeft(batch_transition);
+  } else {
+    // Unused slots are zero and skipped.
+    for (auto iter = state_server.cam_states.begin();
+        iter != state_server.cam_states.end(); ++iter) {
+      const int j = N + 6*iter.slot();
+      Phi.applyOnTheLeft(P.block<N, 6>(0, j));
+      P.block<6, N>(j, 0) = P.block<N, 6>(0, j).transpose();
+    }
+  }
+  return;
+}
+
+template <int N>
+void MsckfVio::propagateBatchCrossCovariance() {
+  StateCovariance::MatrixView P = state_server.state_cov.matrix();
+  const Matrix<double, N, N> Phi =
+    batch_transition.topLeftCorner<N, N>();
+  for (auto iter = state_server.cam_states.begin();
+      iter != state_server.cam_states.end(); ++iter) {
+    const int j = N + 6*iter.slot();
+    const Matrix<double, N, 6> P12 = Phi * P.block<N, 6>(0, j);
+    P.block<N, 6>(0, j) = P12;
+    P.block<6, N>(j, 0) = P12.transpose();
+  }
+  return;
+}
+
 void MsckfVio::predictNewState(const double& dt,
     const Vector3d& gyro,
-    const Vector3d& acc) {
+    const Vector3d& acc,
+    const Vector3d& gravity,
+    IMUState& imu_state) {
     
   double gyro_norm = gyro.norm();
   Matrix4d Omega = Matrix4d::Zero();
@@ -738,9 +876,9 @@ void MsckfVio::predictNewState(const double& dt,
   Omega.block<3, 1>(0, 3) = gyro;
   Omega.block<1, 3>(3, 0) = -gyro;
 
-  Vector4d& q = state_server.imu_state.orientation;
-  Vector3d& v = state_server.imu_state.velocity;
-  Vector3d& p = state_server.imu_state.position;
+  Vector4d& q = imu_state.orientation;
+  Vector3d& v = imu_state.velocity;
+  Vector3d& p = imu_state.position;
 
   // Some pre-calculation
   
@@ -768,22 +906,22 @@ void MsckfVio::predictNewState(const double& dt,
   Matrix3d dR_dt2_transpose = quaternionToRotation(dq_dt2).transpose();
 
   // k1 = f(tn, yn) -- slope of yn, aka dyn_dt
-  Vector3d k1_v_dot = quaternionToRotation(q).transpose()*acc + IMUState::gravity;
+  Vector3d k1_v_dot = quaternionToRotation(q).transpose()*acc + gravity;
   Vector3d k1_p_dot = v;
 
   // k2 = f(tn+dt/2, yn+k1*dt/2)
   Vector3d k1_v = v + k1_v_dot*dt/2;
-  Vector3d k2_v_dot = dR_dt2_transpose*acc + IMUState::gravity;
+  Vector3d k2_v_dot = dR_dt2_transpose*acc + gravity;
   Vector3d k2_p_dot = k1_v;
 
   // k3 = f(tn+dt/2, yn+k2*dt/2)
   Vector3d k2_v = v + k2_v_dot*dt/2;
-  Vector3d k3_v_dot = dR_dt2_transpose*acc + IMUState::gravity;
+  Vector3d k3_v_dot = dR_dt2_transpose*acc + gravity;
   Vector3d k3_p_dot = k2_v;
 
   // k4 = f(tn+dt, yn+k3*dt)
   Vector3d k3_v = v + k3_v_dot*dt;
-  Vector3d k4_v_dot = dR_dt_transpose*acc + IMUState::gravity;
+  Vector3d k4_v_dot = dR_dt_transpose*acc + gravity;
   Vector3d k4_p_dot = k3_v;
 
   // yn+1 = yn + dt/6*(k1+2*k2+2*k3+k4)
@@ -796,6 +934,7 @@ void MsckfVio::predictNewState(const double& dt,
 }
 
 void MsckfVio::stateAugmentation(const double& time) {
+  ScopedTrace trace("msckf_vio/stateAugmentation");
 
   // read from param, rotation from imu to camera, extrinsic
   const Matrix3d& R_i_c = state_server.imu_state.R_imu_cam0;
@@ -841,31 +980,56 @@ void MsckfVio::stateAugmentation(const double& time) {
   J.block<3, 3>(3, 12) = Matrix3d::Identity();
   J.block<3, 3>(3, 18) = Matrix3d::Identity();
 
-  // Resize the state covariance matrix.
-  size_t old_rows = state_server.state_cov.rows();
-  size_t old_cols = state_server.state_cov.cols();
-  state_server.state_cov.conservativeResize(old_rows+6, old_cols+6);
+  // The covariance is grown as well if the camera state server
+  // ran out of slots. The new rows and columns are zero.
+  const int slot = state_server.cam_states.slot(state_server.imu_state.id);
+  const int state_size = imu_state_size + 6*state_server.cam_states.capacity();
 
-  // Rename some matrix blocks for convenience.
-  const Matrix<double, 21, 21>& P11 = state_server.state_cov.block<21, 21>(0, 0);
-  const MatrixXd& P12 = state_server.state_cov.block(0, 21, 21, old_cols-21);
+  if (state_server.state_cov_factor) {
+    state_server.state_cov_factor->resize(
+        state_server.cam_states.capacity());
+    state_server.state_cov_factor->augment(J, slot);
+    return;
+  }
 
-  // Fill in the augmented state covariance.
-  state_server.state_cov.block(old_rows, 0, 6, old_cols) << J*P11, J*P12;
-  
-  state_server.state_cov.block(0, old_cols, old_rows, 6) =
-    state_server.state_cov.block(old_rows, 0, 6, old_cols).transpose();
-  
-  state_server.state_cov.block<6, 6>(old_rows, old_cols) = J * P11 * J.transpose();
+  if (state_server.state_cov.rows() < state_size) {
+    const int old_size = state_server.state_cov.rows();
+    state_server.state_cov.augment(state_size-old_size);
+    state_server.state_cov.clear(old_size, state_size-old_size);
+  }
 
-  // Fix the covariance to be symmetric
-  MatrixXd state_cov_fixed = (state_server.state_cov + state_server.state_cov.transpose()) / 2.0;
-  state_server.state_cov = state_cov_fixed;
+  if (imu_state_size == IMU_STATE_SIZE)
+    augmentStateCovariance<IMU_STATE_SIZE>(J, slot);
+  else
+    augmentStateCovariance<IMU_CORE_STATE_SIZE>(J, slot);
+
+  return;
+}
 
+template <int N>
+void MsckfVio::augmentStateCovariance(
+    const Matrix<double, 6, 21>& J_full, const int& slot) {
+  // The extrinsic columns are dropped without them in the state.
+  const Matrix<double, 6, N> J = J_full.leftCols<N>();
+  StateCovariance::MatrixView P = state_server.state_cov.matrix();
+  const int state_size = P.rows();
+
+  // Fill in the covariance of the new camera state in its slot,
+  // whose rows and columns are zero before:
+  //   P_ci = J*P_i, P_cc = J*P_ii*J^T.
+  const int s = N + 6*slot;
+  P.middleRows<6>(s).noalias() = J * P.topRows<N>();
+  P.block(0, s, s, 6) = P.block(s, 0, 6, s).transpose();
+  P.block(s+6, s, state_size-s-6, 6) =
+    P.block(s, s+6, 6, state_size-s-6).transpose();
+
+  Matrix<double, 6, 6> P_cc = P.block<6, N>(s, 0) * J.transpose();
+  P.block<6, 6>(s, s) = (P_cc + P_cc.transpose()) / 2.0;
   return;
 }
 
 void MsckfVio::addFeatureObservations(const CameraMeasurementConstPtr& msg) {
+  ScopedTrace trace("msckf_vio/addFeatureObservations");
 
   StateIDType state_id = state_server.imu_state.id;
   int curr_feature_num = map_server.size();
@@ -875,8 +1039,7 @@ void MsckfVio::addFeatureObservations(const CameraMeasurementConstPtr& msg) {
   // features in the map server.
   for (const auto& feature : msg->features) {
     if (map_server.find(feature.id) == map_server.end()) {
-      // This is a new feature.
-      map_server[feature.id] = Feature(feature.id);
+      // This is a new feature, which is inserted by the map server.
       map_server[feature.id].observations[state_id] =
         Vector4d(feature.u0, feature.v0,
             feature.u1, feature.v1);
@@ -896,20 +1059,20 @@ void MsckfVio::addFeatureObservations(const CameraMeasurementConstPtr& msg) {
 
 void MsckfVio::measurementJacobian(const StateIDType& cam_state_id,
                                    const FeatureIDType& feature_id,
-                                   Matrix<double, 4, 6>& H_x, Matrix<double, 4, 3>& H_f, Vector4d& r) {
+                                   Matrix<double, 4, 6>& H_x, Matrix<double, 4, 3>& H_f, Vector4d& r) const {
 
   // Prepare all the required data.
-  const CAMState& cam_state = state_server.cam_states[cam_state_id];
-  const Feature& feature = map_server[feature_id];
+  const CAMState& cam_state = state_server.cam_states.find(cam_state_id)->second;
+  const Feature& feature = map_server.find(feature_id)->second;
 
   // Cam0 pose.
   Matrix3d R_w_c0 = quaternionToRotation(cam_state.orientation);
   const Vector3d& t_c0_w = cam_state.position;
 
   // Cam1 pose.
-  Matrix3d R_c0_c1 = CAMState::T_cam0_cam1.linear();
-  Matrix3d R_w_c1 = CAMState::T_cam0_cam1.linear() * R_w_c0;
-  Vector3d t_c1_w = t_c0_w - R_w_c1.transpose()*CAMState::T_cam0_cam1.translation();
+  Matrix3d R_c0_c1 = sensor_config.T_cam0_cam1.linear();
+  Matrix3d R_w_c1 = sensor_config.T_cam0_cam1.linear() * R_w_c0;
+  Vector3d t_c1_w = t_c0_w - R_w_c1.transpose()*sensor_config.T_cam0_cam1.translation();
 
   // 3d feature position in the world frame.
   // And its observation with the stereo cameras.
@@ -952,8 +1115,8 @@ void MsckfVio::measurementJacobian(const StateIDType& cam_state_id,
   Matrix<double, 4, 6> A = H_x;
   Matrix<double, 6, 1> u = Matrix<double, 6, 1>::Zero();
   
-  u.block<3, 1>(0, 0) = quaternionToRotation(cam_state.orientation_null) * IMUState::gravity;
-  u.block<3, 1>(3, 0) = skewSymmetric(p_w-cam_state.position_null) * IMUState::gravity;
+  u.block<3, 1>(0, 0) = quaternionToRotation(cam_state.orientation_null) * sensor_config.gravity;
+  u.block<3, 1>(3, 0) = skewSymmetric(p_w-cam_state.position_null) * sensor_config.gravity;
   
   H_x = A - A*u*(u.transpose()*u).inverse()*u.transpose();
   H_f = -H_x.block<4, 3>(0, 3);
@@ -967,9 +1130,9 @@ void MsckfVio::measurementJacobian(const StateIDType& cam_state_id,
 
 void MsckfVio::featureJacobian(const FeatureIDType& feature_id,
                                const std::vector<StateIDType>& cam_state_ids,
-                               MatrixXd& H_x, VectorXd& r) {
+                               MatrixXd& H_x, VectorXd& r) const {
 
-  const auto& feature = map_server[feature_id];
+  const auto& feature = map_server.find(feature_id)->second;
 
   // Check how many camera states in the provided camera
   // id camera has actually seen this feature.
@@ -985,13 +1148,16 @@ void MsckfVio::featureJacobian(const FeatureIDType& feature_id,
   int jacobian_row_size = 0;
   jacobian_row_size = 4 * valid_cam_state_ids.size();
 
-  MatrixXd H_xj = MatrixXd::Zero(jacobian_row_size, 21+state_server.cam_states.size()*6);
-  MatrixXd H_fj = MatrixXd::Zero(jacobian_row_size, 3);
-  VectorXd r_j = VectorXd::Zero(jacobian_row_size);
-  
+  // Stack [H_f | H_c | r], where H_c only holds the columns of
+  // the involved camera states.
+  const int cam_state_size = valid_cam_state_ids.size();
+  MatrixXd A = MatrixXd::Zero(jacobian_row_size, 3+6*cam_state_size+1);
+  vector<int> cam_state_slots(cam_state_size);
+
   int stack_cntr = 0;
 
-  for (const auto& cam_id : valid_cam_state_ids) {
+  for (int i = 0; i < cam_state_size; ++i) {
+    const auto& cam_id = valid_cam_state_ids[i];
 
     Matrix<double, 4, 6> H_xi = Matrix<double, 4, 6>::Zero();
     Matrix<double, 4, 3> H_fi = Matrix<double, 4, 3>::Zero();
@@ -999,30 +1165,34 @@ void MsckfVio::featureJacobian(const FeatureIDType& feature_id,
 
     measurementJacobian(cam_id, feature.id, H_xi, H_fi, r_i);
 
-    auto cam_state_iter = state_server.cam_states.find(cam_id);
-    int cam_state_cntr = std::distance(state_server.cam_states.begin(), cam_state_iter);
+    cam_state_slots[i] = state_server.cam_states.slot(cam_id);
 
     // Stack the Jacobians.
-    
-    H_xj.block<4, 6>(stack_cntr, 21+6*cam_state_cntr) = H_xi;
-    H_fj.block<4, 3>(stack_cntr, 0) = H_fi;
-    r_j.segment<4>(stack_cntr) = r_i;
+    A.block<4, 3>(stack_cntr, 0) = H_fi;
+    A.block<4, 6>(stack_cntr, 3+6*i) = H_xi;
+    A.block<4, 1>(stack_cntr, A.cols()-1) = r_i;
     stack_cntr += 4;
   }
-  
-  JacobiSVD<MatrixXd> svd_helper(H_fj, ComputeFullU | ComputeThinV);
-  MatrixXd A = svd_helper.matrixU().rightCols(jacobian_row_size - 3);
 
+  // Project onto the left nullspace of H_f in place. The last
+  // 4M-3 rows then hold
   // Ho = V^T * Hc,  ro = V^T * r
+  // with V being an orthonormal basis of the left nullspace.
+  projectLeftNullspace(A, 3);
 
-  H_x = A.transpose() * H_xj;
-  r = A.transpose() * r_j;
+  H_x = MatrixXd::Zero(jacobian_row_size-3,
+      imu_state_size+state_server.cam_states.capacity()*6);
+  for (int i = 0; i < cam_state_size; ++i)
+    H_x.block(0, imu_state_size+6*cam_state_slots[i], jacobian_row_size-3, 6) =
+      A.block(3, 3+6*i, jacobian_row_size-3, 6);
+  r = A.col(A.cols()-1).tail(jacobian_row_size-3);
 
   return;
 }
 
 void MsckfVio::measurementUpdate(
     const MatrixXd& H, const VectorXd& r) {
+  ScopedTrace trace("msckf_vio/measurementUpdate");
 
   if (H.rows() == 0 || r.rows() == 0) return;
 
@@ -1032,46 +1202,34 @@ void MsckfVio::measurementUpdate(
   VectorXd r_thin;
 
   if (H.rows() > H.cols()) {
-    // Convert H to a sparse matrix.
-    SparseMatrix<double> H_sparse = H.sparseView();
-
-    // Perform QR decompostion on H_sparse.
-    SPQR<SparseMatrix<double> > spqr_helper;
-    spqr_helper.setSPQROrdering(SPQR_ORDERING_NATURAL);
-    spqr_helper.compute(H_sparse);
-    
-    MatrixXd H_temp;
-    VectorXd r_temp;
-    (spqr_helper.matrixQ().transpose() * H).evalTo(H_temp);
-    (spqr_helper.matrixQ().transpose() * r).evalTo(r_temp);
-
-    H_thin = H_temp.topRows(21+state_server.cam_states.size()*6);
-    r_thin = r_temp.head(21+state_server.cam_states.size()*6);
-
-    //HouseholderQR<MatrixXd> qr_helper(H);
-    //MatrixXd Q = qr_helper.householderQ();
-    //MatrixXd Q1 = Q.leftCols(21+state_server.cam_states.size()*6);
-
-    //H_thin = Q1.transpose() * H;
-    //r_thin = Q1.transpose() * r;
+    // The rows of each feature only touch the columns of the
+    // camera states observing it, which is used to compute
+    // Q1^T*H and Q1^T*r without forming Q.
+    compressMeasurement(H, r, H_thin, r_thin);
   } else {
     H_thin = H;
     r_thin = r;
   }
   
-  const MatrixXd& P = state_server.state_cov;
-  MatrixXd S = H_thin*P*H_thin.transpose() +
-               Feature::observation_noise*MatrixXd::Identity(H_thin.rows(), H_thin.rows());
-  
-  //MatrixXd K_transpose = S.fullPivHouseholderQr().solve(H_thin*P);
-  MatrixXd K_transpose = S.ldlt().solve(H_thin*P);
-  MatrixXd K = K_transpose.transpose();
-
   // Compute the error of the state. delta_X = K * r
-  VectorXd delta_x = K * r_thin;
+  VectorXd delta_x;
+  MatrixXd K;
+  if (state_server.state_cov_factor) {
+    state_server.state_cov_factor->update(
+        H_thin, r_thin, sensor_config.observation_noise, delta_x);
+  } else {
+    StateCovariance::MatrixView P = state_server.state_cov.matrix();
+    MatrixXd S = H_thin*P*H_thin.transpose() +
+                 sensor_config.observation_noise*MatrixXd::Identity(H_thin.rows(), H_thin.rows());
+
+    //MatrixXd K_transpose = S.fullPivHouseholderQr().solve(H_thin*P);
+    MatrixXd K_transpose = S.ldlt().solve(H_thin*P);
+    K = K_transpose.transpose();
+    delta_x = K * r_thin;
+  }
 
   // Update the IMU state.
-  const VectorXd& delta_x_imu = delta_x.head<21>();
+  const VectorXd& delta_x_imu = delta_x.head(imu_state_size);
 
   if (//delta_x_imu.segment<3>(0).norm() > 0.15 ||
       //delta_x_imu.segment<3>(3).norm() > 0.15 ||
@@ -1094,46 +1252,55 @@ void MsckfVio::measurementUpdate(
   state_server.imu_state.position += delta_x_imu.segment<3>(12);
 
   // from d_theta to dq, can't use simple plus
-  const Vector4d dq_extrinsic = smallAngleQuaternion(delta_x_imu.segment<3>(15));
-  state_server.imu_state.R_imu_cam0 = quaternionToRotation(dq_extrinsic) * state_server.imu_state.R_imu_cam0;
-  
-  state_server.imu_state.t_cam0_imu += delta_x_imu.segment<3>(18);
+  if (imu_state_size == IMU_STATE_SIZE) {
+    const Vector4d dq_extrinsic = smallAngleQuaternion(delta_x_imu.segment<3>(15));
+    state_server.imu_state.R_imu_cam0 = quaternionToRotation(dq_extrinsic) * state_server.imu_state.R_imu_cam0;
+
+    state_server.imu_state.t_cam0_imu += delta_x_imu.segment<3>(18);
+  }
 
   // Update the camera states.
-  auto cam_state_iter = state_server.cam_states.begin();
-  for (int i = 0; i < state_server.cam_states.size(); ++i, ++cam_state_iter) {
+  for (auto cam_state_iter = state_server.cam_states.begin();
+      cam_state_iter != state_server.cam_states.end(); ++cam_state_iter) {
     
-    const VectorXd& delta_x_cam = delta_x.segment<6>(21+i*6);
+    const VectorXd& delta_x_cam = delta_x.segment<6>(imu_state_size+cam_state_iter.slot()*6);
     const Vector4d dq_cam = smallAngleQuaternion(delta_x_cam.head<3>());
     
     cam_state_iter->second.orientation = quaternionMultiplication(dq_cam, cam_state_iter->second.orientation);
     cam_state_iter->second.position += delta_x_cam.tail<3>();
   }
 
+  // The square-root factor is already updated.
+  if (state_server.state_cov_factor) return;
+
   // Update state covariance.
+  StateCovariance::MatrixView P = state_server.state_cov.matrix();
   MatrixXd I_KH = MatrixXd::Identity(K.rows(), H_thin.cols()) - K*H_thin;
   //state_server.state_cov = I_KH*state_server.state_cov*I_KH.transpose() +
-  //  K*K.transpose()*Feature::observation_noise;
-  state_server.state_cov = I_KH*state_server.state_cov;
+  //  K*K.transpose()*sensor_config.observation_noise;
+  P = I_KH*P;
 
   // Fix the covariance to be symmetric
-  MatrixXd state_cov_fixed = (state_server.state_cov + state_server.state_cov.transpose()) / 2.0;
-  state_server.state_cov = state_cov_fixed;
+  state_server.state_cov.symmetrize();
 
   return;
 }
 
 bool MsckfVio::gatingTest(
-    const MatrixXd& H, const VectorXd& r, const int& dof) {
+    const MatrixXd& H, const VectorXd& r, const int& dof) const {
 
-  MatrixXd P1 = H * state_server.state_cov * H.transpose();
-  MatrixXd P2 = Feature::observation_noise * MatrixXd::Identity(H.rows(), H.rows());
+  MatrixXd P1 = state_server.state_cov_factor ?
+    state_server.state_cov_factor->projectedCovariance(H) :
+    MatrixXd(H * state_server.state_cov.matrix() * H.transpose());
+  MatrixXd P2 = sensor_config.observation_noise * MatrixXd::Identity(H.rows(), H.rows());
   double gamma = r.transpose() * (P1+P2).ldlt().solve(r);
 
   //cout << dof << " " << gamma << " " <<
   //  chi_squared_test_table[dof] << " ";
 
-  if (gamma < chi_squared_test_table[dof]) {
+  const auto chi_squared_iter = chi_squared_test_table.find(dof);
+  if (chi_squared_iter != chi_squared_test_table.end() &&
+      gamma < chi_squared_iter->second) {
     //cout << "passed" << endl;
     return true;
   } else {
@@ -1142,14 +1309,110 @@ bool MsckfVio::gatingTest(
   }
 }
 
+void MsckfVio::stackFeatureJacobians(
+    const vector<FeatureIDType>& feature_ids,
+    const vector<vector<StateIDType> >& cam_state_ids,
+    const vector<int>& dofs, const int& max_row_size,
+    MatrixXd& H_x, VectorXd& r) {
+  ScopedTrace trace("msckf_vio/stackFeatureJacobians");
+
+  const int feature_num = feature_ids.size();
+  vector<MatrixXd> H_xjs(feature_num);
+  vector<VectorXd> r_js(feature_num);
+  vector<char> is_valid(feature_num, 0);
+
+  // The features are independent of each other until they
+  // are stacked. They are processed in order in chunks, each of
+  // which ends at the feature that would exceed the row limit if
+  // all of them passed the gating test. A feature has at most
+  // 4M-3 rows with M observations, so no feature past the limit
+  // is processed.
+  int jacobian_row_size = 0;
+  int processed_num = 0;
+  while (processed_num < feature_num &&
+      jacobian_row_size <= max_row_size) {
+    int chunk_end = processed_num;
+    int predicted_row_size = jacobian_row_size;
+    while (chunk_end < feature_num &&
+        predicted_row_size <= max_row_size) {
+      predicted_row_size +=
+        4*static_cast<int>(cam_state_ids[chunk_end].size()) - 3;
+      ++chunk_end;
+    }
+
+    jacobian_pool->parallelFor(chunk_end-processed_num,
+        [&](const int& k) {
+      const int i = processed_num + k;
+      featureJacobian(feature_ids[i], cam_state_ids[i], H_xjs[i], r_js[i]);
+      is_valid[i] = gatingTest(H_xjs[i], r_js[i], dofs[i]);
+    });
+
+    // The stacking offsets follow the order of the features,
+    // so the result does not depend on the number of threads.
+    for (; processed_num < chunk_end; ++processed_num) {
+      if (!is_valid[processed_num]) continue;
+      jacobian_row_size += H_xjs[processed_num].rows();
+      if (jacobian_row_size > max_row_size) break;
+    }
+    processed_num = chunk_end;
+  }
+
+  H_x = MatrixXd::Zero(jacobian_row_size,
+      imu_state_size+6*state_server.cam_states.capacity());
+  r = VectorXd::Zero(jacobian_row_size);
+  int stack_cntr = 0;
+
+  for (int i = 0; i < feature_num && stack_cntr < jacobian_row_size; ++i) {
+    if (!is_valid[i]) continue;
+    H_x.middleRows(stack_cntr, H_xjs[i].rows()) = H_xjs[i];
+    r.segment(stack_cntr, r_js[i].rows()) = r_js[i];
+    stack_cntr += H_xjs[i].rows();
+  }
+
+  return;
+}
+
+void MsckfVio::initializeFeatures(
+    const vector<Feature*>& features, vector<char>& is_valid) {
+  ScopedTrace trace("msckf_vio/initializeFeatures");
+
+  is_valid.assign(features.size(), 0);
+  if (features.size() == 0) return;
+
+  CameraPoses cam_poses;
+  cam_poses.compute(state_server.cam_states, sensor_config.T_cam0_cam1);
+
+  // Each feature only writes its own position.
+  jacobian_pool->parallelFor(features.size(), [&](const int& i) {
+    Feature& feature = *features[i];
+    is_valid[i] = feature.checkMotion(
+        state_server.cam_states, cam_poses, optimization_config) &&
+      feature.initializePosition(
+        state_server.cam_states, cam_poses, optimization_config);
+  });
+
+  // Only the changes of the map are passed to the point cloud.
+  for (int i = 0; i < features.size(); ++i) {
+    if (is_valid[i])
+      if (feature_cloud)
+        feature_cloud->add(features[i]->id, features[i]->position);
+  }
+
+  return;
+}
+
 void MsckfVio::removeLostFeatures() {
+  ScopedTrace trace("msckf_vio/removeLostFeatures");
 
   // Remove the features that lost track.
-  // BTW, find the size the final Jacobian matrix and residual vector.
-  int jacobian_row_size = 0;
   vector<FeatureIDType> invalid_feature_ids(0);
   vector<FeatureIDType> processed_feature_ids(0);
 
+  // Lost features with enough observations, and those of
+  // them which have not been initialized yet.
+  vector<const Feature*> lost_features(0);
+  vector<Feature*> uninitialized_features(0);
+
   for (auto iter = map_server.begin(); iter != map_server.end(); ++iter) {
     // Rename the feature to be checked.
     auto& feature = iter->second;
@@ -1163,77 +1426,67 @@ void MsckfVio::removeLostFeatures() {
     }
 
     // Check if the feature can be initialized if it has not been.
-    if (!feature.is_initialized) {
-        
-      // translation from first obs-frame to last obs-frame is small(under threshold), invalid  
-      if (!feature.checkMotion(state_server.cam_states)) {
-        invalid_feature_ids.push_back(feature.id);
-        continue;
-      } 
-      else // enough translation/paradex to triangulate points 
-      {
-        if(!feature.initializePosition(state_server.cam_states)) {
-          invalid_feature_ids.push_back(feature.id);
-          continue;
-        }
-      }
-    }
+    if (!feature.is_initialized)
+      uninitialized_features.push_back(&feature);
+    lost_features.push_back(&feature);
+  }
 
-    jacobian_row_size += 4*feature.observations.size() - 3;
-    processed_feature_ids.push_back(feature.id);
+  // Features without enough translation/parallax between the
+  // first and the last observation, or failing the
+  // triangulation, are invalid.
+  vector<char> is_initialized(0);
+  initializeFeatures(uninitialized_features, is_initialized);
+  for (int i = 0; i < uninitialized_features.size(); ++i) {
+    if (!is_initialized[i])
+      invalid_feature_ids.push_back(uninitialized_features[i]->id);
+  }
+
+  // Keep the processed features in the order of their ids.
+  for (const auto& feature : lost_features) {
+    if (feature->is_initialized)
+      processed_feature_ids.push_back(feature->id);
   }
 
   //cout << "invalid/processed feature #: " <<
   //  invalid_feature_ids.size() << "/" <<
   //  processed_feature_ids.size() << endl;
-  //cout << "jacobian row #: " << jacobian_row_size << endl;
 
   // Remove the features that do not have enough measurements.
-  for (const auto& feature_id : invalid_feature_ids)
+  for (const auto& feature_id : invalid_feature_ids) {
+    if (feature_cloud && map_server[feature_id].is_initialized)
+      feature_cloud->remove(feature_id);
     map_server.erase(feature_id);
+  }
 
   // Return if there is no lost feature to be processed.
   if (processed_feature_ids.size() == 0) return;
 
-  MatrixXd H_x = MatrixXd::Zero(jacobian_row_size, 21+6*state_server.cam_states.size());
-  VectorXd r = VectorXd::Zero(jacobian_row_size);
-  int stack_cntr = 0;
-
   // Process the features which was tracked.
-  for (const auto& feature_id : processed_feature_ids) {
-    auto& feature = map_server[feature_id];
-
-    vector<StateIDType> cam_state_ids(0);
+  vector<vector<StateIDType> > cam_state_ids(processed_feature_ids.size());
+  vector<int> dofs(processed_feature_ids.size());
+  for (int i = 0; i < processed_feature_ids.size(); ++i) {
+    const auto& feature = map_server[processed_feature_ids[i]];
     for (const auto& measurement : feature.observations)
-      cam_state_ids.push_back(measurement.first);
-
-    MatrixXd H_xj;
-    VectorXd r_j;
-    
-    // get jacobian matrix(multiply left-nullspace) for each feature and related obs-cameras
-    featureJacobian(feature.id, cam_state_ids, H_xj, r_j);
-
-    if (gatingTest(H_xj, r_j, cam_state_ids.size()-1)) {
-      
-      H_x.block(stack_cntr, 0, H_xj.rows(), H_xj.cols()) = H_xj;
-      r.segment(stack_cntr, r_j.rows()) = r_j;
-      stack_cntr += H_xj.rows();
-    }
-
-    // Put an upper bound on the row size of measurement Jacobian,
-    // which helps guarantee the executation time.
-    if (stack_cntr > 1500) break;
+      cam_state_ids[i].push_back(measurement.first);
+    dofs[i] = cam_state_ids[i].size() - 1;
   }
 
-  H_x.conservativeResize(stack_cntr, H_x.cols());
-  r.conservativeResize(stack_cntr);
+  // get jacobian matrix(multiply left-nullspace) for each feature and related obs-cameras
+  // Put an upper bound on the row size of measurement Jacobian,
+  // which helps guarantee the executation time.
+  MatrixXd H_x;
+  VectorXd r;
+  stackFeatureJacobians(processed_feature_ids, cam_state_ids,
+      dofs, 1500, H_x, r);
 
   // Perform the measurement update step.
   measurementUpdate(H_x, r);
 
   // Remove all processed features from the map.
-  for (const auto& feature_id : processed_feature_ids)
+  for (const auto& feature_id : processed_feature_ids) {
+    if (feature_cloud) feature_cloud->remove(feature_id);
     map_server.erase(feature_id);
+  }
 
   return;
 }
@@ -1282,6 +1535,7 @@ void MsckfVio::findRedundantCamStates(
 }
 
 void MsckfVio::pruneCamStateBuffer() {
+  ScopedTrace trace("msckf_vio/pruneCamStateBuffer");
 
   // max_cam_state_size = 30
   if (state_server.cam_states.size() < max_cam_state_size)
@@ -1292,8 +1546,9 @@ void MsckfVio::pruneCamStateBuffer() {
   vector<StateIDType> rm_cam_state_ids(0);
   findRedundantCamStates(rm_cam_state_ids);
 
-  // Find the size of the Jacobian matrix.
-  int jacobian_row_size = 0;
+  // Drop the observations which cannot be used for the update.
+  vector<Feature*> uninitialized_features(0);
+  vector<vector<StateIDType> > uninitialized_cam_state_ids(0);
   for (auto& item : map_server) 
   {
     
@@ -1314,102 +1569,74 @@ void MsckfVio::pruneCamStateBuffer() {
       continue;
     }
     
-
+    // Check if the feature can be initialize.
     if (!feature.is_initialized) {
-      // Check if the feature can be initialize.
-      if (!feature.checkMotion(state_server.cam_states)) 
-      {
-        // If the feature cannot be initialized, just remove
-        // the observations associated with the camera states to be removed.
-        for (const auto& cam_id : involved_cam_state_ids)
-          feature.observations.erase(cam_id);
-        continue;
-      } 
-      else 
-      {
-        if(!feature.initializePosition(state_server.cam_states)) 
-        {
-          for (const auto& cam_id : involved_cam_state_ids)
-            feature.observations.erase(cam_id);
-          continue;
-        }
-      }
+      uninitialized_features.push_back(&feature);
+      uninitialized_cam_state_ids.push_back(involved_cam_state_ids);
     }
-
-    jacobian_row_size += 4*involved_cam_state_ids.size() - 3;
   }
 
-  //cout << "jacobian row #: " << jacobian_row_size << endl;
+  // If the feature cannot be initialized, just remove
+  // the observations associated with the camera states to be removed.
+  vector<char> is_initialized(0);
+  initializeFeatures(uninitialized_features, is_initialized);
+  for (int i = 0; i < uninitialized_features.size(); ++i) {
+    if (is_initialized[i]) continue;
+    for (const auto& cam_id : uninitialized_cam_state_ids[i])
+      uninitialized_features[i]->observations.erase(cam_id);
+  }
 
   // Compute the Jacobian and residual.
-  MatrixXd H_x = MatrixXd::Zero(jacobian_row_size, 21+6*state_server.cam_states.size());
-  VectorXd r = VectorXd::Zero(jacobian_row_size);
-  int stack_cntr = 0;
+  vector<FeatureIDType> involved_feature_ids(0);
+  vector<vector<StateIDType> > involved_cam_state_ids(0);
+  vector<int> dofs(0);
 
   for (auto& item : map_server) 
   {
     auto& feature = item.second;
     // Check how many camera states to be removed are associated with this feature.
-    vector<StateIDType> involved_cam_state_ids(0);
+    vector<StateIDType> cam_state_ids(0);
     
     for (const auto& cam_id : rm_cam_state_ids) 
     {
       if (feature.observations.find(cam_id) != feature.observations.end())
-        involved_cam_state_ids.push_back(cam_id);
+        cam_state_ids.push_back(cam_id);
     }
 
-    if (involved_cam_state_ids.size() == 0)
+    if (cam_state_ids.size() == 0)
         continue;
 
-    MatrixXd H_xj;
-    VectorXd r_j;
-    featureJacobian(feature.id, involved_cam_state_ids, H_xj, r_j);
+    involved_feature_ids.push_back(feature.id);
+    dofs.push_back(cam_state_ids.size());
+    involved_cam_state_ids.push_back(cam_state_ids);
+  }
 
-    if (gatingTest(H_xj, r_j, involved_cam_state_ids.size())) 
-    {
-      H_x.block(stack_cntr, 0, H_xj.rows(), H_xj.cols()) = H_xj;
-      r.segment(stack_cntr, r_j.rows()) = r_j;
-      stack_cntr += H_xj.rows();
-    }
+  MatrixXd H_x;
+  VectorXd r;
+  stackFeatureJacobians(involved_feature_ids, involved_cam_state_ids,
+      dofs, std::numeric_limits<int>::max(), H_x, r);
 
-    for (const auto& cam_id : involved_cam_state_ids)
+  for (int i = 0; i < involved_feature_ids.size(); ++i) {
+    auto& feature = map_server[involved_feature_ids[i]];
+    for (const auto& cam_id : involved_cam_state_ids[i])
       feature.observations.erase(cam_id);
   }
 
-  H_x.conservativeResize(stack_cntr, H_x.cols());
-  r.conservativeResize(stack_cntr);
-
   // Perform measurement update.
   measurementUpdate(H_x, r);
 
   for (const auto& cam_id : rm_cam_state_ids) 
   {
-    int cam_sequence = std::distance(state_server.cam_states.begin(), state_server.cam_states.find(cam_id));
-    int cam_state_start = 21 + 6*cam_sequence;
-    int cam_state_end = cam_state_start + 6;
-
-    // Remove the corresponding rows and columns in the state covariance matrix.
-    
-    if (cam_state_end < state_server.state_cov.rows()) 
-    {
-      state_server.state_cov.block(cam_state_start, 0, 
-                                   state_server.state_cov.rows()-cam_state_end, state_server.state_cov.cols()) =
-      state_server.state_cov.block(cam_state_end, 0,
-                                   state_server.state_cov.rows()-cam_state_end, state_server.state_cov.cols());
+    const int cam_slot = state_server.cam_states.slot(cam_id);
 
-      state_server.state_cov.block(0, cam_state_start,
-                                   state_server.state_cov.rows(), state_server.state_cov.cols()-cam_state_end) =
-      state_server.state_cov.block(0, cam_state_end, 
-                                   state_server.state_cov.rows(), state_server.state_cov.cols()-cam_state_end);
+    // Clear the corresponding rows and columns in the state covariance matrix.
+    // The other camera states keep their slots, so nothing is moved.
+    if (state_server.state_cov_factor)
+      state_server.state_cov_factor->remove(cam_slot);
+    else
+      state_server.state_cov.clear(imu_state_size+6*cam_slot, 6);
 
-      state_server.state_cov.conservativeResize(state_server.state_cov.rows()-6, state_server.state_cov.cols()-6);
-    } 
-    else 
-    {
-      state_server.state_cov.conservativeResize(state_server.state_cov.rows()-6, state_server.state_cov.cols()-6);
-    }
-
-    // Remove this camera state in the state vector.
+    // Remove this camera state in the state vector and free its slot.
     state_server.cam_states.erase(cam_id);
   }
 
@@ -1417,16 +1644,17 @@ void MsckfVio::pruneCamStateBuffer() {
 }
 
 void MsckfVio::onlineReset() {
+  ScopedTrace trace("msckf_vio/onlineReset");
 
   // Never perform online reset if position std threshold
   // is non-positive.
   if (position_std_threshold <= 0) return;
-  static long long int online_reset_counter = 0;
 
   // Check the uncertainty of positions to determine if the system can be reset.
-  double position_x_std = std::sqrt(state_server.state_cov(12, 12));
-  double position_y_std = std::sqrt(state_server.state_cov(13, 13));
-  double position_z_std = std::sqrt(state_server.state_cov(14, 14));
+  const Matrix<double, 15, 15> P_imu = imuStateCovariance();
+  double position_x_std = std::sqrt(P_imu(12, 12));
+  double position_y_std = std::sqrt(P_imu(13, 13));
+  double position_z_std = std::sqrt(P_imu(14, 14));
 
   if (position_x_std < position_std_threshold &&
       position_y_std < position_std_threshold &&
@@ -1442,54 +1670,126 @@ void MsckfVio::onlineReset() {
 
   // Clear all exsiting features in the map.
   map_server.clear();
+  if (feature_cloud) feature_cloud->clear();
 
   // Reset the state covariance.
-  double gyro_bias_cov, acc_bias_cov, velocity_cov;
-  nh.param<double>("initial_covariance/velocity",
-      velocity_cov, 0.25);
-  nh.param<double>("initial_covariance/gyro_bias",
-      gyro_bias_cov, 1e-4);
-  nh.param<double>("initial_covariance/acc_bias",
-      acc_bias_cov, 1e-2);
+  resetStateCovariance();
 
-  double extrinsic_rotation_cov, extrinsic_translation_cov;
-  nh.param<double>("initial_covariance/extrinsic_rotation_cov",
-      extrinsic_rotation_cov, 3.0462e-4);
-  nh.param<double>("initial_covariance/extrinsic_translation_cov",
-      extrinsic_translation_cov, 1e-4);
+  ROS_WARN("%lld online reset complete...", online_reset_counter);
+  return;
+}
 
-  state_server.state_cov = MatrixXd::Zero(21, 21);
+void MsckfVio::resetStateCovariance() {
+  state_server.state_cov.reset(
+      imu_state_size+6*state_server.cam_states.capacity());
   for (int i = 3; i < 6; ++i)
     state_server.state_cov(i, i) = gyro_bias_cov;
   for (int i = 6; i < 9; ++i)
     state_server.state_cov(i, i) = velocity_cov;
   for (int i = 9; i < 12; ++i)
     state_server.state_cov(i, i) = acc_bias_cov;
-  for (int i = 15; i < 18; ++i)
-    state_server.state_cov(i, i) = extrinsic_rotation_cov;
-  for (int i = 18; i < 21; ++i)
-    state_server.state_cov(i, i) = extrinsic_translation_cov;
+  if (imu_state_size == IMU_STATE_SIZE) {
+    for (int i = 15; i < 18; ++i)
+      state_server.state_cov(i, i) = extrinsic_rotation_cov;
+    for (int i = 18; i < 21; ++i)
+      state_server.state_cov(i, i) = extrinsic_translation_cov;
+  }
+  if (state_server.state_cov_factor)
+    state_server.state_cov_factor->reset(
+        state_server.state_cov.matrix().diagonal().head(imu_state_size),
+        state_server.cam_states.capacity());
+  return;
+}
 
-  ROS_WARN("%lld online reset complete...", online_reset_counter);
+Matrix<double, 15, 15> MsckfVio::imuStateCovariance() const {
+  if (state_server.state_cov_factor)
+    return state_server.state_cov_factor->imuCovariance()
+      .topLeftCorner<15, 15>();
+  return state_server.state_cov.matrix().topLeftCorner<15, 15>();
+}
+
+void MsckfVio::resetImuRateState() {
+  imu_rate_state = state_server.imu_state;
+  is_imu_rate_state_valid = true;
+
+  // The IMU msgs after the current image are still in the buffer.
+  ImuSample sample;
+  const ImuBuffer::SeqType end_seq = imu_buffer->end();
+  for (ImuBuffer::SeqType seq = max(next_imu_seq, imu_buffer->begin());
+      seq < end_seq; ++seq) {
+    if (imu_buffer->get(seq, sample))
+      propagateImuRateState(sample);
+  }
   return;
 }
 
-void MsckfVio::publish(const ros::Time& time) {
+bool MsckfVio::propagateImuRateState(const ImuSample& sample) {
+  // Msgs already covered by the state are skipped.
+  const double dtime = sample.time - imu_rate_state.time;
+  if (dtime <= 0.0) return false;
+
+  imu_rate_gyro = sample.angular_velocity - imu_rate_state.gyro_bias;
+  const Vector3d acc = sample.linear_acceleration - imu_rate_state.acc_bias;
+  predictNewState(dtime, imu_rate_gyro, acc,
+      sensor_config.gravity, imu_rate_state);
+  imu_rate_state.time = sample.time;
+  return true;
+}
+
+void MsckfVio::publishImuRateOdom(const ros::Time& time) {
 
   // Convert the IMU frame to the body frame.
+  Eigen::Isometry3d T_i_w = Eigen::Isometry3d::Identity();
+  T_i_w.linear() = quaternionToRotation(imu_rate_state.orientation).transpose();
+  T_i_w.translation() = imu_rate_state.position;
+
+  Eigen::Isometry3d T_b_w = sensor_config.T_imu_body * T_i_w * sensor_config.T_imu_body.inverse();
+  Eigen::Vector3d body_velocity = sensor_config.T_imu_body.linear() * imu_rate_state.velocity;
+  Eigen::Vector3d body_angular_velocity = sensor_config.T_imu_body.linear() * imu_rate_gyro;
+
+  // The covariance is left zero since it is not propagated.
+  nav_msgs::Odometry odom_msg;
+  odom_msg.header.stamp = time;
+  odom_msg.header.frame_id = fixed_frame_id;
+  odom_msg.child_frame_id = child_frame_id;
+
+  tf::poseEigenToMsg(T_b_w, odom_msg.pose.pose);
+  tf::vectorEigenToMsg(body_velocity, odom_msg.twist.twist.linear);
+  tf::vectorEigenToMsg(body_angular_velocity, odom_msg.twist.twist.angular);
+
+  imu_rate_odom_pub.publish(odom_msg);
+  return;
+}
+
+void MsckfVio::publish(const ros::Time& time) {
+  ScopedTrace trace("msckf_vio/publish");
+  if (state_callback) state_callback(state_server.imu_state);
+
   const IMUState& imu_state = state_server.imu_state;
+  if (trajectory_logger) {
+    const CAMState& cam_state = state_server.cam_states[imu_state.id];
+    PoseRecord pose;
+    pose.time = time.toSec();
+    Map<Vector3d>(pose.position) = cam_state.position;
+    Map<Vector4d>(pose.orientation) = cam_state.orientation;
+    trajectory_logger->log(pose);
+  }
+
+  if (!nh) return;
+
+  // Convert the IMU frame to the body frame.
   Eigen::Isometry3d T_i_w = Eigen::Isometry3d::Identity();
   T_i_w.linear() = quaternionToRotation(imu_state.orientation).transpose();
   T_i_w.translation() = imu_state.position;
 
-  Eigen::Isometry3d T_b_w = IMUState::T_imu_body * T_i_w * IMUState::T_imu_body.inverse();
-  Eigen::Vector3d body_velocity = IMUState::T_imu_body.linear() * imu_state.velocity;
+  Eigen::Isometry3d T_b_w = sensor_config.T_imu_body * T_i_w * sensor_config.T_imu_body.inverse();
+  Eigen::Vector3d body_velocity = sensor_config.T_imu_body.linear() * imu_state.velocity;
 
   // Publish tf
   if (publish_tf) {
     tf::Transform T_b_w_tf;
     tf::transformEigenToTF(T_b_w, T_b_w_tf);
-    tf_pub.sendTransform(tf::StampedTransform(T_b_w_tf, time, fixed_frame_id, child_frame_id));
+    tf_pub->sendTransform(tf::StampedTransform(T_b_w_tf, time, fixed_frame_id, child_frame_id));
   }
 
   // Publish the odometry
@@ -1507,44 +1807,38 @@ void MsckfVio::publish(const ros::Time& time) {
   pose_stamped.header.frame_id = fixed_frame_id;
   pose_stamped.pose = odom_msg.pose.pose;
   
-  vio_path.header = odom_msg.header;
-  vio_path.header.frame_id = fixed_frame_id;
-  vio_path.poses.push_back(pose_stamped);
-  pub_vio_path.publish(vio_path);
-
-  CAMState& cam_state = state_server.cam_states[imu_state.id];
-  Vector3d& trans = cam_state.position;
-  Vector4d& quat = cam_state.orientation;
-
-  ofstream pose_output_file("/home/r/dataset/EuRoC/msckf_pose.txt", ios::app);
-  pose_output_file.setf(ios::fixed, ios::floatfield);
-  pose_output_file.precision(6);
-  pose_output_file << time.toSec() << " ";
-  pose_output_file.precision(5);
-  pose_output_file << trans.x() << " "
-                   << trans.y() << " "
-                   << trans.z() << " "
-                   << quat.w() << " "
-                   << quat.x() << " "
-                   << quat.y() << " "
-                   << quat.z() << endl;
-                   
-  pose_output_file.close();
-  
+  pub_vio_pose.publish(pose_stamped);
+
+  if (path_pose_count++ % path_decimation == 0) {
+    vio_path_poses.push_back(pose_stamped);
+    if (path_max_length > 0 &&
+        vio_path_poses.size() > static_cast<size_t>(path_max_length))
+      vio_path_poses.pop_front();
+
+    // The path is only assembled if someone listens to it.
+    if (pub_vio_path.getNumSubscribers() > 0) {
+      nav_msgs::Path vio_path;
+      vio_path.header = pose_stamped.header;
+      vio_path.poses.assign(vio_path_poses.begin(), vio_path_poses.end());
+      pub_vio_path.publish(vio_path);
+    }
+  }
+
   //--------codes for trajectory---------
                    
   
   // Convert the covariance.
-  Matrix3d P_oo = state_server.state_cov.block<3, 3>(0, 0);
-  Matrix3d P_op = state_server.state_cov.block<3, 3>(0, 12);
-  Matrix3d P_po = state_server.state_cov.block<3, 3>(12, 0);
-  Matrix3d P_pp = state_server.state_cov.block<3, 3>(12, 12);
+  const Matrix<double, 15, 15> P = imuStateCovariance();
+  Matrix3d P_oo = P.block<3, 3>(0, 0);
+  Matrix3d P_op = P.block<3, 3>(0, 12);
+  Matrix3d P_po = P.block<3, 3>(12, 0);
+  Matrix3d P_pp = P.block<3, 3>(12, 12);
   Matrix<double, 6, 6> P_imu_pose = Matrix<double, 6, 6>::Zero();
   P_imu_pose << P_pp, P_po, P_op, P_oo;
 
   Matrix<double, 6, 6> H_pose = Matrix<double, 6, 6>::Zero();
-  H_pose.block<3, 3>(0, 0) = IMUState::T_imu_body.linear();
-  H_pose.block<3, 3>(3, 3) = IMUState::T_imu_body.linear();
+  H_pose.block<3, 3>(0, 0) = sensor_config.T_imu_body.linear();
+  H_pose.block<3, 3>(3, 3) = sensor_config.T_imu_body.linear();
   Matrix<double, 6, 6> P_body_pose = H_pose *
     P_imu_pose * H_pose.transpose();
 
@@ -1553,8 +1847,8 @@ void MsckfVio::publish(const ros::Time& time) {
       odom_msg.pose.covariance[6*i+j] = P_body_pose(i, j);
 
   // Construct the covariance for the velocity.
-  Matrix3d P_imu_vel = state_server.state_cov.block<3, 3>(6, 6);
-  Matrix3d H_vel = IMUState::T_imu_body.linear();
+  Matrix3d P_imu_vel = P.block<3, 3>(6, 6);
+  Matrix3d H_vel = sensor_config.T_imu_body.linear();
   Matrix3d P_body_vel = H_vel * P_imu_vel * H_vel.transpose();
   for (int i = 0; i < 3; ++i)
     for (int j = 0; j < 3; ++j)
@@ -1564,21 +1858,7 @@ void MsckfVio::publish(const ros::Time& time) {
 
   // Publish the 3D positions of the features that
   // has been initialized.
-  pcl::PointCloud<pcl::PointXYZ>::Ptr feature_msg_ptr(
-      new pcl::PointCloud<pcl::PointXYZ>());
-  feature_msg_ptr->header.frame_id = fixed_frame_id;
-  feature_msg_ptr->height = 1;
-  for (const auto& item : map_server) {
-    const auto& feature = item.second;
-    if (feature.is_initialized) {
-      Vector3d feature_position =
-        IMUState::T_imu_body.linear() * feature.position;
-      feature_msg_ptr->points.push_back(pcl::PointXYZ(
-            feature_position(0), feature_position(1), feature_position(2)));
-    }
-  }
-  feature_msg_ptr->width = feature_msg_ptr->points.size();
-  feature_pub.publish(feature_msg_ptr);
+  feature_cloud->publish(time);
 
   return;
 }
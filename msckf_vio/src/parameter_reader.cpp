@@ -0,0 +1,94 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <msckf_vio/parameter_reader.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+ParameterReader::ParameterReader(const ros::NodeHandle& nh):
+  nh(&nh) {
+  return;
+}
+
+ParameterReader::ParameterReader(const YAML::Node& node):
+  nh(nullptr),
+  node(node) {
+  return;
+}
+
+bool ParameterReader::loadFile(const string& file_name, YAML::Node& node) {
+  try {
+    node = YAML::LoadFile(file_name);
+  } catch (const YAML::Exception& e) {
+    ROS_ERROR("Cannot load %s: %s", file_name.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+YAML::Node ParameterReader::find(const string& name) const {
+  // Assigning a node would change the node it refers to, so
+  // the current node is rebound with reset() instead.
+  YAML::Node current;
+  current.reset(node);
+  size_t start = 0;
+  while (start <= name.size()) {
+    size_t end = name.find('/', start);
+    if (end == string::npos) end = name.size();
+    if (end > start) {
+      if (!current.IsMap()) return YAML::Node(YAML::NodeType::Undefined);
+      const YAML::Node& const_current = current;
+      const YAML::Node child = const_current[name.substr(start, end-start)];
+      if (!child.IsDefined()) return YAML::Node(YAML::NodeType::Undefined);
+      current.reset(child);
+    }
+    start = end + 1;
+  }
+  return current;
+}
+
+void ParameterReader::convert(const YAML::Node& node, int& value) {
+  try {
+    value = node.as<int>();
+  } catch (const YAML::Exception&) {
+    value = static_cast<int>(node.as<double>());
+  }
+  return;
+}
+
+void ParameterReader::convert(const YAML::Node& node, vector<int>& value) {
+  if (!node.IsSequence()) throw YAML::TypedBadConversion<vector<int> >(
+      node.Mark());
+  value.resize(node.size());
+  for (size_t i = 0; i < node.size(); ++i) convert(node[i], value[i]);
+  return;
+}
+
+bool ParameterReader::getParam(const string& name,
+    vector<vector<double> >& value) const {
+  if (!nh) return getParam<vector<vector<double> > >(name, value);
+
+  XmlRpc::XmlRpcValue rows;
+  if (!nh->getParam(name, rows) ||
+      rows.getType() != XmlRpc::XmlRpcValue::TypeArray) return false;
+
+  vector<vector<double> > matrix(rows.size());
+  for (int i = 0; i < rows.size(); ++i) {
+    if (rows[i].getType() != XmlRpc::XmlRpcValue::TypeArray) return false;
+    for (int j = 0; j < rows[i].size(); ++j) {
+      if (rows[i][j].getType() != XmlRpc::XmlRpcValue::TypeDouble)
+        return false;
+      matrix[i].push_back(static_cast<double>(rows[i][j]));
+    }
+  }
+  value.swap(matrix);
+  return true;
+}
+
+} // namespace msckf_vio
@@ -61,6 +61,8 @@ bool Semantic::createRosIO()
     image_transport::ImageTransport it(nh);
     debug_stereo_pub = it.advertise("debug_stereo_image", 10);
 
+    latency_diagnostics.initialize(nh, "semantic/");
+
     return true;
 }
 
@@ -78,6 +80,7 @@ bool Semantic::initialize()
 
 void Semantic::feature_Callback(const CameraMeasurementConstPtr& msg)
 {
+    ScopedTrace trace("semantic/feature_Callback");
 
     // ROS_INFO("*Receive feature ptr.");
     std::lock_guard<std::mutex> lock_(mutex_);
@@ -100,6 +103,7 @@ void Semantic::image_Callback
 
 bool Semantic::Detect()
 {
+    ScopedTrace trace("semantic/Detect");
 
     cv::Vec4d intrinsics(7.070493e+02, 7.070493e+02, 6.040814e+02, 1.805066e+02); 
     std::string distortion_model = "radtan"; 
@@ -123,10 +127,13 @@ bool Semantic::Detect()
         net_input_img = resize_image;
     }
 
-    cv::dnn::blobFromImage(net_input_img, blob, 1 / 255.0, cv::Size(netWidth, netHeight), cv::Scalar(104, 117,123), true, false);
-    net.setInput(blob);
     std::vector<cv::Mat> net_output_img;
-    net.forward(net_output_img, net.getUnconnectedOutLayersNames());
+    {
+        ScopedTrace inference_trace("semantic/inference");
+        cv::dnn::blobFromImage(net_input_img, blob, 1 / 255.0, cv::Size(netWidth, netHeight), cv::Scalar(104, 117,123), true, false);
+        net.setInput(blob);
+        net.forward(net_output_img, net.getUnconnectedOutLayersNames());
+    }
     std::vector<int> classIds; 
     std::vector<float> confidences;
     std::vector<cv::Rect> boxes;
@@ -199,21 +206,22 @@ bool Semantic::Detect()
     ROS_INFO("feature_ptr->header.stamp: %f", feature_ptr->header.stamp.toSec());
     ROS_INFO("image_ptr->header.stamp: %f", image_ptr->header.stamp.toSec());
         // ROS_INFO("Detected dynamic object.");   
+        // Undistort the upper left and lower right corners of all
+        // the boxes at once, instead of once for every feature.
+        std::vector<cv::Point2f> pts_in;
+        std::vector<cv::Point2f> pts_out;
+        for(const auto& object : output){
+            pts_in.push_back(cv::Point2f(object.box.x, object.box.y));
+            pts_in.push_back(cv::Point2f(object.box.x + object.box.width, object.box.y + object.box.height));
+        }
+        undistortPoints(pts_in, intrinsics, distortion_model, distortion_coeffs, pts_out);
+
         //去除特征点
         for(const auto& feature : feature_ptr->features){
             bool isInsideDynamicObject = false;  // 是否在动态目标中的标志位
-            for(const auto& object : output){
-                std::vector<cv::Point2f> pts_out;
-                std::vector<cv::Point2f> pts_in = {
-                    cv::Point2f(object.box.x, object.box.y),
-                    cv::Point2f(object.box.x + object.box.width, object.box.y),
-                    cv::Point2f(object.box.x, object.box.y + object.box.height),
-                    cv::Point2f(object.box.x + object.box.width, object.box.y + object.box.height)
-                };
-                undistortPoints(pts_in, intrinsics, distortion_model, distortion_coeffs, pts_out);
-
-                if(feature.u0 >= pts_out[0].x && feature.u0 <= pts_out[3].x &&
-                    feature.v0 >= pts_out[0].y && feature.v0 <= pts_out[3].y) {   
+            for(int i = 0; i < output.size(); ++i){
+                if(feature.u0 >= pts_out[2*i].x && feature.u0 <= pts_out[2*i+1].x &&
+                    feature.v0 >= pts_out[2*i].y && feature.v0 <= pts_out[2*i+1].y) {   
                     isInsideDynamicObject = true;
                     break;
                 }
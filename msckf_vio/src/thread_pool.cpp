@@ -0,0 +1,88 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <msckf_vio/thread_pool.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+ThreadPool::ThreadPool(const int& thread_num):
+  task_func(nullptr),
+  task_num(0),
+  next_task(0),
+  busy_workers(0),
+  generation(0),
+  stop(false) {
+  for (int i = 1; i < thread_num; ++i)
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  return;
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(pool_mutex);
+    stop = true;
+  }
+  start_cond.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+  return;
+}
+
+void ThreadPool::parallelFor(const int& n,
+    const function<void(const int&)>& func) {
+
+  // Not worth waking up the workers.
+  if (workers.empty() || n <= 1) {
+    for (int i = 0; i < n; ++i) func(i);
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(pool_mutex);
+    task_func = &func;
+    task_num = n;
+    next_task = 0;
+    busy_workers = workers.size();
+    ++generation;
+  }
+  start_cond.notify_all();
+
+  runTasks();
+
+  unique_lock<mutex> lock(pool_mutex);
+  done_cond.wait(lock, [this]() { return busy_workers == 0; });
+  task_func = nullptr;
+  return;
+}
+
+void ThreadPool::workerLoop() {
+  unsigned long finished_generation = 0;
+  while (true) {
+    {
+      unique_lock<mutex> lock(pool_mutex);
+      start_cond.wait(lock, [&]() {
+          return stop || generation != finished_generation; });
+      if (stop) return;
+      finished_generation = generation;
+    }
+
+    runTasks();
+
+    lock_guard<mutex> lock(pool_mutex);
+    if (--busy_workers == 0) done_cond.notify_one();
+  }
+}
+
+void ThreadPool::runTasks() {
+  for (int i = next_task++; i < task_num; i = next_task++)
+    (*task_func)(i);
+  return;
+}
+
+} // namespace msckf_vio
@@ -0,0 +1,136 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <chrono>
+#include <msckf_vio/trajectory_logger.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+TrajectoryLogger::TrajectoryLogger(const string& path,
+    const Format& format,
+    const double& flush_period,
+    const long& max_file_size,
+    const int& queue_size):
+  path(path),
+  format(format),
+  flush_period(flush_period),
+  max_file_size(max_file_size),
+  queue(queue_size),
+  dropped_num(0),
+  is_open(false),
+  file(nullptr),
+  file_size(0),
+  file_index(0),
+  stop(false) {
+  // Resume the rotation instead of appending to the first
+  // of the files of a previous run.
+  is_open = openFile(max_file_size > 0 ? lastFileIndex() : 0);
+  writer = thread(&TrajectoryLogger::writerLoop, this);
+  return;
+}
+
+TrajectoryLogger::~TrajectoryLogger() {
+  {
+    lock_guard<mutex> lock(stop_mutex);
+    stop = true;
+  }
+  stop_cond.notify_one();
+  writer.join();
+
+  if (file) fclose(file);
+  return;
+}
+
+bool TrajectoryLogger::parseFormat(const string& name, Format& format) {
+  if (name == "tum") {
+    format = TUM;
+    return true;
+  } else if (name == "binary") {
+    format = BINARY;
+    return true;
+  }
+  return false;
+}
+
+bool TrajectoryLogger::log(const PoseRecord& pose) {
+  if (queue.push(pose)) return true;
+  ++dropped_num;
+  return false;
+}
+
+string TrajectoryLogger::fileName(const int& index) const {
+  return index == 0 ? path : path+"."+to_string(index);
+}
+
+int TrajectoryLogger::lastFileIndex() const {
+  int index = 0;
+  while (FILE* next = fopen(fileName(index+1).c_str(), "r")) {
+    fclose(next);
+    ++index;
+  }
+  return index;
+}
+
+bool TrajectoryLogger::openFile(const int& index) {
+  file = fopen(fileName(index).c_str(), format == TUM ? "a" : "ab");
+  if (!file) return false;
+
+  // The poses are appended to an existing file.
+  fseek(file, 0, SEEK_END);
+  file_size = ftell(file);
+  file_index = index;
+  return true;
+}
+
+void TrajectoryLogger::writerLoop() {
+  const auto period = chrono::duration<double>(flush_period);
+  unique_lock<mutex> lock(stop_mutex);
+  while (true) {
+    const bool is_stopping = stop_cond.wait_for(
+        lock, period, [this]() { return stop; });
+
+    // Poses pushed before the stop request are still written.
+    drain();
+    if (file) fflush(file);
+    if (is_stopping) return;
+  }
+}
+
+void TrajectoryLogger::drain() {
+  PoseRecord pose;
+  while (queue.pop(pose)) {
+    if (!file) continue;
+    if (max_file_size > 0 && file_size >= max_file_size) {
+      fclose(file);
+      if (!openFile(file_index+1)) {
+        is_open = false;
+        continue;
+      }
+    }
+    write(pose);
+  }
+  return;
+}
+
+void TrajectoryLogger::write(const PoseRecord& pose) {
+  int size = 0;
+  if (format == TUM) {
+    size = fprintf(file, "%.6f %.5f %.5f %.5f %.5f %.5f %.5f %.5f\n",
+        pose.time, pose.position[0], pose.position[1], pose.position[2],
+        pose.orientation[0], pose.orientation[1],
+        pose.orientation[2], pose.orientation[3]);
+  } else {
+    if (fwrite(&pose, sizeof(PoseRecord), 1, file) == 1)
+      size = sizeof(PoseRecord);
+  }
+  if (size > 0) file_size += size;
+  return;
+}
+
+} // namespace msckf_vio
@@ -0,0 +1,217 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <msckf_vio/undistortion_map.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+UndistortionMap::UndistortionMap():
+  resolution(0, 0),
+  intrinsics(1.0, 1.0, 0.0, 0.0),
+  equidistant(false),
+  distortion_coeffs(0.0, 0.0, 0.0, 0.0),
+  inv_cell_size(0.0f),
+  node_cols(0),
+  node_rows(0),
+  max_error(0.0) {
+  return;
+}
+
+inline void UndistortionMap::lookup(const float& u, const float& v,
+    float& x, float& y) const {
+  // The last nodes are at or past the border, so the upper
+  // left node of the cell is never in the last row or column.
+  const float col_f = u * inv_cell_size;
+  const float row_f = v * inv_cell_size;
+  const int col = static_cast<int>(col_f);
+  const int row = static_cast<int>(row_f);
+  const float a = col_f - col;
+  const float b = row_f - row;
+
+  const int k00 = row*node_cols + col;
+  const int k10 = k00 + node_cols;
+  const float w00 = (1.0f-a) * (1.0f-b);
+  const float w01 = a * (1.0f-b);
+  const float w10 = (1.0f-a) * b;
+  const float w11 = a * b;
+
+  const float* node00 = &table[2*k00];
+  const float* node10 = &table[2*k10];
+  x = w00*node00[0] + w01*node00[2] + w10*node10[0] + w11*node10[2];
+  y = w00*node00[1] + w01*node00[3] + w10*node10[1] + w11*node10[3];
+  return;
+}
+
+void UndistortionMap::initialize(const cv::Vec2i& cam_resolution,
+    const cv::Vec4d& cam_intrinsics,
+    const string& distortion_model,
+    const cv::Vec4d& cam_distortion_coeffs,
+    const int& cell_size) {
+  resolution = cam_resolution;
+  intrinsics = cam_intrinsics;
+  equidistant = distortion_model == "equidistant";
+  distortion_coeffs = cam_distortion_coeffs;
+
+  table.clear();
+  max_error = 0.0;
+  if (cell_size <= 0) return;
+
+  // Nodes up to the first one at or past the last pixel, so
+  // that every pixel in the image has four nodes around it.
+  inv_cell_size = 1.0f / cell_size;
+  node_cols = (resolution[0]-1)/cell_size + 2;
+  node_rows = (resolution[1]-1)/cell_size + 2;
+
+  vector<cv::Point2f> nodes(node_cols*node_rows);
+  for (int row = 0; row < node_rows; ++row)
+    for (int col = 0; col < node_cols; ++col)
+      nodes[row*node_cols+col] = cv::Point2f(col*cell_size, row*cell_size);
+
+  vector<cv::Point2f> nodes_undistorted;
+  undistortPointsIteratively(nodes, nodes_undistorted);
+  table.resize(2*nodes.size());
+  for (int i = 0; i < nodes.size(); ++i) {
+    table[2*i] = nodes_undistorted[i].x;
+    table[2*i+1] = nodes_undistorted[i].y;
+  }
+
+  // Compare the table against the iterative solution at the
+  // centers of all the cells, clamped into the image for the
+  // cells across the border.
+  const float max_u = resolution[0] - 1;
+  const float max_v = resolution[1] - 1;
+  vector<cv::Point2f> centers(0);
+  for (int row = 0; row < node_rows-1; ++row) {
+    for (int col = 0; col < node_cols-1; ++col) {
+      centers.push_back(cv::Point2f(
+          std::min((col+0.5f)*cell_size, max_u),
+          std::min((row+0.5f)*cell_size, max_v)));
+    }
+  }
+
+  vector<cv::Point2f> centers_undistorted;
+  undistortPointsIteratively(centers, centers_undistorted);
+  for (int i = 0; i < centers.size(); ++i) {
+    float x, y;
+    lookup(centers[i].x, centers[i].y, x, y);
+    const double error = sqrt(
+        pow((x-centers_undistorted[i].x)*intrinsics[0], 2) +
+        pow((y-centers_undistorted[i].y)*intrinsics[1], 2));
+    max_error = std::max(max_error, error);
+  }
+
+  return;
+}
+
+void UndistortionMap::undistortPoints(
+    const vector<cv::Point2f>& pts_in,
+    vector<cv::Point2f>& pts_out) const {
+  if (table.empty()) {
+    undistortPointsIteratively(pts_in, pts_out);
+    return;
+  }
+
+  pts_out.resize(pts_in.size());
+  const float max_u = resolution[0] - 1;
+  const float max_v = resolution[1] - 1;
+
+  // The pixels are clamped into the image so that the loop
+  // has no branch, and those out of the image are corrected
+  // afterwards.
+  for (int i = 0; i < pts_in.size(); ++i) {
+    const float u = std::min(std::max(pts_in[i].x, 0.0f), max_u);
+    const float v = std::min(std::max(pts_in[i].y, 0.0f), max_v);
+    lookup(u, v, pts_out[i].x, pts_out[i].y);
+  }
+
+  vector<int> outside_indices(0);
+  vector<cv::Point2f> outside_pts(0);
+  for (int i = 0; i < pts_in.size(); ++i) {
+    if (pts_in[i].x >= 0.0f && pts_in[i].x <= max_u &&
+        pts_in[i].y >= 0.0f && pts_in[i].y <= max_v) continue;
+    outside_indices.push_back(i);
+    outside_pts.push_back(pts_in[i]);
+  }
+  if (outside_pts.empty()) return;
+
+  vector<cv::Point2f> outside_pts_undistorted;
+  undistortPointsIteratively(outside_pts, outside_pts_undistorted);
+  for (int i = 0; i < outside_indices.size(); ++i)
+    pts_out[outside_indices[i]] = outside_pts_undistorted[i];
+
+  return;
+}
+
+void UndistortionMap::undistortPointsIteratively(
+    const vector<cv::Point2f>& pts_in,
+    vector<cv::Point2f>& pts_out) const {
+  pts_out.clear();
+  if (pts_in.size() == 0) return;
+
+  const cv::Matx33d K(
+      intrinsics[0], 0.0, intrinsics[2],
+      0.0, intrinsics[1], intrinsics[3],
+      0.0, 0.0, 1.0);
+
+  if (equidistant) {
+    cv::fisheye::undistortPoints(pts_in, pts_out, K, distortion_coeffs);
+  } else {
+    cv::undistortPoints(pts_in, pts_out, K, distortion_coeffs);
+  }
+
+  return;
+}
+
+void UndistortionMap::distortPoints(
+    const vector<cv::Point2f>& pts_in,
+    vector<cv::Point2f>& pts_out) const {
+  pts_out.resize(pts_in.size());
+  const double& k1 = distortion_coeffs[0];
+  const double& k2 = distortion_coeffs[1];
+  const double& k3 = distortion_coeffs[2];
+  const double& k4 = distortion_coeffs[3];
+
+  // The same models as cv::projectPoints with the coefficients
+  // (k1, k2, p1, p2) and cv::fisheye::distortPoints.
+  for (int i = 0; i < pts_in.size(); ++i) {
+    const double x = pts_in[i].x;
+    const double y = pts_in[i].y;
+    const double r2 = x*x + y*y;
+
+    double x_distorted, y_distorted;
+    if (equidistant) {
+      const double r = sqrt(r2);
+      const double theta = atan(r);
+      const double theta2 = theta * theta;
+      const double theta_distorted = theta * (1.0 + theta2*(
+            k1 + theta2*(k2 + theta2*(k3 + theta2*k4))));
+      const double scale = r > 1e-8 ? theta_distorted / r : 1.0;
+      x_distorted = x * scale;
+      y_distorted = y * scale;
+    } else {
+      const double& p1 = k3;
+      const double& p2 = k4;
+      const double radial = 1.0 + r2*(k1 + r2*k2);
+      x_distorted = x*radial + 2.0*p1*x*y + p2*(r2+2.0*x*x);
+      y_distorted = y*radial + p1*(r2+2.0*y*y) + 2.0*p2*x*y;
+    }
+
+    pts_out[i].x = intrinsics[0]*x_distorted + intrinsics[2];
+    pts_out[i].y = intrinsics[1]*y_distorted + intrinsics[3];
+  }
+
+  return;
+}
+
+} // namespace msckf_vio
@@ -11,10 +11,10 @@
 namespace msckf_vio {
 namespace utils {
 
-Eigen::Isometry3d getTransformEigen(const ros::NodeHandle &nh,
+Eigen::Isometry3d getTransformEigen(const ParameterReader &params,
                                     const std::string &field) {
   Eigen::Isometry3d T;
-  cv::Mat c = getTransformCV(nh, field);
+  cv::Mat c = getTransformCV(params, field);
 
   T.linear()(0, 0)   = c.at<double>(0, 0);
   T.linear()(0, 1)   = c.at<double>(0, 1);
@@ -31,18 +31,18 @@ Eigen::Isometry3d getTransformEigen(const ros::NodeHandle &nh,
   return T;
 }
 
-cv::Mat getTransformCV(const ros::NodeHandle &nh,
+cv::Mat getTransformCV(const ParameterReader &params,
                        const std::string &field) {
   cv::Mat T;
   try {
     // first try reading kalibr format
-    T = getKalibrStyleTransform(nh, field);
+    T = getKalibrStyleTransform(params, field);
   } catch (std::runtime_error &e) {
     // maybe it's the old style format?
     ROS_DEBUG_STREAM("cannot read transform " << field
                      << " in kalibr format, trying old one!");
     try {
-      T = getVec16Transform(nh, field);
+      T = getVec16Transform(params, field);
     } catch (std::runtime_error &e) {
       std::string msg = "cannot read transform " + field + " error: " + e.what();
       ROS_ERROR_STREAM(msg);
@@ -52,10 +52,10 @@ cv::Mat getTransformCV(const ros::NodeHandle &nh,
   return T;
 }
 
-cv::Mat getVec16Transform(const ros::NodeHandle &nh,
+cv::Mat getVec16Transform(const ParameterReader &params,
                           const std::string &field) {
   std::vector<double> v;
-  nh.getParam(field, v);
+  params.getParam(field, v);
   if (v.size() != 16) {
     throw std::runtime_error("invalid vec16!");
   }
@@ -63,26 +63,22 @@ cv::Mat getVec16Transform(const ros::NodeHandle &nh,
   return T;
 }
 
-cv::Mat getKalibrStyleTransform(const ros::NodeHandle &nh,
+cv::Mat getKalibrStyleTransform(const ParameterReader &params,
                                 const std::string &field) {
   cv::Mat T = cv::Mat::eye(4, 4, CV_64FC1);
-  XmlRpc::XmlRpcValue lines;
-  if (!nh.getParam(field, lines)) {
+  std::vector<std::vector<double> > lines;
+  if (!params.getParam(field, lines)) {
     throw (std::runtime_error("cannot find transform " + field));
   }
-  if (lines.size() != 4 || lines.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+  if (lines.size() != 4) {
     throw (std::runtime_error("invalid transform " + field));
   }
   for (int i = 0; i < lines.size(); i++) {
-    if (lines.size() != 4 || lines.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+    if (lines[i].size() != 4) {
       throw (std::runtime_error("bad line for transform " + field));
     }
     for (int j = 0; j < lines[i].size(); j++) {
-      if (lines[i][j].getType() != XmlRpc::XmlRpcValue::TypeDouble) {
-        throw (std::runtime_error("bad value for transform " + field));
-      } else {
-        T.at<double>(i,j) = static_cast<double>(lines[i][j]);
-      }
+      T.at<double>(i,j) = lines[i][j];
     }
   }
   return T;
@@ -0,0 +1,24 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <ros/ros.h>
+#include <benchmark/benchmark.h>
+
+/*
+ * The kernels run on synthetic data, and the filter and the image
+ * processor are constructed without a node handle, so no master
+ * is needed.
+ */
+int main(int argc, char** argv) {
+  // Only the clock used by the throttled logs.
+  ros::Time::init();
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <iterator>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/cam_state.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(CamStateServerTest, slotsAreStable) {
+  CamStateServer cam_states;
+  cam_states.reserve(4);
+
+  for (int i = 0; i < 4; ++i)
+    cam_states[i] = CAMState(i);
+  EXPECT_EQ(cam_states.size(), 4);
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(cam_states.slot(i), i);
+
+  // Erasing a state frees its slot without moving the others.
+  EXPECT_EQ(cam_states.erase(1), 1);
+  EXPECT_EQ(cam_states.erase(1), 0);
+  EXPECT_EQ(cam_states.slot(1), -1);
+  EXPECT_EQ(cam_states.slot(2), 2);
+  EXPECT_TRUE(cam_states.find(1) == cam_states.end());
+
+  // The free slot is reused by the next state.
+  cam_states[4] = CAMState(4);
+  EXPECT_EQ(cam_states.slot(4), 1);
+  EXPECT_EQ(cam_states.capacity(), 4);
+
+  // Iteration is in the order of the ids.
+  vector<StateIDType> ids;
+  for (const auto& item : cam_states) {
+    EXPECT_EQ(item.first, item.second.id);
+    ids.push_back(item.first);
+  }
+  EXPECT_EQ(ids, vector<StateIDType>({0, 2, 3, 4}));
+
+  auto last = cam_states.end();
+  --last;
+  EXPECT_EQ(last->first, 4);
+  EXPECT_EQ(std::distance(cam_states.begin(), cam_states.find(3)), 2);
+  EXPECT_EQ(cam_states.find(3).slot(), 3);
+}
+
+TEST(CamStateServerTest, growAndClear) {
+  CamStateServer cam_states;
+  for (int i = 0; i < 100; ++i) {
+    cam_states[i] = CAMState(i);
+    // Keep a sliding window of 10 states.
+    if (i >= 10) cam_states.erase(i-10);
+  }
+  EXPECT_EQ(cam_states.size(), 10);
+  EXPECT_LE(cam_states.capacity(), 16);
+  for (int i = 90; i < 100; ++i) {
+    ASSERT_GE(cam_states.slot(i), 0);
+    EXPECT_EQ(cam_states.find(i)->second.id, i);
+  }
+
+  cam_states.clear();
+  EXPECT_TRUE(cam_states.empty());
+  EXPECT_EQ(cam_states.slot(95), -1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <string>
+#include <fstream>
+#include <sys/stat.h>
+#include <gtest/gtest.h>
+#include <msckf_vio/dataset.h>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+void makeDirs(const string& path) {
+  for (size_t i = 1; i <= path.size(); ++i) {
+    if (i == path.size() || path[i] == '/')
+      mkdir(path.substr(0, i).c_str(), 0755);
+  }
+  return;
+}
+
+void writeFile(const string& file_name, const string& content) {
+  ofstream file(file_name);
+  file << content;
+  return;
+}
+
+TEST(DatasetTest, loadEuroc) {
+  const string path = string(testing::TempDir()) + "euroc_test";
+  makeDirs(path+"/mav0/imu0");
+  makeDirs(path+"/mav0/cam0");
+  makeDirs(path+"/mav0/cam1");
+  makeDirs(path+"/mav0/state_groundtruth_estimate0");
+
+  writeFile(path+"/mav0/imu0/data.csv",
+      "#timestamp [ns],w_RS_S_x [rad s^-1],w_RS_S_y [rad s^-1],"
+      "w_RS_S_z [rad s^-1],a_RS_S_x [m s^-2],a_RS_S_y [m s^-2],"
+      "a_RS_S_z [m s^-2]\r\n"
+      "1403636579758555392,-0.1,0.2,0.3,8.1,-0.2,-3.5\r\n"
+      "1403636579763555584,-0.1,0.2,0.3,8.2,-0.3,-3.4\r\n");
+  // The right camera misses the second image.
+  writeFile(path+"/mav0/cam0/data.csv",
+      "#timestamp [ns],filename\n"
+      "1403636579763555584,1403636579763555584.png\n"
+      "1403636579813555456,1403636579813555456.png\n"
+      "1403636579863555584,1403636579863555584.png\n");
+  writeFile(path+"/mav0/cam1/data.csv",
+      "#timestamp [ns],filename\n"
+      "1403636579763555584,1403636579763555584.png\n"
+      "1403636579863555584,1403636579863555584.png\n");
+  writeFile(path+"/mav0/state_groundtruth_estimate0/data.csv",
+      "#timestamp, p_RS_R_x [m], p_RS_R_y [m], p_RS_R_z [m], q_RS_w [],"
+      " q_RS_x [], q_RS_y [], q_RS_z []\n"
+      "1403636580838555648,4.688,-1.786,0.783,0.534,-0.153,-0.827,-0.082\n");
+
+  Dataset dataset;
+  ASSERT_TRUE(dataset.loadEuroc(path));
+  ASSERT_EQ(dataset.imu.size(), 2);
+  EXPECT_NEAR(dataset.imu[0].time, 1403636579.758555392, 1e-6);
+  EXPECT_DOUBLE_EQ(dataset.imu[1].linear_acceleration(0), 8.2);
+  EXPECT_DOUBLE_EQ(dataset.imu[1].angular_velocity(2), 0.3);
+
+  ASSERT_EQ(dataset.frames.size(), 2);
+  EXPECT_NEAR(dataset.frames[1].time, 1403636579.863555584, 1e-6);
+  EXPECT_EQ(dataset.frames[1].cam1_file,
+      path+"/mav0/cam1/data/1403636579863555584.png");
+
+  ASSERT_EQ(dataset.ground_truth.size(), 1);
+  EXPECT_DOUBLE_EQ(dataset.ground_truth[0].position(1), -1.786);
+  const Quaterniond q(dataset.ground_truth[0].rotation);
+  EXPECT_NEAR(std::abs(q.dot(Quaterniond(
+            0.534, -0.153, -0.827, -0.082).normalized())), 1.0, 1e-9);
+}
+
+TEST(DatasetTest, loadKittiRaw) {
+  const string path = string(testing::TempDir()) + "kitti_test";
+  makeDirs(path+"/image_00/data");
+  makeDirs(path+"/image_01/data");
+  makeDirs(path+"/oxts/data");
+
+  const string image_times =
+    "2011-09-26 13:02:25.964389445\n"
+    "2011-09-26 13:02:26.068212264\n";
+  writeFile(path+"/image_00/timestamps.txt", image_times);
+  writeFile(path+"/image_01/timestamps.txt", image_times);
+  writeFile(path+"/oxts/timestamps.txt",
+      "2011-09-26 13:02:25.951199337\n"
+      "2011-09-26 13:02:25.961279025\n");
+
+  // lat lon alt roll pitch yaw vn ve vf vl vu ax ay az af al au
+  // wx wy wz wf wl wu and the accuracy fields.
+  const string oxts_fields =
+    " 0.1 0.2 1.57 1 2 3 4 5 0.5 0.6 9.8 0.5 0.6 9.8"
+    " 0.01 0.02 0.03 0.01 0.02 0.03 0.1 0.1 4 10 4 4 4\n";
+  writeFile(path+"/oxts/data/0000000000.txt",
+      "49.015003823272 8.4343977778243 116.43 " + oxts_fields);
+  writeFile(path+"/oxts/data/0000000001.txt",
+      "49.015004823272 8.4343977778243 116.43 " + oxts_fields);
+
+  Dataset dataset;
+  ASSERT_TRUE(dataset.loadKittiRaw(path, path));
+  ASSERT_EQ(dataset.frames.size(), 2);
+  // 2011-09-26 13:02:26 UTC
+  EXPECT_NEAR(dataset.frames[1].time, 1317042146.068212264, 1e-6);
+  EXPECT_EQ(dataset.frames[0].cam0_file,
+      path+"/image_00/data/0000000000.png");
+
+  ASSERT_EQ(dataset.imu.size(), 2);
+  EXPECT_DOUBLE_EQ(dataset.imu[0].linear_acceleration(2), 9.8);
+  EXPECT_DOUBLE_EQ(dataset.imu[0].angular_velocity(1), 0.02);
+
+  // 1e-6 degree of latitude is about 11cm to the north.
+  ASSERT_EQ(dataset.ground_truth.size(), 2);
+  const Vector3d dp = dataset.ground_truth[1].position -
+    dataset.ground_truth[0].position;
+  EXPECT_NEAR(dp(0), 0.0, 1e-6);
+  EXPECT_NEAR(dp(1), 6378137.0*1e-6*M_PI/180.0, 1e-4);
+
+  // The x axis of the IMU points forward with the given yaw and pitch.
+  const Vector3d heading = dataset.ground_truth[0].rotation * Vector3d::UnitX();
+  EXPECT_TRUE(heading.isApprox(Vector3d(
+          cos(1.57)*cos(0.2), sin(1.57)*cos(0.2), -sin(0.2)), 1e-9));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -24,12 +24,6 @@ using namespace std;
 using namespace Eigen;
 using namespace msckf_vio;
 
-// Static member variables in CAMState class
-Isometry3d CAMState::T_cam0_cam1 = Isometry3d::Identity();
-
-// Static member variables in Feature class
-Feature::OptimizationConfig Feature::optimization_config;
-
 TEST(FeatureInitializeTest, sphereDistribution) {
   // Set the real feature at the origin of the world frame.
   Vector3d feature(0.5, 0.0, 0.0);
@@ -107,7 +101,9 @@ TEST(FeatureInitializeTest, sphereDistribution) {
     feature_object.observations[i] = measurements[i];
 
   // Compute the 3d position of the feature.
-  feature_object.initializePosition(cam_states);
+  const Isometry3d T_cam0_cam1 = Isometry3d::Identity();
+  const Feature::OptimizationConfig config;
+  feature_object.initializePosition(cam_states, T_cam0_cam1, config);
 
   // Check the difference between the computed 3d
   // feature position and the groud truth.
@@ -115,6 +111,16 @@ TEST(FeatureInitializeTest, sphereDistribution) {
   cout << "estimated position: " << feature_object.position.transpose() << endl;
   Eigen::Vector3d error = feature_object.position - feature;
   EXPECT_NEAR(error.norm(), 0, 0.05);
+
+  // Camera poses computed in advance give the same result.
+  CameraPoses all_cam_poses;
+  all_cam_poses.compute(cam_states, T_cam0_cam1);
+  Feature shared_pose_feature = feature_object;
+  shared_pose_feature.is_initialized = false;
+  EXPECT_TRUE(shared_pose_feature.initializePosition(
+        cam_states, all_cam_poses, config));
+  EXPECT_TRUE(shared_pose_feature.is_initialized);
+  EXPECT_EQ(shared_pose_feature.position, feature_object.position);
 }
 
 int main(int argc, char** argv) {
@@ -0,0 +1,320 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+#include <benchmark/benchmark.h>
+
+#include <msckf_vio/image_processor.h>
+
+using namespace std;
+
+namespace msckf_vio {
+
+/*
+ * @brief ImageProcessorBenchmark An image processor with the
+ *    EuRoC cam0 calibration used for both cameras, which are
+ *    11cm apart, and a textured stereo pair of a wall 5m away.
+ */
+class ImageProcessorBenchmark {
+  public:
+    ImageProcessorBenchmark(const string& distortion_model);
+
+    void undistortPoints(const vector<cv::Point2f>& pts_in,
+        vector<cv::Point2f>& pts_out) {
+      processor.cam0_undistortion_map.undistortPoints(pts_in, pts_out);
+    }
+    void undistortPointsIteratively(const vector<cv::Point2f>& pts_in,
+        vector<cv::Point2f>& pts_out) {
+      processor.cam0_undistortion_map.undistortPointsIteratively(
+          pts_in, pts_out);
+    }
+    void twoPointRansac(const vector<cv::Point2f>& pts1,
+        const vector<cv::Point2f>& pts2, const cv::Matx33f& R_p_c,
+        const bool& adaptive_termination, vector<int>& inlier_markers) {
+      processor.twoPointRansac(pts1, pts2, R_p_c,
+          processor.cam0_intrinsics,
+          processor.processor_config.ransac_threshold, 0.99,
+          adaptive_termination, inlier_markers);
+    }
+    void createImagePyramids() {
+      processor.createImagePyramids();
+    }
+    void setTrackingThreadNum(const int& thread_num) {
+      processor.tracking_pool.reset(new ThreadPool(thread_num));
+    }
+    void stereoMatch(const vector<cv::Point2f>& cam0_points,
+        vector<cv::Point2f>& cam1_points,
+        vector<unsigned char>& inlier_markers) {
+      processor.stereoMatch(cam0_points, cam1_points, inlier_markers,
+          cam0_points_undistorted, cam1_points_undistorted);
+    }
+
+    // Project points in the camera frame to the cam0 image.
+    vector<cv::Point2f> project(const vector<cv::Point3f>& points) {
+      vector<cv::Point2f> normalized_points;
+      for (const auto& point : points)
+        normalized_points.push_back(
+            cv::Point2f(point.x/point.z, point.y/point.z));
+      vector<cv::Point2f> pixels;
+      processor.cam0_undistortion_map.distortPoints(
+          normalized_points, pixels);
+      return pixels;
+    }
+
+    // The strongest FAST corners on the cam0 image.
+    vector<cv::Point2f> detectCorners(const int& corner_num) const;
+
+    // Fill the first grids with the minimum number of features
+    // and empty the others.
+    void fillGrids(const int& full_grid_num);
+    void addNewFeatures() {
+      processor.addNewFeatures();
+    }
+
+  private:
+    ImageProcessor processor;
+    vector<cv::Point2f> cam0_points_undistorted;
+    vector<cv::Point2f> cam1_points_undistorted;
+};
+
+ImageProcessorBenchmark::ImageProcessorBenchmark(
+    const string& distortion_model) {
+  processor.cam0_distortion_model = distortion_model;
+  processor.cam0_resolution = cv::Vec2i(752, 480);
+  processor.cam0_intrinsics = cv::Vec4d(458.654, 457.296, 367.215, 248.375);
+  processor.cam0_distortion_coeffs = distortion_model == "equidistant" ?
+    cv::Vec4d(-0.0132, 0.0223, -0.0214, 0.0075) :
+    cv::Vec4d(-0.28340811, 0.07395907, 0.00019359, 1.76187114e-05);
+  processor.cam1_distortion_model = processor.cam0_distortion_model;
+  processor.cam1_resolution = processor.cam0_resolution;
+  processor.cam1_intrinsics = processor.cam0_intrinsics;
+  processor.cam1_distortion_coeffs = processor.cam0_distortion_coeffs;
+
+  processor.R_cam0_imu = cv::Matx33d::eye();
+  processor.t_cam0_imu = cv::Vec3d(0.0, 0.0, 0.0);
+  processor.R_cam1_imu = cv::Matx33d::eye();
+  processor.t_cam1_imu = cv::Vec3d(0.11, 0.0, 0.0);
+
+  // Parameters of the EuRoC configuration.
+  processor.processor_config.grid_row = 4;
+  processor.processor_config.grid_col = 5;
+  processor.processor_config.grid_min_feature_num = 3;
+  processor.processor_config.grid_max_feature_num = 6;
+  processor.processor_config.fast_threshold = 10;
+  processor.processor_config.pyramid_levels = 3;
+  processor.processor_config.patch_size = 15;
+  processor.processor_config.max_iteration = 30;
+  processor.processor_config.track_precision = 0.01;
+  processor.processor_config.ransac_threshold = 3;
+  processor.processor_config.ransac_adaptive_termination = true;
+  processor.processor_config.stereo_threshold = 5;
+  processor.processor_config.undistortion_cell_size = 4;
+  processor.createUndistortionMaps();
+
+  // Blurred noise as the texture. The disparity of the wall
+  // is 458.654*0.11/5 = 10 pixels.
+  cv::Mat noise(480, 752, CV_8U);
+  cv::RNG rng(0);
+  rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+  cv::Mat cam0_img;
+  cv::GaussianBlur(noise, cam0_img, cv::Size(0, 0), 2.0);
+  cv::normalize(cam0_img, cam0_img, 0, 255, cv::NORM_MINMAX);
+  const cv::Matx23d shift(1.0, 0.0, 10.0, 0.0, 1.0, 0.0);
+  cv::Mat cam1_img;
+  cv::warpAffine(cam0_img, cam1_img, shift, cam0_img.size(),
+      cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REFLECT_101);
+
+  std_msgs::Header header;
+  processor.cam0_curr_img_ptr.reset(new cv_bridge::CvImage(
+        header, sensor_msgs::image_encodings::MONO8, cam0_img));
+  processor.cam1_curr_img_ptr.reset(new cv_bridge::CvImage(
+        header, sensor_msgs::image_encodings::MONO8, cam1_img));
+  processor.createImagePyramids();
+  return;
+}
+
+vector<cv::Point2f> ImageProcessorBenchmark::detectCorners(
+    const int& corner_num) const {
+  vector<cv::KeyPoint> keypoints;
+  cv::FAST(processor.cam0_curr_img_ptr->image, keypoints, 10);
+  sort(keypoints.begin(), keypoints.end(),
+      &ImageProcessor::keyPointCompareByResponse);
+
+  // Keep the corners away from the border, where the
+  // right image has no match.
+  vector<cv::Point2f> corners;
+  for (const auto& keypoint : keypoints) {
+    if (corners.size() == corner_num) break;
+    if (keypoint.pt.x < 30 || keypoint.pt.x > 722 ||
+        keypoint.pt.y < 30 || keypoint.pt.y > 450) continue;
+    corners.push_back(keypoint.pt);
+  }
+  return corners;
+}
+
+void ImageProcessorBenchmark::fillGrids(const int& full_grid_num) {
+  const ImageProcessor::ProcessorConfig& config = processor.processor_config;
+  const int grid_height = 480 / config.grid_row;
+  const int grid_width = 752 / config.grid_col;
+
+  ImageProcessor::GridFeatures& features = *processor.curr_features_ptr;
+  for (int code = 0; code < config.grid_row*config.grid_col; ++code) {
+    features[code].clear();
+    if (code >= full_grid_num) continue;
+    for (int i = 0; i < config.grid_min_feature_num; ++i) {
+      ImageProcessor::FeatureMetaData feature;
+      feature.cam0_point = cv::Point2f(
+          (code%config.grid_col)*grid_width + 10*(i+1),
+          (code/config.grid_col)*grid_height + grid_height/2);
+      features[code].push_back(feature);
+    }
+  }
+  return;
+}
+
+} // namespace msckf_vio
+
+using namespace msckf_vio;
+
+namespace {
+
+const char* distortionModel(const int64_t& index) {
+  return index == 0 ? "radtan" : "equidistant";
+}
+
+// Random points within the field of view of cam0.
+vector<cv::Point2f> randomPixels(const int& point_num) {
+  mt19937 generator(0);
+  uniform_real_distribution<float> x(0.0f, 751.0f);
+  uniform_real_distribution<float> y(0.0f, 479.0f);
+  vector<cv::Point2f> pixels(point_num);
+  for (auto& pixel : pixels)
+    pixel = cv::Point2f(x(generator), y(generator));
+  return pixels;
+}
+
+// Undistortion with the iterative solution (0) or the table (1).
+void BM_UndistortPoints(benchmark::State& state) {
+  ImageProcessorBenchmark processor(distortionModel(state.range(1)));
+  const vector<cv::Point2f> pixels = randomPixels(state.range(0));
+  vector<cv::Point2f> undistorted_pixels;
+  for (auto _ : state) {
+    if (state.range(2) == 0)
+      processor.undistortPointsIteratively(pixels, undistorted_pixels);
+    else
+      processor.undistortPoints(pixels, undistorted_pixels);
+    benchmark::DoNotOptimize(undistorted_pixels.data());
+  }
+  state.SetItemsProcessed(state.iterations() * pixels.size());
+}
+BENCHMARK(BM_UndistortPoints)
+  ->Args({100, 0, 0})->Args({400, 0, 0})->Args({100, 1, 0})->Args({400, 1, 0})
+  ->Args({100, 0, 1})->Args({400, 0, 1})->Args({100, 1, 1})->Args({400, 1, 1});
+
+// Points tracked between two frames 5cm apart with a small
+// rotation, of which 10% are outliers, with the fixed (0) or
+// the adaptive (1) number of iterations.
+void BM_TwoPointRansac(benchmark::State& state) {
+  ImageProcessorBenchmark processor(distortionModel(state.range(1)));
+  const int point_num = state.range(0);
+
+  mt19937 generator(0);
+  uniform_real_distribution<float> lateral(-4.0f, 4.0f);
+  uniform_real_distribution<float> depth(3.0f, 10.0f);
+  uniform_real_distribution<float> outlier_offset(-20.0f, 20.0f);
+
+  const cv::Vec3f rotation_vector(0.01f, -0.02f, 0.005f);
+  cv::Matx33f R_p_c;
+  cv::Rodrigues(rotation_vector, R_p_c);
+  const cv::Vec3f t_p_c(0.03f, 0.01f, -0.04f);
+
+  vector<cv::Point3f> prev_points(point_num);
+  vector<cv::Point3f> curr_points(point_num);
+  for (int i = 0; i < point_num; ++i) {
+    const float z = depth(generator);
+    prev_points[i] = cv::Point3f(
+        lateral(generator)*z/8.0f, 0.6f*lateral(generator)*z/8.0f, z);
+    const cv::Vec3f curr_point =
+      R_p_c*cv::Vec3f(prev_points[i].x, prev_points[i].y, z) + t_p_c;
+    curr_points[i] = cv::Point3f(curr_point[0], curr_point[1], curr_point[2]);
+  }
+
+  const vector<cv::Point2f> prev_pixels = processor.project(prev_points);
+  vector<cv::Point2f> curr_pixels = processor.project(curr_points);
+  for (int i = 0; i < point_num; i += 10) {
+    curr_pixels[i].x += outlier_offset(generator);
+    curr_pixels[i].y += outlier_offset(generator);
+  }
+
+  // The points are undistorted by the stereo matching.
+  vector<cv::Point2f> prev_points_undistorted;
+  vector<cv::Point2f> curr_points_undistorted;
+  processor.undistortPoints(prev_pixels, prev_points_undistorted);
+  processor.undistortPoints(curr_pixels, curr_points_undistorted);
+
+  vector<int> inlier_markers;
+  for (auto _ : state) {
+    processor.twoPointRansac(prev_points_undistorted,
+        curr_points_undistorted, R_p_c, state.range(2) != 0,
+        inlier_markers);
+    benchmark::DoNotOptimize(inlier_markers.data());
+  }
+  state.SetItemsProcessed(state.iterations() * point_num);
+}
+BENCHMARK(BM_TwoPointRansac)
+  ->Args({50, 0, 1})->Args({100, 0, 1})->Args({200, 0, 1})->Args({400, 0, 1})
+  ->Args({200, 1, 1})->Args({200, 0, 0});
+
+// Pyramids of both cameras, which are built one after the
+// other with a single thread.
+void BM_CreateImagePyramids(benchmark::State& state) {
+  ImageProcessorBenchmark processor("radtan");
+  processor.setTrackingThreadNum(state.range(0));
+  for (auto _ : state) processor.createImagePyramids();
+}
+BENCHMARK(BM_CreateImagePyramids)->Arg(1)->Arg(2)
+  ->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// Detection and stereo matching of new features, with the
+// given number of the 20 grids already full.
+void BM_AddNewFeatures(benchmark::State& state) {
+  ImageProcessorBenchmark processor("radtan");
+  for (auto _ : state) {
+    state.PauseTiming();
+    processor.fillGrids(state.range(0));
+    state.ResumeTiming();
+    processor.addNewFeatures();
+  }
+}
+BENCHMARK(BM_AddNewFeatures)->Arg(0)->Arg(10)->Arg(18)
+  ->Unit(benchmark::kMicrosecond);
+
+// Stereo matching of FAST corners, with the initial guess in
+// the right image computed from the extrinsics.
+void BM_StereoMatch(benchmark::State& state) {
+  ImageProcessorBenchmark processor(distortionModel(state.range(1)));
+  const vector<cv::Point2f> cam0_points =
+    processor.detectCorners(state.range(0));
+  vector<cv::Point2f> cam1_points;
+  vector<unsigned char> inlier_markers;
+  for (auto _ : state) {
+    cam1_points.clear();
+    processor.stereoMatch(cam0_points, cam1_points, inlier_markers);
+    benchmark::DoNotOptimize(inlier_markers.data());
+  }
+  state.SetItemsProcessed(state.iterations() * cam0_points.size());
+}
+BENCHMARK(BM_StereoMatch)
+  ->Args({50, 0})->Args({100, 0})->Args({200, 0})->Args({400, 0})
+  ->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,468 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <random_numbers/random_numbers.h>
+
+#include <msckf_vio/image_processor.h>
+
+using namespace std;
+using namespace cv;
+using namespace Eigen;
+
+namespace {
+
+const double inlier_error = 3.0;
+const double success_probability = 0.99;
+const int fast_threshold = 10;
+
+} // namespace
+
+namespace msckf_vio {
+
+/*
+ * @brief ImageProcessorTester Exposes the private functions of the
+ *    image processor to the tests.
+ */
+class ImageProcessorTester {
+  public:
+    ImageProcessorTester() {
+      return;
+    }
+
+    void twoPointRansac(
+        const vector<Point2f>& pts1, const vector<Point2f>& pts2,
+        const Matx33f& R_p_c, const Vec4d& intrinsics,
+        const bool& adaptive_termination,
+        vector<int>& inlier_markers) {
+      processor.twoPointRansac(pts1, pts2, R_p_c, intrinsics,
+          inlier_error, success_probability,
+          adaptive_termination, inlier_markers);
+      return;
+    }
+
+    /*
+     * @brief referenceTwoPointRansac The RANSAC with a fixed number
+     *    of iterations as it was before the early exits, with the
+     *    same seed. The points are undistorted already.
+     */
+    void referenceTwoPointRansac(
+        const vector<Point2f>& pts1, const vector<Point2f>& pts2,
+        const Matx33f& R_p_c, const Vec4d& intrinsics,
+        vector<int>& inlier_markers) {
+      double norm_pixel_unit = 2.0 / (intrinsics[0]+intrinsics[1]);
+      const int iter_num = static_cast<int>(
+          ceil(log(1-success_probability) / log(1-0.7*0.7)));
+
+      inlier_markers.clear();
+      inlier_markers.resize(pts1.size(), 1);
+
+      vector<Point2f> pts1_rotated(pts1);
+      vector<Point2f> pts2_rotated(pts2);
+      for (auto& pt : pts1_rotated) {
+        Vec3f pt_hc = R_p_c * Vec3f(pt.x, pt.y, 1.0f);
+        pt.x = pt_hc[0];
+        pt.y = pt_hc[1];
+      }
+
+      float scaling_factor = 0.0f;
+      processor.rescalePoints(pts1_rotated, pts2_rotated, scaling_factor);
+      norm_pixel_unit *= scaling_factor;
+
+      vector<Point2d> pts_diff(pts1_rotated.size());
+      for (int i = 0; i < pts1_rotated.size(); ++i)
+        pts_diff[i] = pts1_rotated[i] - pts2_rotated[i];
+
+      double mean_pt_distance = 0.0;
+      int raw_inlier_cntr = 0;
+      for (int i = 0; i < pts_diff.size(); ++i) {
+        double distance = sqrt(pts_diff[i].dot(pts_diff[i]));
+        if (distance > 50.0*norm_pixel_unit) {
+          inlier_markers[i] = 0;
+        } else {
+          mean_pt_distance += distance;
+          ++raw_inlier_cntr;
+        }
+      }
+      mean_pt_distance /= raw_inlier_cntr;
+
+      if (raw_inlier_cntr < 3) {
+        for (auto& marker : inlier_markers) marker = 0;
+        return;
+      }
+
+      if (mean_pt_distance < norm_pixel_unit) {
+        for (int i = 0; i < pts_diff.size(); ++i) {
+          if (inlier_markers[i] == 0) continue;
+          if (sqrt(pts_diff[i].dot(pts_diff[i])) >
+              inlier_error*norm_pixel_unit)
+            inlier_markers[i] = 0;
+        }
+        return;
+      }
+
+      MatrixXd coeff_t(pts_diff.size(), 3);
+      for (int i = 0; i < pts_diff.size(); ++i) {
+        coeff_t(i, 0) = pts_diff[i].y;
+        coeff_t(i, 1) = -pts_diff[i].x;
+        coeff_t(i, 2) = pts1_rotated[i].x*pts2_rotated[i].y -
+          pts1_rotated[i].y*pts2_rotated[i].x;
+      }
+
+      vector<int> raw_inlier_idx;
+      for (int i = 0; i < inlier_markers.size(); ++i) {
+        if (inlier_markers[i] != 0)
+          raw_inlier_idx.push_back(i);
+      }
+
+      vector<int> best_inlier_set;
+      random_numbers::RandomNumberGenerator random_gen(0);
+
+      for (int iter_idx = 0; iter_idx < iter_num; ++iter_idx) {
+        int select_idx1 = random_gen.uniformInteger(
+            0, raw_inlier_idx.size()-1);
+        int select_idx_diff = random_gen.uniformInteger(
+            1, raw_inlier_idx.size()-1);
+        int select_idx2 = select_idx1+select_idx_diff<raw_inlier_idx.size() ?
+          select_idx1+select_idx_diff :
+          select_idx1+select_idx_diff-raw_inlier_idx.size();
+
+        int pair_idx1 = raw_inlier_idx[select_idx1];
+        int pair_idx2 = raw_inlier_idx[select_idx2];
+
+        Vector2d coeff_tx(coeff_t(pair_idx1, 0), coeff_t(pair_idx2, 0));
+        Vector2d coeff_ty(coeff_t(pair_idx1, 1), coeff_t(pair_idx2, 1));
+        Vector2d coeff_tz(coeff_t(pair_idx1, 2), coeff_t(pair_idx2, 2));
+        vector<double> coeff_l1_norm(3);
+        coeff_l1_norm[0] = coeff_tx.lpNorm<1>();
+        coeff_l1_norm[1] = coeff_ty.lpNorm<1>();
+        coeff_l1_norm[2] = coeff_tz.lpNorm<1>();
+        int base_indicator = min_element(coeff_l1_norm.begin(),
+            coeff_l1_norm.end())-coeff_l1_norm.begin();
+
+        Vector3d model(0.0, 0.0, 0.0);
+        if (base_indicator == 0) {
+          Matrix2d A;
+          A << coeff_ty, coeff_tz;
+          Vector2d solution = A.inverse() * (-coeff_tx);
+          model(0) = 1.0;
+          model(1) = solution(0);
+          model(2) = solution(1);
+        } else if (base_indicator ==1) {
+          Matrix2d A;
+          A << coeff_tx, coeff_tz;
+          Vector2d solution = A.inverse() * (-coeff_ty);
+          model(0) = solution(0);
+          model(1) = 1.0;
+          model(2) = solution(1);
+        } else {
+          Matrix2d A;
+          A << coeff_tx, coeff_ty;
+          Vector2d solution = A.inverse() * (-coeff_tz);
+          model(0) = solution(0);
+          model(1) = solution(1);
+          model(2) = 1.0;
+        }
+
+        VectorXd error = coeff_t * model;
+
+        vector<int> inlier_set;
+        for (int i = 0; i < error.rows(); ++i) {
+          if (inlier_markers[i] == 0) continue;
+          if (std::abs(error(i)) < inlier_error*norm_pixel_unit)
+            inlier_set.push_back(i);
+        }
+
+        if (inlier_set.size() < 0.2*pts1_rotated.size())
+          continue;
+
+        if (inlier_set.size() > best_inlier_set.size())
+          best_inlier_set = inlier_set;
+      }
+
+      inlier_markers.clear();
+      inlier_markers.resize(pts1.size(), 0);
+      for (const auto& inlier_idx : best_inlier_set)
+        inlier_markers[inlier_idx] = 1;
+      return;
+    }
+
+    /*
+     * @brief detectGridFeatures Detects the new features of every
+     *    grid as addNewFeatures does, around the given features.
+     * @return grid_features: the new features of each grid.
+     */
+    void detectGridFeatures(const Mat& img, const int& grid_row,
+        const int& grid_col, const int& grid_max_feature_num,
+        const vector<Point2f>& features,
+        vector<vector<KeyPoint> >& grid_features) {
+      processor.processor_config.grid_row = grid_row;
+      processor.processor_config.grid_col = grid_col;
+      processor.processor_config.grid_max_feature_num =
+        grid_max_feature_num;
+      processor.processor_config.fast_threshold = fast_threshold;
+
+      processor.curr_features_ptr->clear();
+      for (const auto& feature : features) {
+        ImageProcessor::FeatureMetaData feature_data;
+        feature_data.cam0_point = feature;
+        (*processor.curr_features_ptr)[0].push_back(feature_data);
+      }
+
+      const int grid_height = img.rows / grid_row;
+      const int grid_width = img.cols / grid_col;
+      processor.feature_occupancy.assign(img.total(), 0);
+      processor.markFeatureOccupancy(img.rows, img.cols, 1);
+
+      grid_features.resize(grid_row*grid_col);
+      vector<KeyPoint> keypoints;
+      for (int code = 0; code < grid_row*grid_col; ++code) {
+        const Rect grid((code%grid_col)*grid_width,
+            (code/grid_col)*grid_height, grid_width, grid_height);
+        processor.detectGridFeatures(
+            img, grid, keypoints, grid_features[code]);
+      }
+
+      processor.markFeatureOccupancy(img.rows, img.cols, 0);
+      occupancy_cleared = std::count(processor.feature_occupancy.begin(),
+          processor.feature_occupancy.end(), 0) == img.total();
+      return;
+    }
+
+    bool occupancy_cleared;
+
+  private:
+    ImageProcessor processor;
+};
+
+} // namespace msckf_vio
+
+using namespace msckf_vio;
+
+namespace {
+
+const Vec4d intrinsics(458.654, 457.296, 367.215, 248.375);
+
+/*
+ * Normalized points of a static scene seen before and after a small
+ * motion, with every tenth match moved by up to 20 pixels.
+ */
+void generateMatches(const unsigned int& seed, const int& point_num,
+    vector<Point2f>& pts1, vector<Point2f>& pts2,
+    Matx33f& R_p_c, vector<bool>& outliers) {
+  mt19937 generator(seed);
+  uniform_real_distribution<double> lateral(-1.0, 1.0);
+  uniform_real_distribution<double> depth(3.0, 10.0);
+  uniform_real_distribution<double> offset(-20.0, 20.0);
+
+  const Matrix3d R = AngleAxisd(0.02, Vector3d(
+        lateral(generator), lateral(generator), 1.0).normalized())
+    .toRotationMatrix();
+  const Vector3d t(0.05, 0.02, -0.03);
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      R_p_c(i, j) = R(i, j);
+
+  pts1.resize(point_num);
+  pts2.resize(point_num);
+  outliers.resize(point_num);
+  for (int i = 0; i < point_num; ++i) {
+    const Vector3d p1(4.0*lateral(generator),
+        3.0*lateral(generator), depth(generator));
+    const Vector3d p2 = R*p1 + t;
+    pts1[i] = Point2f(p1(0)/p1(2), p1(1)/p1(2));
+    pts2[i] = Point2f(p2(0)/p2(2), p2(1)/p2(2));
+
+    outliers[i] = i%10 == 0;
+    if (!outliers[i]) continue;
+    pts2[i].x += offset(generator) / intrinsics[0];
+    pts2[i].y += offset(generator) / intrinsics[1];
+  }
+  return;
+}
+
+} // namespace
+
+TEST(ImageProcessorTest, twoPointRansacDeterministic) {
+  vector<Point2f> pts1, pts2;
+  Matx33f R_p_c;
+  vector<bool> outliers;
+  generateMatches(1, 200, pts1, pts2, R_p_c, outliers);
+
+  ImageProcessorTester tester;
+  vector<int> inlier_markers;
+  tester.twoPointRansac(pts1, pts2, R_p_c, intrinsics, true, inlier_markers);
+  ASSERT_EQ(inlier_markers.size(), pts1.size());
+
+  // Neither a second run nor a second image processor changes the
+  // inliers.
+  vector<int> repeated_markers;
+  tester.twoPointRansac(pts1, pts2, R_p_c, intrinsics, true, repeated_markers);
+  EXPECT_EQ(repeated_markers, inlier_markers);
+
+  ImageProcessorTester another_tester;
+  another_tester.twoPointRansac(
+      pts1, pts2, R_p_c, intrinsics, true, repeated_markers);
+  EXPECT_EQ(repeated_markers, inlier_markers);
+
+  // Most of the moved matches are rejected, and most of the others
+  // are kept.
+  int rejected_outlier_num = 0, kept_inlier_num = 0;
+  for (int i = 0; i < pts1.size(); ++i) {
+    if (outliers[i]) rejected_outlier_num += inlier_markers[i] == 0;
+    else kept_inlier_num += inlier_markers[i] != 0;
+  }
+  EXPECT_GE(rejected_outlier_num, 12);
+  EXPECT_GE(kept_inlier_num, 150);
+}
+
+TEST(ImageProcessorTest, twoPointRansacFixedIterations) {
+  ImageProcessorTester tester;
+  for (unsigned int seed = 0; seed < 20; ++seed) {
+    vector<Point2f> pts1, pts2;
+    Matx33f R_p_c;
+    vector<bool> outliers;
+    generateMatches(seed, 50+10*seed, pts1, pts2, R_p_c, outliers);
+
+    // Without the adaptive termination, the early exits do not
+    // change the inliers.
+    vector<int> inlier_markers, reference_markers;
+    tester.twoPointRansac(
+        pts1, pts2, R_p_c, intrinsics, false, inlier_markers);
+    tester.referenceTwoPointRansac(
+        pts1, pts2, R_p_c, intrinsics, reference_markers);
+    EXPECT_EQ(inlier_markers, reference_markers) << "seed " << seed;
+  }
+}
+
+namespace {
+
+// Blurred noise, which has FAST corners all over the image.
+Mat textureImage(const int& rows, const int& cols) {
+  Mat noise(rows, cols, CV_8U);
+  RNG rng(0);
+  rng.fill(noise, RNG::UNIFORM, 0, 256);
+  Mat img;
+  GaussianBlur(noise, img, Size(0, 0), 2.0);
+  normalize(img, img, 0, 255, NORM_MINMAX);
+  return img;
+}
+
+/*
+ * The detection before the features were detected grid by grid.
+ * FAST runs on the whole image with the pixels around the given
+ * features masked, and the corners with top response are kept
+ * in each grid.
+ */
+void referenceGridFeatures(const Mat& img, const int& grid_row,
+    const int& grid_col, const vector<Point2f>& features,
+    vector<vector<KeyPoint> >& grid_features) {
+  Mat mask(img.rows, img.cols, CV_8U, Scalar(1));
+  for (const auto& feature : features) {
+    const int y = static_cast<int>(feature.y);
+    const int x = static_cast<int>(feature.x);
+    const Range row_range(std::max(y-2, 0), std::min(y+3, img.rows));
+    const Range col_range(std::max(x-2, 0), std::min(x+3, img.cols));
+    mask(row_range, col_range) = 0;
+  }
+
+  vector<KeyPoint> keypoints;
+  FastFeatureDetector::create(fast_threshold)->detect(img, keypoints, mask);
+
+  const int grid_height = img.rows / grid_row;
+  const int grid_width = img.cols / grid_col;
+  grid_features.assign(grid_row*grid_col, vector<KeyPoint>());
+  for (const auto& keypoint : keypoints) {
+    const int row = static_cast<int>(keypoint.pt.y / grid_height);
+    const int col = static_cast<int>(keypoint.pt.x / grid_width);
+    if (row >= grid_row || col >= grid_col) continue;
+    grid_features[row*grid_col+col].push_back(keypoint);
+  }
+  return;
+}
+
+vector<float> sortedResponses(const vector<KeyPoint>& keypoints) {
+  vector<float> responses;
+  for (const auto& keypoint : keypoints)
+    responses.push_back(keypoint.response);
+  std::sort(responses.begin(), responses.end(), std::greater<float>());
+  return responses;
+}
+
+void checkGridFeatures(const int& rows, const int& cols,
+    const int& grid_row, const int& grid_col,
+    const int& grid_max_feature_num) {
+  const Mat img = textureImage(rows, cols);
+
+  // Existing features on some of the corners, and on the border
+  // of the image.
+  vector<vector<KeyPoint> > reference_features;
+  referenceGridFeatures(img, grid_row, grid_col,
+      vector<Point2f>(), reference_features);
+  vector<Point2f> features;
+  for (int code = 0; code < grid_row*grid_col; code += 2) {
+    for (int i = 0; i < reference_features[code].size(); i += 3)
+      features.push_back(reference_features[code][i].pt);
+  }
+  features.push_back(Point2f(0.5f, 0.5f));
+  features.push_back(Point2f(cols-0.5f, rows-0.5f));
+  features.push_back(Point2f(cols/2.0f, rows-1.5f));
+
+  ImageProcessorTester tester;
+  vector<vector<KeyPoint> > grid_features;
+  tester.detectGridFeatures(img, grid_row, grid_col,
+      grid_max_feature_num, features, grid_features);
+  EXPECT_TRUE(tester.occupancy_cleared);
+
+  referenceGridFeatures(img, grid_row, grid_col,
+      features, reference_features);
+  ASSERT_EQ(grid_features.size(), reference_features.size());
+
+  for (int code = 0; code < grid_row*grid_col; ++code) {
+    // The corners with the same response can be kept by either,
+    // so only the responses of the top ones are compared, and
+    // that the kept ones are corners of the same grid.
+    vector<float> responses = sortedResponses(reference_features[code]);
+    if (responses.size() > grid_max_feature_num)
+      responses.resize(grid_max_feature_num);
+    EXPECT_EQ(sortedResponses(grid_features[code]), responses)
+      << "grid " << code;
+
+    for (const auto& keypoint : grid_features[code]) {
+      EXPECT_TRUE(std::any_of(reference_features[code].begin(),
+            reference_features[code].end(), [&](const KeyPoint& corner) {
+            return corner.pt == keypoint.pt &&
+              corner.response == keypoint.response;
+            })) << "grid " << code << " corner " << keypoint.pt;
+    }
+  }
+  return;
+}
+
+} // namespace
+
+TEST(ImageProcessorTest, detectGridFeaturesEuroc) {
+  checkGridFeatures(480, 752, 4, 5, 6);
+}
+
+TEST(ImageProcessorTest, detectGridFeaturesKitti) {
+  // Neither side of the image is a multiple of the grid size.
+  checkGridFeatures(376, 1241, 5, 6, 10);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
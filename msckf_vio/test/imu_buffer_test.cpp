@@ -0,0 +1,127 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/imu_buffer.h>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+ImuSample makeSample(const int& i) {
+  ImuSample sample;
+  sample.time = 0.005 * i;
+  sample.angular_velocity = Vector3d::Constant(i);
+  sample.linear_acceleration = Vector3d::Constant(-i);
+  return sample;
+}
+
+TEST(ImuBufferTest, rangeQueries) {
+  ImuBuffer buffer(10);
+  EXPECT_EQ(buffer.capacity(), 16);
+  EXPECT_EQ(buffer.begin(), 0);
+  EXPECT_EQ(buffer.end(), 0);
+
+  for (int i = 0; i < 40; ++i)
+    EXPECT_TRUE(buffer.push(makeSample(i)));
+  // Samples which are not newer than the last one are dropped.
+  EXPECT_FALSE(buffer.push(makeSample(39)));
+
+  // Only the newest 16 samples are kept.
+  EXPECT_EQ(buffer.begin(), 24);
+  EXPECT_EQ(buffer.end(), 40);
+
+  ImuSample sample;
+  EXPECT_FALSE(buffer.get(23, sample));
+  EXPECT_FALSE(buffer.get(40, sample));
+  ASSERT_TRUE(buffer.get(30, sample));
+  EXPECT_DOUBLE_EQ(sample.time, 0.15);
+  EXPECT_DOUBLE_EQ(sample.angular_velocity(1), 30.0);
+  EXPECT_DOUBLE_EQ(sample.linear_acceleration(2), -30.0);
+
+  EXPECT_EQ(buffer.lowerBound(0.15, 0), 30);
+  EXPECT_EQ(buffer.upperBound(0.15, 0), 31);
+  EXPECT_EQ(buffer.lowerBound(0.151, 0), 31);
+  EXPECT_EQ(buffer.lowerBound(0.0, 0), 24);
+  EXPECT_EQ(buffer.lowerBound(1.0, 0), 40);
+  EXPECT_EQ(buffer.lowerBound(0.0, 35), 35);
+}
+
+TEST(ImuBufferTest, producerRole) {
+  ImuBuffer::Ptr buffer = ImuBuffer::getShared("imu_buffer_test");
+  EXPECT_EQ(buffer, ImuBuffer::getShared("imu_buffer_test"));
+  EXPECT_NE(buffer, ImuBuffer::getShared("other_imu"));
+
+  int a = 0, b = 0;
+  EXPECT_TRUE(buffer->claimProducer(&a));
+  EXPECT_FALSE(buffer->claimProducer(&b));
+  EXPECT_TRUE(buffer->claimProducer(&a));
+  buffer->releaseProducer(&b);
+  EXPECT_FALSE(buffer->claimProducer(&b));
+  buffer->releaseProducer(&a);
+  EXPECT_TRUE(buffer->claimProducer(&b));
+}
+
+TEST(ImuBufferTest, sharedCapacity) {
+  // 5 seconds at 200 Hz and the sample being written, which
+  // the buffer rounds up to a power of two.
+  const int capacity = ImuBuffer::requiredCapacity(200.0, 5.0);
+  EXPECT_EQ(capacity, 1001);
+  ImuBuffer::Ptr buffer = ImuBuffer::getShared("sized_imu", capacity);
+  EXPECT_EQ(buffer->capacity(), 1024);
+
+  // A later user gets the existing buffer as it is.
+  EXPECT_EQ(buffer, ImuBuffer::getShared("sized_imu", 4*capacity));
+  EXPECT_EQ(buffer->capacity(), 1024);
+
+  // The buffer is created again once its users are gone.
+  buffer.reset();
+  EXPECT_EQ(ImuBuffer::getShared("sized_imu", 4*capacity)->capacity(), 4096);
+}
+
+TEST(ImuBufferTest, concurrentConsumers) {
+  ImuBuffer buffer(64);
+  const int sample_num = 20000;
+
+  // Consumers read the samples in order while the producer
+  // keeps writing. A sample either reads back exactly or is
+  // reported as overwritten.
+  auto consume = [&buffer, &sample_num](int* read_num) {
+    ImuBuffer::SeqType seq = 0;
+    ImuSample sample;
+    while (seq < sample_num) {
+      if (seq >= buffer.end()) continue;
+      if (seq < buffer.begin()) seq = buffer.begin();
+      if (!buffer.get(seq, sample)) continue;
+      EXPECT_DOUBLE_EQ(sample.angular_velocity(0), static_cast<double>(seq));
+      EXPECT_DOUBLE_EQ(sample.linear_acceleration(0), -static_cast<double>(seq));
+      ++(*read_num);
+      ++seq;
+    }
+  };
+
+  vector<int> read_nums(3, 0);
+  vector<thread> consumers;
+  for (auto& read_num : read_nums)
+    consumers.emplace_back(consume, &read_num);
+  for (int i = 0; i < sample_num; ++i)
+    buffer.push(makeSample(i));
+  for (auto& consumer : consumers)
+    consumer.join();
+
+  for (const auto& read_num : read_nums) {
+    EXPECT_GT(read_num, 0);
+    EXPECT_LE(read_num, sample_num);
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
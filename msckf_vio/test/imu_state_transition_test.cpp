@@ -0,0 +1,80 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <iostream>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+#include <msckf_vio/math_utils.hpp>
+#include <msckf_vio/imu_state_transition.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+TEST(ImuStateTransitionTest, compareWithDenseSeries) {
+  Vector3d gyro(0.3, -0.2, 0.5);
+  Vector3d acc(0.5, 9.6, -0.4);
+  Matrix3d R_w_i = AngleAxisd(0.7, Vector3d(1, 2, 3).normalized())
+    .toRotationMatrix();
+  double dtime = 0.005;
+
+  // Dense version of the continuous dynamics.
+  Matrix<double, 21, 21> F = Matrix<double, 21, 21>::Zero();
+  F.block<3, 3>(0, 0) = -skewSymmetric(gyro);
+  F.block<3, 3>(0, 3) = -Matrix3d::Identity();
+  F.block<3, 3>(6, 0) = -R_w_i.transpose()*skewSymmetric(acc);
+  F.block<3, 3>(6, 9) = -R_w_i.transpose();
+  F.block<3, 3>(12, 6) = Matrix3d::Identity();
+
+  Matrix<double, 21, 21> Fdt = F * dtime;
+  Matrix<double, 21, 21> Fdt_square = Fdt * Fdt;
+  Matrix<double, 21, 21> Fdt_cube = Fdt_square * Fdt;
+  Matrix<double, 21, 21> Phi_dense = Matrix<double, 21, 21>::Identity() +
+    Fdt + 0.5*Fdt_square + (1.0/6.0)*Fdt_cube;
+
+  ImuStateTransition Phi;
+  Phi.compute(gyro, acc, R_w_i, dtime);
+  EXPECT_NEAR((Phi.toDense()-Phi_dense).norm(), 0.0, 1e-12);
+
+  // Without the extrinsics, the transition is the top left block.
+  EXPECT_NEAR((Phi.toDense<IMU_CORE_STATE_SIZE>()-
+        Phi_dense.topLeftCorner<15, 15>()).norm(), 0.0, 1e-12);
+  return;
+}
+
+TEST(ImuStateTransitionTest, applyOnTheLeft) {
+  Vector3d gyro(-0.1, 0.4, 0.2);
+  Vector3d acc(0.2, -0.3, 9.8);
+  Matrix3d R_w_i = AngleAxisd(-1.2, Vector3d(0, 1, 1).normalized())
+    .toRotationMatrix();
+
+  ImuStateTransition Phi;
+  Phi.compute(gyro, acc, R_w_i, 0.01);
+  Matrix<double, 21, 21> Phi_dense = Phi.toDense();
+
+  // Phi*P*Phi^T on the IMU block.
+  MatrixXd A = MatrixXd::Random(21, 21);
+  Matrix<double, 21, 21> P = A * A.transpose();
+  Matrix<double, 21, 21> P_new = P;
+  Phi.applyOnTheLeft(P_new);
+  P_new.transposeInPlace();
+  Phi.applyOnTheLeft(P_new);
+  EXPECT_NEAR((P_new-Phi_dense*P*Phi_dense.transpose()).norm(), 0.0, 1e-10);
+
+  // Phi*P12 on a block of a larger matrix.
+  MatrixXd P_full = MatrixXd::Random(33, 33);
+  MatrixXd P12 = P_full.block(0, 21, 21, 12);
+  Phi.applyOnTheLeft(P_full.block(0, 21, 21, 12));
+  EXPECT_NEAR((P_full.block(0, 21, 21, 12)-Phi_dense*P12).norm(), 0.0, 1e-10);
+  return;
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,117 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <msckf_vio/latency_tracer.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+// The tracer is shared by all the tests in the process.
+class LatencyTracerTest : public testing::Test {
+  protected:
+    static void SetUpTestCase() {
+      trace_file = string(testing::TempDir()) + "latency_trace.json";
+      ASSERT_TRUE(LatencyTracer::instance().enable(trace_file));
+    }
+
+    static string trace_file;
+};
+
+string LatencyTracerTest::trace_file;
+
+TEST_F(LatencyTracerTest, percentiles) {
+  LatencyTracer& tracer = LatencyTracer::instance();
+  // Durations of 1, 2, ..., 100 ms.
+  for (int i = 1; i <= 100; ++i)
+    tracer.record("test/percentiles", 0, i*1000000);
+  tracer.record("other/stage", 0, 1000000);
+
+  vector<StageStatistics> stats;
+  tracer.statistics("test/percentiles", stats);
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].name, "test/percentiles");
+  EXPECT_EQ(stats[0].count, 100);
+  EXPECT_NEAR(stats[0].p50, 50.0, 1e-9);
+  EXPECT_NEAR(stats[0].p95, 95.0, 1e-9);
+  EXPECT_NEAR(stats[0].p99, 99.0, 1e-9);
+  EXPECT_NEAR(stats[0].max, 100.0, 1e-9);
+}
+
+TEST_F(LatencyTracerTest, rollingWindow) {
+  LatencyTracer& tracer = LatencyTracer::instance();
+  for (int i = 0; i < LatencyTracer::window_size; ++i)
+    tracer.record("test/window", 0, 10000000);
+  // The old durations are replaced by the new ones.
+  for (int i = 0; i < LatencyTracer::window_size; ++i)
+    tracer.record("test/window", 0, 1000000);
+
+  vector<StageStatistics> stats;
+  tracer.statistics("test/window", stats);
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].count, 2*LatencyTracer::window_size);
+  EXPECT_NEAR(stats[0].max, 1.0, 1e-9);
+}
+
+TEST_F(LatencyTracerTest, scopedTracesFromThreads) {
+  const int thread_num = 4;
+  const int trace_num = 200;
+  vector<thread> threads;
+  for (int i = 0; i < thread_num; ++i) {
+    threads.emplace_back([]() {
+        for (int j = 0; j < trace_num; ++j) {
+          ScopedTrace trace("test/scoped");
+          this_thread::yield();
+        }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  vector<StageStatistics> stats;
+  LatencyTracer::instance().statistics("test/scoped", stats);
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].count, thread_num*trace_num);
+  EXPECT_LE(stats[0].p50, stats[0].p99);
+
+  // The events are written to the trace file in the background.
+  this_thread::sleep_for(chrono::milliseconds(300));
+  ifstream file(trace_file);
+  stringstream content;
+  content << file.rdbuf();
+  EXPECT_EQ(content.str().compare(0, 1, "["), 0);
+  EXPECT_NE(content.str().find("\"name\":\"test/scoped\",\"ph\":\"X\""),
+      string::npos);
+}
+
+TEST_F(LatencyTracerTest, reuseThreadBuffers) {
+  LatencyTracer& tracer = LatencyTracer::instance();
+  const int trace_num = 10;
+
+  // Short-lived threads one after the other share one buffer.
+  thread([&]() { tracer.record("test/reuse", 0, 1000000); }).join();
+  const int buffer_num = tracer.threadBufferNum();
+  for (int i = 1; i < trace_num; ++i)
+    thread([&]() { tracer.record("test/reuse", 0, 1000000); }).join();
+  EXPECT_EQ(tracer.threadBufferNum(), buffer_num);
+
+  // The events of the exited threads are not lost.
+  vector<StageStatistics> stats;
+  tracer.statistics("test/reuse", stats);
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].count, trace_num);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
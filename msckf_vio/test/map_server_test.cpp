@@ -0,0 +1,90 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <vector>
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include <msckf_vio/feature.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+TEST(MapServerTest, observationMap) {
+  ObservationMap observations;
+  for (int i = 0; i < 5; ++i)
+    observations[2*i] = Vector4d::Constant(i);
+  // Out of order insertion keeps the ids sorted.
+  observations[3] = Vector4d::Constant(-1.0);
+  EXPECT_EQ(observations.size(), 6);
+
+  vector<StateIDType> ids;
+  for (const auto& m : observations) ids.push_back(m.first);
+  EXPECT_EQ(ids, vector<StateIDType>({0, 2, 3, 4, 6, 8}));
+  EXPECT_EQ((--observations.end())->first, 8);
+
+  ASSERT_TRUE(observations.find(4) != observations.end());
+  EXPECT_DOUBLE_EQ(observations.find(4)->second(0), 2.0);
+  EXPECT_TRUE(observations.find(5) == observations.end());
+
+  EXPECT_EQ(observations.erase(3), 1);
+  EXPECT_EQ(observations.erase(3), 0);
+  EXPECT_EQ(observations.size(), 5);
+  EXPECT_EQ(observations.begin()->first, 0);
+}
+
+TEST(MapServerTest, insertFindErase) {
+  MapServer map_server;
+  // Features of one frame do not come in the order of their ids.
+  const vector<FeatureIDType> feature_ids = {5, 1, 9, 3, 7};
+  for (const auto& id : feature_ids)
+    map_server[id].observations[0] = Vector4d::Zero();
+  EXPECT_EQ(map_server.size(), 5);
+
+  vector<FeatureIDType> ids;
+  for (const auto& item : map_server) {
+    EXPECT_EQ(item.first, item.second.id);
+    ids.push_back(item.first);
+  }
+  EXPECT_EQ(ids, vector<FeatureIDType>({1, 3, 5, 7, 9}));
+
+  EXPECT_EQ(map_server.erase(3), 1);
+  EXPECT_EQ(map_server.erase(3), 0);
+  EXPECT_TRUE(map_server.find(3) == map_server.end());
+  EXPECT_EQ(map_server.find(7)->second.id, 7);
+
+  // A new feature reuses the free slot, but starts
+  // without observations.
+  Feature& feature = map_server[11];
+  EXPECT_EQ(feature.id, 11);
+  EXPECT_TRUE(feature.observations.empty());
+  EXPECT_FALSE(feature.is_initialized);
+  EXPECT_EQ(map_server.size(), 5);
+  EXPECT_EQ((--map_server.end())->first, 11);
+
+  map_server.clear();
+  EXPECT_TRUE(map_server.empty());
+  EXPECT_TRUE(map_server.find(5) == map_server.end());
+}
+
+TEST(MapServerTest, stableReferences) {
+  MapServer map_server;
+  Feature& feature = map_server[0];
+  feature.observations[0] = Vector4d::Ones();
+
+  // References are kept across the insertion of many features.
+  for (FeatureIDType id = 1; id < 1000; ++id)
+    map_server[id].observations[0] = Vector4d::Zero();
+  EXPECT_EQ(&feature, &map_server[0]);
+  EXPECT_EQ(feature.id, 0);
+  EXPECT_EQ(feature.observations[0], Vector4d::Ones());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
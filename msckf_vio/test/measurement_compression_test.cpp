@@ -0,0 +1,149 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <iostream>
+#include <Eigen/Dense>
+#include <Eigen/SVD>
+#include <gtest/gtest.h>
+#include <msckf_vio/measurement_compression.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+TEST(MeasurementCompressionTest, blockStructuredJacobian) {
+  // 21 IMU states and 10 camera states.
+  const int cam_state_size = 10;
+  const int cols = 21 + 6*cam_state_size;
+
+  // Each feature is observed by a consecutive range of
+  // camera states, and has 2*n-3 rows after the nullspace
+  // projection with n being the number of observations.
+  const int feature_spans[][2] = {
+    {3, 9}, {0, 4}, {5, 10}, {0, 10}, {7, 10},
+    {1, 6}, {2, 8}, {0, 3}, {4, 10}, {6, 9},
+    {0, 10}, {3, 7}, {1, 10}, {5, 8}, {0, 6}};
+
+  int rows = 0;
+  for (const auto& span : feature_spans)
+    rows += 2*(span[1]-span[0]) - 3;
+
+  MatrixXd H = MatrixXd::Zero(rows, cols);
+  VectorXd r = VectorXd::Random(rows);
+  int row = 0;
+  for (const auto& span : feature_spans) {
+    const int size = 2*(span[1]-span[0]) - 3;
+    H.block(row, 21+6*span[0], size, 6*(span[1]-span[0])) =
+      MatrixXd::Random(size, 6*(span[1]-span[0]));
+    row += size;
+  }
+
+  MatrixXd H_thin;
+  VectorXd r_thin;
+  compressMeasurement(H, r, H_thin, r_thin);
+
+  EXPECT_LE(H_thin.rows(), cols-21);
+  EXPECT_EQ(H_thin.rows(), r_thin.rows());
+  EXPECT_DOUBLE_EQ(H_thin.leftCols(21).norm(), 0.0);
+
+  // Q1 preserves the information matrix and vector.
+  EXPECT_NEAR((H_thin.transpose()*H_thin-H.transpose()*H).norm(), 0.0, 1e-9);
+  EXPECT_NEAR((H_thin.transpose()*r_thin-H.transpose()*r).norm(), 0.0, 1e-9);
+
+  // The result should be upper triangular in the non-zero columns.
+  EXPECT_NEAR(H_thin.rightCols(cols-21).triangularView<StrictlyLower>()
+      .toDenseMatrix().norm(), 0.0, 1e-12);
+  return;
+}
+
+TEST(MeasurementCompressionTest, denseJacobian) {
+  MatrixXd H = MatrixXd::Random(40, 12);
+  VectorXd r = VectorXd::Random(40);
+
+  MatrixXd H_thin;
+  VectorXd r_thin;
+  compressMeasurement(H, r, H_thin, r_thin);
+
+  EXPECT_EQ(H_thin.rows(), 12);
+  EXPECT_NEAR((H_thin.transpose()*H_thin-H.transpose()*H).norm(), 0.0, 1e-10);
+  EXPECT_NEAR((H_thin.transpose()*r_thin-H.transpose()*r).norm(), 0.0, 1e-10);
+  return;
+}
+
+TEST(MeasurementCompressionTest, zeroColumns) {
+  // Camera states 2 and 5 are unused slots.
+  const int cols = 21 + 6*8;
+  MatrixXd H = MatrixXd::Random(50, cols);
+  H.leftCols(21).setZero();
+  H.middleCols(21+6*2, 6).setZero();
+  H.middleCols(21+6*5, 6).setZero();
+  VectorXd r = VectorXd::Random(50);
+
+  MatrixXd H_thin;
+  VectorXd r_thin;
+  compressMeasurement(H, r, H_thin, r_thin);
+
+  EXPECT_EQ(H_thin.rows(), 36);
+  EXPECT_NEAR((H_thin.transpose()*H_thin-H.transpose()*H).norm(), 0.0, 1e-9);
+  EXPECT_NEAR((H_thin.transpose()*r_thin-H.transpose()*r).norm(), 0.0, 1e-9);
+  return;
+}
+
+TEST(MeasurementCompressionTest, leftNullspaceProjection) {
+  // A feature observed by 5 camera states, with the columns of
+  // the camera states only.
+  const int cam_state_size = 5;
+  const int rows = 4 * cam_state_size;
+  const int cols_x = 6 * cam_state_size;
+  const MatrixXd H_fj = MatrixXd::Random(rows, 3);
+  const MatrixXd H_xj = MatrixXd::Random(rows, cols_x);
+  const VectorXd r_j = VectorXd::Random(rows);
+
+  // The projection of the baseline with the SVD basis.
+  JacobiSVD<MatrixXd> svd_helper(H_fj, ComputeFullU | ComputeThinV);
+  const MatrixXd A_svd = svd_helper.matrixU().rightCols(rows-3);
+  const MatrixXd H_svd = A_svd.transpose() * H_xj;
+  const VectorXd r_svd = A_svd.transpose() * r_j;
+
+  // The identity columns record the applied transformation,
+  // of which the last rows are the nullspace basis A^T.
+  MatrixXd A(rows, 3+cols_x+1+rows);
+  A << H_fj, H_xj, r_j, MatrixXd::Identity(rows, rows);
+  projectLeftNullspace(A, 3);
+  const MatrixXd H = A.block(3, 3, rows-3, cols_x);
+  const VectorXd r = A.col(3+cols_x).tail(rows-3);
+  const MatrixXd A_householder =
+    A.bottomRightCorner(rows-3, rows).transpose();
+
+  EXPECT_NEAR((A_householder.transpose()*H_fj).norm(), 0.0, 1e-12);
+  EXPECT_NEAR((A_svd.transpose()*H_fj).norm(), 0.0, 1e-12);
+  EXPECT_NEAR((A_householder.transpose()*A_householder-
+        MatrixXd::Identity(rows-3, rows-3)).norm(), 0.0, 1e-12);
+  EXPECT_NEAR((H-A_householder.transpose()*H_xj).norm(), 0.0, 1e-12);
+
+  // The bases differ by a rotation, which does not change the
+  // residual norm, the information matrix and vector, or the
+  // gating statistic.
+  EXPECT_NEAR(r.norm(), r_svd.norm(), 1e-12);
+  EXPECT_NEAR((H.transpose()*H-H_svd.transpose()*H_svd).norm(), 0.0, 1e-10);
+  EXPECT_NEAR((H.transpose()*r-H_svd.transpose()*r_svd).norm(), 0.0, 1e-10);
+
+  const MatrixXd L = MatrixXd::Random(cols_x, cols_x);
+  const MatrixXd P = L*L.transpose() + MatrixXd::Identity(cols_x, cols_x);
+  const MatrixXd noise = 0.01 * MatrixXd::Identity(rows-3, rows-3);
+  const double gamma = r.transpose() *
+    (H*P*H.transpose()+noise).ldlt().solve(r);
+  const double gamma_svd = r_svd.transpose() *
+    (H_svd*P*H_svd.transpose()+noise).ldlt().solve(r_svd);
+  EXPECT_NEAR(gamma, gamma_svd, 1e-8*gamma_svd);
+  return;
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
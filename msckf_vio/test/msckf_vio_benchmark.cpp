@@ -0,0 +1,420 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <map>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <benchmark/benchmark.h>
+
+#include <msckf_vio/msckf_vio.h>
+#include <msckf_vio/parameter_reader.h>
+
+using namespace std;
+using namespace Eigen;
+
+namespace msckf_vio {
+
+/*
+ * @brief MsckfVioBenchmark A filter holding a full window of
+ *    camera states along a synthetic trajectory, and features
+ *    observed by all of the camera states.
+ *
+ *    The IMU moves forward at 1m/s while turning at 0.2rad/s,
+ *    with IMU msgs at 200Hz and images at 20Hz. The camera looks
+ *    forward and the features are 5-10m in front of it. The
+ *    extrinsics are left out of the state with an IMU state
+ *    size of 15.
+ */
+class MsckfVioBenchmark {
+  public:
+    MsckfVioBenchmark(const int& window_size, const int& feature_num,
+        const int& imu_state_size = IMU_STATE_SIZE);
+
+    static void predictNewState(const double& dt,
+        const Vector3d& gyro, const Vector3d& acc,
+        const Vector3d& gravity, IMUState& imu_state) {
+      MsckfVio::predictNewState(dt, gyro, acc, gravity, imu_state);
+    }
+
+    // Propagate the filter with the next IMU msg.
+    void processImu();
+
+    // Add a camera state at the current time and return its id.
+    StateIDType stateAugmentation();
+    void removeCamState(const StateIDType& cam_state_id);
+
+    void measurementJacobian(const StateIDType& cam_state_id,
+        const FeatureIDType& feature_id,
+        Matrix<double, 4, 6>& H_x, Matrix<double, 4, 3>& H_f,
+        Vector4d& r) const {
+      vio.measurementJacobian(cam_state_id, feature_id, H_x, H_f, r);
+    }
+    void featureJacobian(const FeatureIDType& feature_id,
+        MatrixXd& H_x, VectorXd& r) const {
+      vio.featureJacobian(feature_id, cam_state_ids, H_x, r);
+    }
+
+    // Stack the Jacobians of the features to the given rows.
+    void stackFeatureJacobians(const int& row_size,
+        MatrixXd& H_x, VectorXd& r) const;
+
+    void measurementUpdate(const MatrixXd& H_x, const VectorXd& r) {
+      vio.measurementUpdate(H_x, r);
+    }
+
+    // The state is saved once the window is full.
+    void restoreState() {
+      vio.state_server = saved_state;
+    }
+
+    const CamStateServer& camStates() const {
+      return vio.state_server.cam_states;
+    }
+    const Feature& feature(const FeatureIDType& id) const {
+      return vio.map_server.find(id)->second;
+    }
+    const Isometry3d& T_cam0_cam1() const {
+      return vio.sensor_config.T_cam0_cam1;
+    }
+    const Feature::OptimizationConfig& optimizationConfig() const {
+      return vio.optimization_config;
+    }
+    const vector<StateIDType>& camStateIds() const {
+      return cam_state_ids;
+    }
+
+    static const double imu_period;
+    static const Vector3d gyro;
+
+  private:
+    // Specific force measured by the IMU moving at a constant
+    // velocity in the world frame.
+    Vector3d accelerometer() const;
+
+    MsckfVio vio;
+    MsckfVio::StateServer saved_state;
+    vector<StateIDType> cam_state_ids;
+};
+
+namespace {
+
+/*
+ * Noise of the EuRoC configuration. The z axis of cam0 points
+ * along the x axis of the IMU, and cam0 is at (0.05, -0.02, 0)
+ * in the IMU frame.
+ */
+const char* filter_config =
+  "defer_cross_cov_propagation: false\n"
+  "noise: {gyro: 0.005, acc: 0.05, gyro_bias: 0.001, "
+  "acc_bias: 0.01, feature: 0.035}\n"
+  "initial_state:\n"
+  "  velocity: {x: 1.0, y: 0.0, z: 0.0}\n"
+  "initial_covariance: {velocity: 0.25, gyro_bias: 1.0e-4, "
+  "acc_bias: 1.0e-2, extrinsic_rotation_cov: 3.0462e-4, "
+  "extrinsic_translation_cov: 2.5e-5}\n"
+  "cam0:\n"
+  "  T_cam_imu:\n"
+  "    - [0.0, -1.0, 0.0, -0.02]\n"
+  "    - [0.0, 0.0, -1.0, 0.0]\n"
+  "    - [1.0, 0.0, 0.0, -0.05]\n"
+  "    - [0.0, 0.0, 0.0, 1.0]\n"
+  "cam1:\n"
+  "  T_cam_imu:\n"
+  "    - [0.0, -1.0, 0.0, -0.13]\n"
+  "    - [0.0, 0.0, -1.0, 0.0]\n"
+  "    - [1.0, 0.0, 0.0, -0.05]\n"
+  "    - [0.0, 0.0, 0.0, 1.0]\n"
+  "  T_cn_cnm1:\n"
+  "    - [1.0, 0.0, 0.0, -0.11]\n"
+  "    - [0.0, 1.0, 0.0, 0.0]\n"
+  "    - [0.0, 0.0, 1.0, 0.0]\n"
+  "    - [0.0, 0.0, 0.0, 1.0]\n"
+  "T_imu_body:\n"
+  "  - [1.0, 0.0, 0.0, 0.0]\n"
+  "  - [0.0, 1.0, 0.0, 0.0]\n"
+  "  - [0.0, 0.0, 1.0, 0.0]\n"
+  "  - [0.0, 0.0, 0.0, 1.0]\n";
+
+} // namespace
+
+const double MsckfVioBenchmark::imu_period = 0.005;
+const Vector3d MsckfVioBenchmark::gyro = Vector3d(0.0, 0.0, 0.2);
+
+MsckfVioBenchmark::MsckfVioBenchmark(
+    const int& window_size, const int& feature_num,
+    const int& imu_state_size) {
+  YAML::Node config = YAML::Load(filter_config);
+  config["max_cam_state_size"] = window_size;
+  config["estimate_extrinsics"] = imu_state_size == IMU_STATE_SIZE;
+  vio.initialize(ParameterReader(config));
+
+  MsckfVio::SensorConfig& sensor_config = vio.sensor_config;
+  MsckfVio::StateServer& state_server = vio.state_server;
+
+  // Fill the window with a camera state every 10 IMU msgs.
+  for (int i = 0; i < window_size; ++i) {
+    for (int j = 0; j < 10; ++j) processImu();
+    cam_state_ids.push_back(stateAugmentation());
+  }
+
+  // Observe each feature with all the camera states.
+  mt19937 generator(0);
+  uniform_real_distribution<double> depth(5.0, 10.0);
+  uniform_real_distribution<double> lateral(-3.0, 3.0);
+  normal_distribution<double> noise(0.0, 1e-3);
+  const Matrix3d R_c0_c1 = sensor_config.T_cam0_cam1.linear();
+  const Vector3d t_c0_c1 = sensor_config.T_cam0_cam1.translation();
+
+  for (int i = 0; i < feature_num; ++i) {
+    const Vector3d p_w(depth(generator),
+        lateral(generator), 0.5*lateral(generator));
+    Feature& feature = vio.map_server[i];
+    feature.position = p_w + Vector3d(noise(generator),
+        noise(generator), noise(generator));
+    feature.is_initialized = true;
+
+    for (const auto& cam_state : state_server.cam_states) {
+      const Matrix3d R_w_c0 =
+        quaternionToRotation(cam_state.second.orientation);
+      const Vector3d p_c0 = R_w_c0 * (p_w-cam_state.second.position);
+      const Vector3d p_c1 = R_c0_c1*p_c0 + t_c0_c1;
+      feature.observations[cam_state.first] = Vector4d(
+          p_c0(0)/p_c0(2)+noise(generator), p_c0(1)/p_c0(2)+noise(generator),
+          p_c1(0)/p_c1(2)+noise(generator), p_c1(1)/p_c1(2)+noise(generator));
+    }
+  }
+
+  saved_state = state_server;
+  return;
+}
+
+Vector3d MsckfVioBenchmark::accelerometer() const {
+  const IMUState& imu_state = vio.state_server.imu_state;
+  return -quaternionToRotation(imu_state.orientation) *
+    vio.sensor_config.gravity;
+}
+
+void MsckfVioBenchmark::processImu() {
+  const double time = vio.state_server.imu_state.time + imu_period;
+  vio.processModel(time, gyro, accelerometer());
+  return;
+}
+
+StateIDType MsckfVioBenchmark::stateAugmentation() {
+  IMUState& imu_state = vio.state_server.imu_state;
+  imu_state.id = vio.next_state_id++;
+  vio.stateAugmentation(imu_state.time);
+  return imu_state.id;
+}
+
+void MsckfVioBenchmark::removeCamState(const StateIDType& cam_state_id) {
+  MsckfVio::StateServer& state_server = vio.state_server;
+  const int cam_slot = state_server.cam_states.slot(cam_state_id);
+  state_server.state_cov.clear(vio.imu_state_size+6*cam_slot, 6);
+  state_server.cam_states.erase(cam_state_id);
+  return;
+}
+
+void MsckfVioBenchmark::stackFeatureJacobians(const int& row_size,
+    MatrixXd& H_x, VectorXd& r) const {
+  H_x = MatrixXd::Zero(row_size,
+      vio.imu_state_size+6*camStates().capacity());
+  r = VectorXd::Zero(row_size);
+
+  MatrixXd H_xj;
+  VectorXd r_j;
+  int stack_cntr = 0;
+  for (auto iter = vio.map_server.begin();
+      iter != vio.map_server.end() && stack_cntr < row_size; ++iter) {
+    featureJacobian(iter->first, H_xj, r_j);
+    const int rows = min<int>(H_xj.rows(), row_size-stack_cntr);
+    H_x.middleRows(stack_cntr, rows) = H_xj.topRows(rows);
+    r.segment(stack_cntr, rows) = r_j.head(rows);
+    stack_cntr += rows;
+  }
+  return;
+}
+
+} // namespace msckf_vio
+
+using namespace msckf_vio;
+
+namespace {
+
+// Number of features needed to stack the given rows with
+// features observed by the whole window.
+int featureNum(const int& window_size, const int& row_size) {
+  return (row_size + 4*window_size-4) / (4*window_size-3);
+}
+
+void BM_PredictNewState(benchmark::State& state) {
+  IMUState imu_state;
+  imu_state.velocity = Vector3d(1.0, 0.0, 0.0);
+  const Vector3d gravity(0.0, 0.0, -GRAVITY_ACCELERATION);
+  const Vector3d acc = -gravity;
+  for (auto _ : state) {
+    MsckfVioBenchmark::predictNewState(MsckfVioBenchmark::imu_period,
+        MsckfVioBenchmark::gyro, acc, gravity, imu_state);
+    benchmark::DoNotOptimize(imu_state.position.data());
+  }
+}
+BENCHMARK(BM_PredictNewState);
+
+// Propagation of the IMU state, its covariance and the cross
+// covariance with the camera states, with and without the
+// extrinsics in the state.
+void BM_ProcessModel(benchmark::State& state) {
+  MsckfVioBenchmark filter(state.range(0), 0, state.range(1));
+  for (auto _ : state) filter.processImu();
+}
+BENCHMARK(BM_ProcessModel)
+  ->Apply([](benchmark::internal::Benchmark* b) {
+      for (const int imu_state_size :
+          {IMU_STATE_SIZE, IMU_CORE_STATE_SIZE})
+        for (const int window_size : {0, 10, 20, 30})
+          b->Args({window_size, imu_state_size});
+    });
+
+// Adding the last camera state of the window.
+void BM_StateAugmentation(benchmark::State& state) {
+  MsckfVioBenchmark filter(state.range(0), 0, state.range(1));
+  filter.removeCamState(filter.camStateIds().back());
+  for (auto _ : state) {
+    const StateIDType cam_state_id = filter.stateAugmentation();
+    state.PauseTiming();
+    filter.removeCamState(cam_state_id);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_StateAugmentation)
+  ->Apply([](benchmark::internal::Benchmark* b) {
+      for (const int imu_state_size :
+          {IMU_STATE_SIZE, IMU_CORE_STATE_SIZE})
+        for (const int window_size : {10, 20, 30})
+          b->Args({window_size, imu_state_size});
+    });
+
+void BM_MeasurementJacobian(benchmark::State& state) {
+  MsckfVioBenchmark filter(10, 1);
+  const StateIDType cam_state_id = filter.camStateIds().back();
+  Matrix<double, 4, 6> H_x;
+  Matrix<double, 4, 3> H_f;
+  Vector4d r;
+  for (auto _ : state) {
+    filter.measurementJacobian(cam_state_id, 0, H_x, H_f, r);
+    benchmark::DoNotOptimize(r.data());
+  }
+}
+BENCHMARK(BM_MeasurementJacobian);
+
+// Jacobian of a feature observed by the whole window,
+// projected onto the left nullspace of H_f.
+void BM_FeatureJacobian(benchmark::State& state) {
+  MsckfVioBenchmark filter(state.range(0), 1);
+  MatrixXd H_x;
+  VectorXd r;
+  for (auto _ : state) {
+    filter.featureJacobian(0, H_x, r);
+    benchmark::DoNotOptimize(r.data());
+  }
+}
+BENCHMARK(BM_FeatureJacobian)->Arg(5)->Arg(10)->Arg(20)->Arg(30);
+
+// EKF update with the given rows of stacked feature Jacobians,
+// including the compression of tall Jacobians.
+void BM_MeasurementUpdate(benchmark::State& state) {
+  const int window_size = state.range(0);
+  const int row_size = state.range(1);
+  MsckfVioBenchmark filter(window_size,
+      featureNum(window_size, row_size), state.range(2));
+  MatrixXd H_x;
+  VectorXd r;
+  filter.stackFeatureJacobians(row_size, H_x, r);
+  for (auto _ : state) {
+    filter.measurementUpdate(H_x, r);
+    state.PauseTiming();
+    filter.restoreState();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_MeasurementUpdate)
+  ->Apply([](benchmark::internal::Benchmark* b) {
+      for (const int window_size : {10, 20, 30})
+        for (const int row_size : {64, 256, 1024, 4096})
+          b->Args({window_size, row_size, IMU_STATE_SIZE});
+      for (const int row_size : {64, 256, 1024, 4096})
+        b->Args({30, row_size, IMU_CORE_STATE_SIZE});
+    })
+  ->Unit(benchmark::kMicrosecond);
+
+// Triangulation of a feature with the shared camera poses.
+void BM_InitializePosition(benchmark::State& state) {
+  MsckfVioBenchmark filter(state.range(0), 1);
+  CameraPoses cam_poses;
+  cam_poses.compute(filter.camStates(), filter.T_cam0_cam1());
+  Feature feature = filter.feature(0);
+  for (auto _ : state) {
+    feature.is_initialized = false;
+    benchmark::DoNotOptimize(feature.initializePosition(
+          filter.camStates(), cam_poses, filter.optimizationConfig()));
+  }
+}
+BENCHMARK(BM_InitializePosition)->Arg(5)->Arg(10)->Arg(20)->Arg(30);
+
+// The node-based stores replaced by MapServer and ObservationMap.
+typedef std::map<StateIDType, Vector4d, std::less<StateIDType>,
+        aligned_allocator<std::pair<const StateIDType, Vector4d> > >
+        NodeObservationMap;
+struct NodeFeature {
+  NodeObservationMap observations;
+};
+typedef std::map<FeatureIDType, NodeFeature> NodeMapServer;
+
+// Bookkeeping of the map for one frame of a 30-frame window
+// with 320 tracked features, of which 10% are lost per frame.
+// The observations of the new frame are added, the lost
+// features are removed, and the observations of the oldest
+// frame are removed from the remaining features.
+template <typename Store>
+void BM_MapServerFrame(benchmark::State& state) {
+  const int window_size = 30;
+  const int tracked_feature_num = 320;
+  Store map_server;
+  mt19937 generator(0);
+  FeatureIDType next_feature_id = 0;
+  StateIDType frame = 0;
+  vector<FeatureIDType> tracked_ids;
+  vector<FeatureIDType> kept_ids;
+
+  for (auto _ : state) {
+    while (static_cast<int>(tracked_ids.size()) < tracked_feature_num)
+      tracked_ids.push_back(next_feature_id++);
+    for (const auto& id : tracked_ids)
+      map_server[id].observations[frame] = Vector4d::Constant(frame);
+
+    kept_ids.clear();
+    for (const auto& id : tracked_ids) {
+      if (generator()%10 == 0) map_server.erase(id);
+      else kept_ids.push_back(id);
+    }
+    tracked_ids.swap(kept_ids);
+
+    if (frame >= window_size) {
+      for (auto& item : map_server)
+        item.second.observations.erase(frame-window_size);
+    }
+    ++frame;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_MapServerFrame, NodeMapServer);
+BENCHMARK_TEMPLATE(BM_MapServerFrame, MapServer);
+
+} // namespace
@@ -0,0 +1,230 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+
+#include <msckf_vio/msckf_vio.h>
+#include <msckf_vio/parameter_reader.h>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+namespace {
+
+/*
+ * Noise of the EuRoC configuration. The z axis of cam0 points
+ * along the x axis of the IMU, and cam0 is at (0.05, -0.02, 0)
+ * in the IMU frame, with cam1 0.11m to its right.
+ */
+const char* filter_config =
+  "max_cam_state_size: 10\n"
+  "noise: {gyro: 0.005, acc: 0.05, gyro_bias: 0.001, "
+  "acc_bias: 0.01, feature: 0.035}\n"
+  "cam0:\n"
+  "  T_cam_imu:\n"
+  "    - [0.0, -1.0, 0.0, -0.02]\n"
+  "    - [0.0, 0.0, -1.0, 0.0]\n"
+  "    - [1.0, 0.0, 0.0, -0.05]\n"
+  "    - [0.0, 0.0, 0.0, 1.0]\n"
+  "cam1:\n"
+  "  T_cam_imu:\n"
+  "    - [0.0, -1.0, 0.0, -0.13]\n"
+  "    - [0.0, 0.0, -1.0, 0.0]\n"
+  "    - [1.0, 0.0, 0.0, -0.05]\n"
+  "    - [0.0, 0.0, 0.0, 1.0]\n"
+  "  T_cn_cnm1:\n"
+  "    - [1.0, 0.0, 0.0, -0.11]\n"
+  "    - [0.0, 1.0, 0.0, 0.0]\n"
+  "    - [0.0, 0.0, 1.0, 0.0]\n"
+  "    - [0.0, 0.0, 0.0, 1.0]\n"
+  "T_imu_body:\n"
+  "  - [1.0, 0.0, 0.0, 0.0]\n"
+  "  - [0.0, 1.0, 0.0, 0.0]\n"
+  "  - [0.0, 0.0, 1.0, 0.0]\n"
+  "  - [0.0, 0.0, 0.0, 1.0]\n";
+
+/*
+ * @brief Sequence Noisy IMU msgs at 200Hz and stereo features at
+ *    20Hz. The IMU rests for 1.5s and then swings along its x
+ *    axis, which lets the SFM initialize the gravity. Each feature
+ *    is observed for 16 frames.
+ */
+struct Sequence {
+  vector<sensor_msgs::ImuConstPtr> imu_msgs;
+  vector<CameraMeasurementConstPtr> feature_msgs;
+};
+
+Sequence generateSequence(const unsigned int& seed,
+    const double& amplitude, const double& duration) {
+  mt19937 generator(seed);
+  normal_distribution<double> gyro_noise(0.0, 0.005);
+  normal_distribution<double> acc_noise(0.0, 0.05);
+  normal_distribution<double> feature_noise(0.0, 0.001);
+  uniform_real_distribution<double> depth(5.0, 10.0);
+  uniform_real_distribution<double> lateral(-3.0, 3.0);
+
+  const double rest_duration = 1.5;
+  const double omega = 2.0;
+  // Position and acceleration along the x axis.
+  auto position = [&](const double& time) {
+    const double t = max(time-rest_duration, 0.0);
+    return amplitude * (1.0-cos(omega*t));
+  };
+  auto acceleration = [&](const double& time) {
+    const double t = max(time-rest_duration, 0.0);
+    return time < rest_duration ? 0.0 : amplitude*omega*omega*cos(omega*t);
+  };
+
+  Sequence sequence;
+  for (int i = 0; i*0.005 < duration; ++i) {
+    const double time = 0.005 * (i+1);
+    sensor_msgs::ImuPtr msg(new sensor_msgs::Imu());
+    msg->header.stamp.fromSec(time);
+    msg->angular_velocity.x = gyro_noise(generator);
+    msg->angular_velocity.y = gyro_noise(generator);
+    msg->angular_velocity.z = gyro_noise(generator);
+    msg->linear_acceleration.x = acceleration(time) + acc_noise(generator);
+    msg->linear_acceleration.y = acc_noise(generator);
+    msg->linear_acceleration.z = 9.81 + acc_noise(generator);
+    sequence.imu_msgs.push_back(msg);
+  }
+
+  // Features of the current and the previous batch of 8 frames.
+  Matrix3d R_cam0_imu;
+  R_cam0_imu << 0.0, -1.0, 0.0,
+                0.0, 0.0, -1.0,
+                1.0, 0.0, 0.0;
+  const Vector3d t_cam0_imu(0.05, -0.02, 0.0);
+  const int batch_feature_num = 30;
+  vector<Vector3d> points;
+
+  for (int i = 0; i*0.05 < duration; ++i) {
+    const double time = 0.05 * (i+1);
+    if (i % 8 == 0) {
+      for (int j = 0; j < batch_feature_num; ++j)
+        points.push_back(Vector3d(depth(generator),
+              lateral(generator), 0.5*lateral(generator)));
+    }
+
+    CameraMeasurementPtr msg(new CameraMeasurement());
+    msg->header.stamp.fromSec(time);
+    const Vector3d p_imu(position(time), 0.0, 0.0);
+    const int batch = i / 8;
+    for (int id = max(batch-1, 0)*batch_feature_num;
+        id < (batch+1)*batch_feature_num; ++id) {
+      const Vector3d p_c0 = R_cam0_imu * (points[id]-p_imu-t_cam0_imu);
+      const Vector3d p_c1 = p_c0 + Vector3d(-0.11, 0.0, 0.0);
+      FeatureMeasurement feature;
+      feature.id = id;
+      feature.u0 = p_c0(0)/p_c0(2) + feature_noise(generator);
+      feature.v0 = p_c0(1)/p_c0(2) + feature_noise(generator);
+      feature.u1 = p_c1(0)/p_c1(2) + feature_noise(generator);
+      feature.v1 = p_c1(1)/p_c1(2) + feature_noise(generator);
+      msg->features.push_back(feature);
+    }
+    sequence.feature_msgs.push_back(msg);
+  }
+  return sequence;
+}
+
+// Append the published IMU state.
+void recordState(const IMUState& imu_state, vector<double>& states) {
+  states.push_back(imu_state.time);
+  for (int i = 0; i < 4; ++i) states.push_back(imu_state.orientation(i));
+  for (int i = 0; i < 3; ++i) states.push_back(imu_state.position(i));
+  for (int i = 0; i < 3; ++i) states.push_back(imu_state.velocity(i));
+  for (int i = 0; i < 3; ++i) states.push_back(imu_state.gyro_bias(i));
+  for (int i = 0; i < 3; ++i) states.push_back(imu_state.acc_bias(i));
+  return;
+}
+
+/*
+ * @brief Runner Feeds a sequence to a filter frame by frame, with
+ *    the IMU msgs up to each frame before the frame.
+ */
+class Runner {
+  public:
+    Runner(const Sequence& sequence):
+      sequence(sequence), frame_index(0), imu_index(0) {
+      vio.initialize(ParameterReader(YAML::Load(filter_config)));
+      vio.setStateCallback(
+          boost::bind(&recordState, _1, boost::ref(states)));
+      return;
+    }
+
+    // Process the next frame and return false at the end.
+    bool step() {
+      if (frame_index >= sequence.feature_msgs.size()) return false;
+      const CameraMeasurementConstPtr& msg =
+        sequence.feature_msgs[frame_index++];
+      for (; imu_index < sequence.imu_msgs.size() &&
+          sequence.imu_msgs[imu_index]->header.stamp <= msg->header.stamp;
+          ++imu_index)
+        vio.processImu(sequence.imu_msgs[imu_index]);
+      vio.processFeatures(msg);
+      return true;
+    }
+
+    vector<double> states;
+
+  private:
+    const Sequence& sequence;
+    MsckfVio vio;
+    size_t frame_index;
+    size_t imu_index;
+};
+
+} // namespace
+
+TEST(MsckfVioTest, filtersSideBySide) {
+  const Sequence sequence1 = generateSequence(1, 0.5, 6.0);
+  const Sequence sequence2 = generateSequence(2, 0.3, 6.0);
+
+  // Each sequence alone.
+  vector<double> states1, states2;
+  {
+    Runner runner(sequence1);
+    while (runner.step());
+    states1 = runner.states;
+  }
+  {
+    Runner runner(sequence2);
+    while (runner.step());
+    states2 = runner.states;
+  }
+  // The filter has run on most of the 120 frames, with 17 values
+  // per state.
+  EXPECT_GT(states1.size(), 17*80);
+  EXPECT_GT(states2.size(), 17*80);
+
+  // Both sequences at once, alternating frame by frame.
+  Runner runner1(sequence1);
+  Runner runner2(sequence2);
+  bool running = true;
+  while (running) {
+    running = runner1.step();
+    running = runner2.step() || running;
+  }
+  EXPECT_EQ(runner1.states, states1);
+  EXPECT_EQ(runner2.states, states2);
+}
+
+int main(int argc, char** argv) {
+  // Only the clock used by the throttled logs.
+  ros::Time::init();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
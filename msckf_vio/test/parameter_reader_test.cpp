@@ -0,0 +1,146 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/parameter_reader.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const char* config =
+  "grid_row: 4\n"
+  "track_precision: 0.01\n"
+  "ransac_threshold: 3\n"
+  "estimate_extrinsics: false\n"
+  "covariance_backend: square_root\n"
+  "empty:\n"
+  "cam0:\n"
+  "  resolution: [752, 480]\n"
+  "  intrinsics: [458.654, 457.296, 367.215, 248.375]\n"
+  "  T_cam_imu:\n"
+  "    - [1.0, 0.0, 0.0, 0.1]\n"
+  "    - [0.0, 1.0, 0.0, 0.2]\n"
+  "    - [0.0, 0.0, 1.0, 0.3]\n"
+  "    - [0, 0, 0, 1]\n"
+  "  T_vec16: [1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1]\n"
+  "cam1:\n"
+  "  resolution: [1.224000e+03, 3.700000e+02]\n"
+  "noise:\n"
+  "  gyro: 0.005\n";
+
+} // namespace
+
+TEST(ParameterReaderTest, scalars) {
+  const ParameterReader params(YAML::Load(config));
+
+  int grid_row = 0;
+  EXPECT_TRUE(params.getParam("grid_row", grid_row));
+  EXPECT_EQ(grid_row, 4);
+
+  // Integers are read as doubles, like from the parameter server.
+  double track_precision = 0.0, ransac_threshold = 0.0;
+  EXPECT_TRUE(params.getParam("track_precision", track_precision));
+  EXPECT_TRUE(params.getParam("ransac_threshold", ransac_threshold));
+  EXPECT_EQ(track_precision, 0.01);
+  EXPECT_EQ(ransac_threshold, 3.0);
+
+  bool estimate_extrinsics = true;
+  EXPECT_TRUE(params.getParam("estimate_extrinsics", estimate_extrinsics));
+  EXPECT_FALSE(estimate_extrinsics);
+
+  string covariance_backend;
+  EXPECT_TRUE(params.getParam("covariance_backend", covariance_backend));
+  EXPECT_EQ(covariance_backend, "square_root");
+
+  double gyro_noise = 0.0;
+  EXPECT_TRUE(params.getParam("noise/gyro", gyro_noise));
+  EXPECT_EQ(gyro_noise, 0.005);
+}
+
+TEST(ParameterReaderTest, missingAndInvalid) {
+  const ParameterReader params(YAML::Load(config));
+
+  // The value is left unchanged if it cannot be read.
+  int value = 7;
+  EXPECT_FALSE(params.getParam("grid_col", value));
+  EXPECT_FALSE(params.getParam("noise/acc", value));
+  EXPECT_FALSE(params.getParam("grid_row/value", value));
+  EXPECT_FALSE(params.getParam("empty", value));
+  EXPECT_FALSE(params.getParam("covariance_backend", value));
+  EXPECT_FALSE(params.getParam("cam0/resolution", value));
+  EXPECT_EQ(value, 7);
+
+  vector<int> resolution(2, 7);
+  EXPECT_FALSE(params.getParam("cam0/intrinsics/0", resolution));
+  EXPECT_FALSE(params.getParam("covariance_backend", resolution));
+  EXPECT_EQ(resolution, vector<int>(2, 7));
+
+  // The defaults replace the missing and the invalid values.
+  double acc_noise = 0.0;
+  params.param<double>("noise/acc", acc_noise, 0.05);
+  EXPECT_EQ(acc_noise, 0.05);
+  params.param<int>("covariance_backend", value, 3);
+  EXPECT_EQ(value, 3);
+  string distortion_model;
+  params.param<string>("cam0/distortion_model",
+      distortion_model, string("radtan"));
+  EXPECT_EQ(distortion_model, "radtan");
+  params.param<int>("grid_row", value, 3);
+  EXPECT_EQ(value, 4);
+}
+
+TEST(ParameterReaderTest, vectors) {
+  const ParameterReader params(YAML::Load(config));
+
+  vector<int> resolution;
+  EXPECT_TRUE(params.getParam("cam0/resolution", resolution));
+  EXPECT_EQ(resolution, vector<int>({752, 480}));
+
+  // The integers may be written as floating point values.
+  EXPECT_TRUE(params.getParam("cam1/resolution", resolution));
+  EXPECT_EQ(resolution, vector<int>({1224, 370}));
+
+  vector<double> intrinsics;
+  EXPECT_TRUE(params.getParam("cam0/intrinsics", intrinsics));
+  EXPECT_EQ(intrinsics,
+      vector<double>({458.654, 457.296, 367.215, 248.375}));
+
+  vector<double> T_vec16;
+  EXPECT_TRUE(params.getParam("cam0/T_vec16", T_vec16));
+  EXPECT_EQ(T_vec16.size(), 16);
+}
+
+TEST(ParameterReaderTest, matrices) {
+  const ParameterReader params(YAML::Load(config));
+
+  vector<vector<double> > T_cam_imu;
+  EXPECT_TRUE(params.getParam("cam0/T_cam_imu", T_cam_imu));
+  ASSERT_EQ(T_cam_imu.size(), 4);
+  for (const auto& row : T_cam_imu) EXPECT_EQ(row.size(), 4);
+  EXPECT_EQ(T_cam_imu[0][3], 0.1);
+  EXPECT_EQ(T_cam_imu[2][3], 0.3);
+  EXPECT_EQ(T_cam_imu[3][3], 1.0);
+
+  // A flat matrix is not a list of rows.
+  vector<vector<double> > T_vec16;
+  EXPECT_FALSE(params.getParam("cam0/T_vec16", T_vec16));
+  EXPECT_TRUE(T_vec16.empty());
+}
+
+TEST(ParameterReaderTest, loadFile) {
+  YAML::Node node;
+  EXPECT_FALSE(ParameterReader::loadFile("/nonexistent.yaml", node));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,122 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <iostream>
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include <msckf_vio/square_root_covariance.h>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+// Augment the dense covariance with x_c = J*x_imu in the
+// given slot, which is assumed to be unused.
+void augmentDense(const MatrixXd& J, const int& slot, MatrixXd& P) {
+  const int n = J.cols();
+  const int s = n + 6*slot;
+  P.middleRows(s, 6) = J * P.topRows(n);
+  P.middleCols(s, 6) = P.middleRows(s, 6).transpose();
+  P.block<6, 6>(s, s) = J * P.block(0, s, n, 6);
+  return;
+}
+
+// Run the same sequence of operations on a dense covariance
+// matrix and on the square-root factor with an N-dim IMU state.
+template <typename Scalar, int N>
+void compareWithDenseCovariance(const double& tolerance) {
+  const int slot_num = 6;
+  SquareRootCovariance<Scalar, N> sqrt_cov;
+  VectorXd variance = VectorXd::Constant(N, 1e-2);
+  variance.head<3>().setZero();
+  variance.segment<3>(12).setZero();
+  sqrt_cov.reset(variance, slot_num);
+  MatrixXd P = MatrixXd::Zero(N+6*slot_num, N+6*slot_num);
+  P.topLeftCorner<N, N>() = variance.asDiagonal();
+
+  // The extrinsic parts of Phi and J are ignored if N is 15.
+  Matrix<double, 21, 21> Phi = Matrix<double, 21, 21>::Identity() +
+    0.01*Matrix<double, 21, 21>::Random();
+  const Matrix<double, N, N> Phi_n = Phi.topLeftCorner<N, N>();
+  Matrix<double, 12, 12> Q = 1e-4 * Matrix<double, 12, 12>::Identity();
+
+  for (int k = 0; k < 5; ++k) {
+    // Propagation.
+    for (int i = 0; i < 10; ++i) {
+      sqrt_cov.propagate(Phi, Q);
+      sqrt_cov.propagateCross(Phi);
+      Matrix<double, N, N> P11 = P.topLeftCorner<N, N>();
+      P11.template topLeftCorner<12, 12>() += Q;
+      P.topLeftCorner<N, N>() = Phi_n * P11 * Phi_n.transpose();
+      P.topRightCorner(N, P.cols()-N) =
+        Phi_n * P.topRightCorner(N, P.cols()-N);
+      P.bottomLeftCorner(P.rows()-N, N) =
+        P.topRightCorner(N, P.cols()-N).transpose();
+    }
+
+    // Augmentation.
+    Matrix<double, 6, 21> J = Matrix<double, 6, 21>::Random();
+    sqrt_cov.augment(J, k);
+    augmentDense(J.leftCols<N>(), k, P);
+    EXPECT_NEAR((sqrt_cov.covariance()-P).norm()/P.norm(), 0.0, tolerance);
+  }
+
+  // Marginalize the camera state in the second slot.
+  sqrt_cov.remove(1);
+  P.middleRows(N+6, 6).setZero();
+  P.middleCols(N+6, 6).setZero();
+  EXPECT_EQ(sqrt_cov.rows(), P.rows());
+  EXPECT_NEAR((sqrt_cov.covariance()-P).norm()/P.norm(), 0.0, tolerance);
+
+  // Reuse the free slot.
+  Matrix<double, 6, 21> J = Matrix<double, 6, 21>::Random();
+  sqrt_cov.augment(J, 1);
+  augmentDense(J.leftCols<N>(), 1, P);
+  EXPECT_NEAR((sqrt_cov.covariance()-P).norm()/P.norm(), 0.0, tolerance);
+
+  // Measurement update.
+  const double noise = 1e-4;
+  MatrixXd H = MatrixXd::Zero(20, P.cols());
+  H.rightCols(P.cols()-N) = MatrixXd::Random(20, P.cols()-N);
+  VectorXd r = 1e-2 * VectorXd::Random(20);
+
+  EXPECT_NEAR((sqrt_cov.projectedCovariance(H)-H*P*H.transpose()).norm() /
+      (H*P*H.transpose()).norm(), 0.0, tolerance);
+
+  MatrixXd S = H*P*H.transpose() + noise*MatrixXd::Identity(20, 20);
+  MatrixXd K = P*H.transpose()*S.inverse();
+  VectorXd delta_x_expected = K * r;
+  P = (MatrixXd::Identity(P.rows(), P.cols())-K*H) * P;
+
+  VectorXd delta_x;
+  sqrt_cov.update(H, r, noise, delta_x);
+  EXPECT_EQ(delta_x.rows(), P.rows());
+  EXPECT_DOUBLE_EQ(delta_x.segment<6>(N+6*5).norm(), 0.0);
+  EXPECT_NEAR((delta_x-delta_x_expected).norm()/delta_x_expected.norm(),
+      0.0, tolerance);
+  EXPECT_NEAR((sqrt_cov.covariance()-P).norm()/P.norm(), 0.0, tolerance);
+  EXPECT_NEAR((sqrt_cov.imuCovariance()-P.topLeftCorner(N, N)).norm() /
+      P.topLeftCorner(N, N).norm(), 0.0, tolerance);
+  return;
+}
+
+TEST(SquareRootCovarianceTest, compareWithDenseDouble) {
+  compareWithDenseCovariance<double, IMU_STATE_SIZE>(1e-9);
+}
+
+TEST(SquareRootCovarianceTest, compareWithDenseFloat) {
+  compareWithDenseCovariance<float, IMU_STATE_SIZE>(1e-3);
+}
+
+TEST(SquareRootCovarianceTest, compareWithDenseCoreState) {
+  compareWithDenseCovariance<double, IMU_CORE_STATE_SIZE>(1e-9);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
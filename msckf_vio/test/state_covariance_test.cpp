@@ -0,0 +1,91 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <iostream>
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include <msckf_vio/state_covariance.h>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+TEST(StateCovarianceTest, augmentAndRemove) {
+  StateCovariance cov;
+  cov.reserve(21+6*4);
+  cov.reset(21);
+
+  // Fill the covariance with three camera states.
+  cov.augment(18);
+  MatrixXd A = MatrixXd::Random(39, 39);
+  MatrixXd P = A * A.transpose();
+  cov.matrix() = P;
+  EXPECT_EQ(cov.rows(), 39);
+  EXPECT_EQ(cov.capacity(), 45);
+
+  // Remove the second camera state, which is the block
+  // in the middle of the matrix.
+  cov.remove(27, 6);
+
+  MatrixXd P_expected(33, 33);
+  P_expected << P.block(0, 0, 27, 27), P.block(0, 33, 27, 6),
+                P.block(33, 0, 6, 27), P.block(33, 33, 6, 6);
+  EXPECT_EQ(cov.rows(), 33);
+  EXPECT_DOUBLE_EQ((cov.matrix()-P_expected).norm(), 0.0);
+
+  // Remove the last camera state.
+  cov.remove(27, 6);
+  EXPECT_EQ(cov.rows(), 27);
+  EXPECT_DOUBLE_EQ(
+      (cov.matrix()-P.topLeftCorner(27, 27)).norm(), 0.0);
+  EXPECT_EQ(cov.capacity(), 45);
+  return;
+}
+
+TEST(StateCovarianceTest, clear) {
+  StateCovariance cov;
+  cov.reset(33);
+  MatrixXd P = MatrixXd::Random(33, 33);
+  cov.matrix() = P;
+  cov.clear(21, 6);
+
+  P.middleRows(21, 6).setZero();
+  P.middleCols(21, 6).setZero();
+  EXPECT_EQ(cov.rows(), 33);
+  EXPECT_DOUBLE_EQ((cov.matrix()-P).norm(), 0.0);
+  return;
+}
+
+TEST(StateCovarianceTest, symmetrize) {
+  StateCovariance cov;
+  cov.reset(30);
+  MatrixXd P = MatrixXd::Random(30, 30);
+  cov.matrix() = P;
+  cov.symmetrize();
+
+  MatrixXd P_expected = (P + P.transpose()) / 2.0;
+  EXPECT_NEAR((cov.matrix()-P_expected).norm(), 0.0, 1e-12);
+  return;
+}
+
+TEST(StateCovarianceTest, growBeyondCapacity) {
+  StateCovariance cov;
+  cov.reserve(21);
+  cov.reset(21);
+  cov(0, 0) = 1.0;
+  cov.augment(6);
+
+  EXPECT_EQ(cov.rows(), 27);
+  EXPECT_GE(cov.capacity(), 27);
+  EXPECT_DOUBLE_EQ(cov(0, 0), 1.0);
+  return;
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,33 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <msckf_vio/thread_pool.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+TEST(ThreadPoolTest, parallelFor) {
+  for (int thread_num = 1; thread_num <= 4; ++thread_num) {
+    ThreadPool pool(thread_num);
+    EXPECT_EQ(pool.size(), thread_num);
+
+    // Run several loops on the same pool.
+    for (int n = 0; n < 200; n += 13) {
+      vector<int> counter(n, 0);
+      pool.parallelFor(n, [&counter](const int& i) { ++counter[i]; });
+      for (int i = 0; i < n; ++i)
+        EXPECT_EQ(counter[i], 1);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
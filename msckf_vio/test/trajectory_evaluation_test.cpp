@@ -0,0 +1,95 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include <msckf_vio/trajectory_evaluation.hpp>
+
+using namespace std;
+using namespace Eigen;
+using namespace msckf_vio;
+
+// A circle with a slowly turning heading, sampled at 200Hz.
+vector<StampedPose> groundTruthTrajectory() {
+  vector<StampedPose> trajectory;
+  for (int i = 0; i < 2000; ++i) {
+    const double t = 0.005 * i;
+    StampedPose pose;
+    pose.time = 100.0 + t;
+    pose.position = Vector3d(5.0*cos(0.3*t), 5.0*sin(0.3*t), 0.1*t);
+    pose.rotation = AngleAxisd(0.3*t, Vector3d::UnitZ()).toRotationMatrix();
+    trajectory.push_back(pose);
+  }
+  return trajectory;
+}
+
+// Express the trajectory in another world frame and sample it at
+// a lower rate with a small time offset.
+vector<StampedPose> transformTrajectory(
+    const vector<StampedPose>& trajectory, const Isometry3d& T) {
+  vector<StampedPose> transformed;
+  for (int i = 0; i < trajectory.size(); i += 10) {
+    StampedPose pose = trajectory[i];
+    pose.time += 1e-4;
+    pose.position = T * pose.position;
+    pose.rotation = T.linear() * pose.rotation;
+    transformed.push_back(pose);
+  }
+  return transformed;
+}
+
+TEST(TrajectoryEvaluationTest, associatePoses) {
+  const vector<StampedPose> ground_truth = groundTruthTrajectory();
+  vector<StampedPose> estimate(3, ground_truth[0]);
+  estimate[0].time = 100.0021;
+  estimate[1].time = 100.0029;
+  estimate[2].time = 200.0;
+
+  vector<pair<int, int> > matches;
+  associatePoses(estimate, ground_truth, 0.01, matches);
+  ASSERT_EQ(matches.size(), 2);
+  EXPECT_EQ(matches[0], make_pair(0, 0));
+  EXPECT_EQ(matches[1], make_pair(1, 1));
+}
+
+TEST(TrajectoryEvaluationTest, rigidTransformIsRemoved) {
+  const vector<StampedPose> ground_truth = groundTruthTrajectory();
+  Isometry3d T = Isometry3d::Identity();
+  T.linear() = AngleAxisd(1.0, Vector3d(1, 2, 3).normalized()).toRotationMatrix();
+  T.translation() = Vector3d(10.0, -3.0, 2.0);
+  const vector<StampedPose> estimate = transformTrajectory(ground_truth, T);
+
+  TrajectoryError error;
+  ASSERT_TRUE(evaluateTrajectory(estimate, ground_truth, 1.0, 0.01, error));
+  EXPECT_EQ(error.pose_num, estimate.size());
+  EXPECT_NEAR(error.ate, 0.0, 1e-6);
+  EXPECT_NEAR(error.rpe_translation, 0.0, 1e-6);
+  EXPECT_NEAR(error.rpe_rotation, 0.0, 1e-4);
+}
+
+TEST(TrajectoryEvaluationTest, alternatingOffset) {
+  const vector<StampedPose> ground_truth = groundTruthTrajectory();
+  vector<StampedPose> estimate =
+    transformTrajectory(ground_truth, Isometry3d::Identity());
+
+  // Alternating errors along z cannot be removed by the alignment.
+  for (int i = 0; i < estimate.size(); ++i)
+    estimate[i].position(2) += i%2 == 0 ? 0.1 : -0.1;
+
+  TrajectoryError error;
+  ASSERT_TRUE(evaluateTrajectory(estimate, ground_truth, 0.04, 0.01, error));
+  EXPECT_NEAR(error.ate, 0.1, 1e-3);
+  // Consecutive poses have opposite errors.
+  EXPECT_NEAR(error.rpe_translation, 0.2, 1e-3);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,167 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <msckf_vio/spsc_queue.hpp>
+#include <msckf_vio/trajectory_logger.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+PoseRecord makePose(const int& i) {
+  PoseRecord pose;
+  pose.time = 0.05 * i;
+  for (int j = 0; j < 3; ++j) pose.position[j] = i + 0.25*j;
+  for (int j = 0; j < 3; ++j) pose.orientation[j] = 0.0;
+  pose.orientation[3] = 1.0;
+  return pose;
+}
+
+string tempPath(const string& name) {
+  const string path = string(testing::TempDir()) + name;
+  remove(path.c_str());
+  for (int i = 1; i < 10; ++i)
+    remove((path+"."+to_string(i)).c_str());
+  return path;
+}
+
+TEST(SpscQueueTest, orderAcrossThreads) {
+  SpscQueue<int> queue(100);
+  EXPECT_EQ(queue.capacity(), 128);
+
+  const int n = 100000;
+  thread producer([&]() {
+      for (int i = 0; i < n; ++i)
+        while (!queue.push(i)) this_thread::yield();
+  });
+
+  int value = 0;
+  for (int i = 0; i < n; ++i) {
+    while (!queue.pop(value)) this_thread::yield();
+    ASSERT_EQ(value, i);
+  }
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(SpscQueueTest, pushFailsWhenFull) {
+  SpscQueue<int> queue(4);
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(queue.push(i));
+  EXPECT_FALSE(queue.push(4));
+  int value = 0;
+  EXPECT_TRUE(queue.pop(value));
+  EXPECT_EQ(value, 0);
+  EXPECT_TRUE(queue.push(4));
+}
+
+TEST(TrajectoryLoggerTest, writeTum) {
+  const string path = tempPath("trajectory_tum.txt");
+  {
+    TrajectoryLogger logger(path, TrajectoryLogger::TUM, 0.01);
+    ASSERT_TRUE(logger.isOpen());
+    for (int i = 0; i < 100; ++i) EXPECT_TRUE(logger.log(makePose(i)));
+  }
+
+  ifstream file(path);
+  PoseRecord pose;
+  int count = 0;
+  while (file >> pose.time >> pose.position[0] >>
+      pose.position[1] >> pose.position[2] >>
+      pose.orientation[0] >> pose.orientation[1] >>
+      pose.orientation[2] >> pose.orientation[3]) {
+    const PoseRecord expected = makePose(count++);
+    EXPECT_NEAR(pose.time, expected.time, 1e-6);
+    EXPECT_NEAR(pose.position[2], expected.position[2], 1e-5);
+    EXPECT_DOUBLE_EQ(pose.orientation[3], 1.0);
+  }
+  EXPECT_EQ(count, 100);
+}
+
+TEST(TrajectoryLoggerTest, writeBinaryWithRotation) {
+  const string path = tempPath("trajectory.bin");
+  const int per_file = 10;
+  {
+    TrajectoryLogger logger(path, TrajectoryLogger::BINARY, 1.0,
+        per_file*sizeof(PoseRecord));
+    for (int i = 0; i < 35; ++i) EXPECT_TRUE(logger.log(makePose(i)));
+  }
+
+  // The poses are spread over the rotated files in order.
+  int count = 0;
+  for (int index = 0; index < 4; ++index) {
+    const string name = index == 0 ? path : path+"."+to_string(index);
+    ifstream file(name, ios::binary);
+    ASSERT_TRUE(file.good());
+    PoseRecord pose;
+    int file_count = 0;
+    while (file.read(reinterpret_cast<char*>(&pose), sizeof(PoseRecord))) {
+      EXPECT_DOUBLE_EQ(pose.time, makePose(count++).time);
+      ++file_count;
+    }
+    EXPECT_EQ(file_count, index < 3 ? per_file : 5);
+  }
+  EXPECT_EQ(count, 35);
+}
+
+TEST(TrajectoryLoggerTest, resumeRotation) {
+  const string path = tempPath("trajectory_resume.bin");
+  // The restarted logger has a larger limit, under which the
+  // first file of the previous run is not full.
+  for (int run = 0; run < 2; ++run) {
+    TrajectoryLogger logger(path, TrajectoryLogger::BINARY, 1.0,
+        10*(run+1)*sizeof(PoseRecord));
+    for (int i = 0; i < 17; ++i)
+      EXPECT_TRUE(logger.log(makePose(17*run+i)));
+  }
+
+  // It fills the last file of the previous run and goes on
+  // with the next index, so the poses stay in order.
+  const int file_counts[] = {10, 20, 4};
+  int count = 0;
+  for (int index = 0; index < 3; ++index) {
+    const string name = index == 0 ? path : path+"."+to_string(index);
+    ifstream file(name, ios::binary);
+    ASSERT_TRUE(file.good());
+    PoseRecord pose;
+    int file_count = 0;
+    while (file.read(reinterpret_cast<char*>(&pose), sizeof(PoseRecord))) {
+      EXPECT_DOUBLE_EQ(pose.time, makePose(count++).time);
+      ++file_count;
+    }
+    EXPECT_EQ(file_count, file_counts[index]);
+  }
+  EXPECT_EQ(count, 34);
+}
+
+TEST(TrajectoryLoggerTest, dropWhenFull) {
+  const string path = tempPath("trajectory_drop.txt");
+  // The writer does not wake up before the logger is destroyed.
+  TrajectoryLogger logger(path, TrajectoryLogger::TUM, 100.0, 0, 8);
+  int logged = 0;
+  for (int i = 0; i < 20; ++i) logged += logger.log(makePose(i));
+  EXPECT_EQ(logged, 8);
+  EXPECT_EQ(logger.droppedNum(), 12);
+}
+
+TEST(TrajectoryLoggerTest, parseFormat) {
+  TrajectoryLogger::Format format;
+  EXPECT_TRUE(TrajectoryLogger::parseFormat("binary", format));
+  EXPECT_EQ(format, TrajectoryLogger::BINARY);
+  EXPECT_TRUE(TrajectoryLogger::parseFormat("tum", format));
+  EXPECT_EQ(format, TrajectoryLogger::TUM);
+  EXPECT_FALSE(TrajectoryLogger::parseFormat("csv", format));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,166 @@
+/*
+ * COPYRIGHT AND PERMISSION NOTICE
+ * Penn Software MSCKF_VIO
+ * Copyright (C) 2017 The Trustees of the University of Pennsylvania
+ * All rights reserved.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <msckf_vio/undistortion_map.h>
+
+using namespace std;
+using namespace msckf_vio;
+
+namespace {
+
+const cv::Vec2i resolution(752, 480);
+const cv::Vec4d intrinsics(458.654, 457.296, 367.215, 248.375);
+
+// The EuRoC cam0 calibration with either model.
+cv::Vec4d distortionCoeffs(const string& distortion_model) {
+  return distortion_model == "equidistant" ?
+    cv::Vec4d(-0.0132, 0.0223, -0.0214, 0.0075) :
+    cv::Vec4d(-0.28340811, 0.07395907, 0.00019359, 1.76187114e-05);
+}
+
+// Pixels on a grid over the image and a band around it.
+vector<cv::Point2f> gridPixels(const float& margin) {
+  vector<cv::Point2f> pixels;
+  for (float y = -margin; y <= resolution[1]-1+margin; y += 3.7f)
+    for (float x = -margin; x <= resolution[0]-1+margin; x += 3.3f)
+      pixels.push_back(cv::Point2f(x, y));
+  return pixels;
+}
+
+double maxPixelDistance(const vector<cv::Point2f>& pts1,
+    const vector<cv::Point2f>& pts2, const cv::Vec2d& scale) {
+  double max_distance = 0.0;
+  for (int i = 0; i < pts1.size(); ++i)
+    max_distance = max(max_distance, hypot(
+          (pts1[i].x-pts2[i].x)*scale[0], (pts1[i].y-pts2[i].y)*scale[1]));
+  return max_distance;
+}
+
+} // namespace
+
+TEST(UndistortionMapTest, undistortPoints) {
+  for (const string model : {"radtan", "equidistant"}) {
+    UndistortionMap map;
+    map.initialize(resolution, intrinsics, model,
+        distortionCoeffs(model), 4);
+    ASSERT_TRUE(map.hasTable());
+    EXPECT_GT(map.maxError(), 0.0);
+    EXPECT_LT(map.maxError(), 0.1);
+
+    // The table is within the reported error of the iterative
+    // solution, and the pixels out of the image are undistorted
+    // iteratively.
+    const vector<cv::Point2f> pixels = gridPixels(10.0f);
+    vector<cv::Point2f> pts_table;
+    vector<cv::Point2f> pts_iterative;
+    map.undistortPoints(pixels, pts_table);
+    map.undistortPointsIteratively(pixels, pts_iterative);
+    ASSERT_EQ(pts_table.size(), pixels.size());
+    EXPECT_LT(maxPixelDistance(pts_table, pts_iterative,
+          cv::Vec2d(intrinsics[0], intrinsics[1])), 0.1);
+
+    for (int i = 0; i < pixels.size(); ++i) {
+      if (pixels[i].x >= 0 && pixels[i].x <= resolution[0]-1 &&
+          pixels[i].y >= 0 && pixels[i].y <= resolution[1]-1) continue;
+      EXPECT_EQ(pts_table[i].x, pts_iterative[i].x);
+      EXPECT_EQ(pts_table[i].y, pts_iterative[i].y);
+    }
+  }
+}
+
+TEST(UndistortionMapTest, wholeImageTolerance) {
+  // Every half pixel over the whole image, including the
+  // borders where the distortion changes the fastest.
+  vector<cv::Point2f> pixels;
+  for (float y = 0.0f; y <= resolution[1]-1; y += 0.5f)
+    for (float x = 0.0f; x <= resolution[0]-1; x += 0.5f)
+      pixels.push_back(cv::Point2f(x, y));
+
+  for (const string model : {"radtan", "equidistant"}) {
+    vector<cv::Point2f> pts_iterative;
+    UndistortionMap map;
+    map.initialize(resolution, intrinsics, model,
+        distortionCoeffs(model), 2);
+    map.undistortPointsIteratively(pixels, pts_iterative);
+
+    // The error of the table and its reported maximum are
+    // within 0.02px with the default cell size, and grow with
+    // the square of the cell size.
+    for (const int cell_size : {2, 4}) {
+      map.initialize(resolution, intrinsics, model,
+          distortionCoeffs(model), cell_size);
+      vector<cv::Point2f> pts_table;
+      map.undistortPoints(pixels, pts_table);
+      const double max_error = maxPixelDistance(pts_table,
+          pts_iterative, cv::Vec2d(intrinsics[0], intrinsics[1]));
+
+      EXPECT_LT(max_error, 0.02*cell_size*cell_size/4) << model;
+      EXPECT_LT(map.maxError(), 0.02*cell_size*cell_size/4) << model;
+      EXPECT_LE(max_error, 1.05*map.maxError()) << model;
+    }
+  }
+}
+
+TEST(UndistortionMapTest, withoutTable) {
+  UndistortionMap map;
+  map.initialize(resolution, intrinsics, "radtan",
+      distortionCoeffs("radtan"), 0);
+  EXPECT_FALSE(map.hasTable());
+
+  const vector<cv::Point2f> pixels = gridPixels(0.0f);
+  vector<cv::Point2f> pts;
+  vector<cv::Point2f> pts_iterative;
+  map.undistortPoints(pixels, pts);
+  map.undistortPointsIteratively(pixels, pts_iterative);
+  EXPECT_EQ(maxPixelDistance(pts, pts_iterative, cv::Vec2d(1.0, 1.0)), 0.0);
+}
+
+TEST(UndistortionMapTest, distortPoints) {
+  const cv::Matx33d K(
+      intrinsics[0], 0.0, intrinsics[2],
+      0.0, intrinsics[1], intrinsics[3],
+      0.0, 0.0, 1.0);
+
+  // Points up to 45 degrees off the optical axis.
+  vector<cv::Point2f> points;
+  vector<cv::Point3f> homogenous_points;
+  for (float y = -0.7f; y <= 0.7f; y += 0.05f) {
+    for (float x = -0.7f; x <= 0.7f; x += 0.05f) {
+      points.push_back(cv::Point2f(x, y));
+      homogenous_points.push_back(cv::Point3f(x, y, 1.0f));
+    }
+  }
+
+  for (const string model : {"radtan", "equidistant"}) {
+    UndistortionMap map;
+    map.initialize(resolution, intrinsics, model,
+        distortionCoeffs(model), 4);
+
+    vector<cv::Point2f> pixels;
+    vector<cv::Point2f> pixels_opencv;
+    map.distortPoints(points, pixels);
+    if (model == "equidistant") {
+      cv::fisheye::distortPoints(
+          points, pixels_opencv, K, distortionCoeffs(model));
+    } else {
+      cv::projectPoints(homogenous_points, cv::Vec3d::zeros(),
+          cv::Vec3d::zeros(), K, distortionCoeffs(model), pixels_opencv);
+    }
+    EXPECT_LT(maxPixelDistance(
+          pixels, pixels_opencv, cv::Vec2d(1.0, 1.0)), 1e-3);
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}